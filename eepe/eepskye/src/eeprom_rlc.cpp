@@ -791,6 +791,14 @@ void fill_file_indexRlc( struct t_radioData *radioData )
 	}
 }
 
+// Decode a model from the image kept by ee32SetModelSource()
+void eeLoadModelRlcSource( struct t_radioData *radioData, uint8_t id )
+{
+	EepromImage = radioData->source ;
+	EeFsOpen() ;
+	eeLoadModelRlc( radioData, id ) ;
+}
+
 uint32_t rawloadFileRlc( struct t_radioData *radioData, uint8_t *eeprom )
 {
 	uint32_t i ;
@@ -800,9 +808,12 @@ uint32_t rawloadFileRlc( struct t_radioData *radioData, uint8_t *eeprom )
 	ee32_read_model_namesRlc(radioData) ;
 	DefaultModelType = 1 ;
 	eeLoadGeneralRlc(radioData) ;
+	// Models are only decoded when used
+	ee32SetModelSource( radioData, eeprom, EERLCSIZE, MODEL_SOURCE_RLC ) ;
 	for ( i = 0 ; i < MAX_MODELS ; i += 1 )
 	{
-    eeLoadModelRlc( radioData, i ) ;
+		memclear( &radioData->models[i], sizeof(SKYModelData) ) ;
+		radioData->modelPending[i] = 1 ;
 	}
 	radioData->valid = 1 ;
 
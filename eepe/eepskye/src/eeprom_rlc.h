@@ -212,6 +212,7 @@ void ee32SwapModels(uint8_t id1, uint8_t id2);
 uint32_t ee32_check_finished( void ) ;
 void ee32_delete_model( uint8_t x ) ;
 uint32_t rawloadFileRlc( struct t_radioData *radioData, uint8_t *eeprom ) ;
+void eeLoadModelRlcSource( struct t_radioData *radioData, uint8_t id ) ;
 
 #if defined(SDCARD)
 const pm_char * eeBackupModel(uint8_t i_fileSrc);
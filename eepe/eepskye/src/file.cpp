@@ -17,6 +17,7 @@
 
 #include "stdio.h"
 #include <stdint.h>
+#include <stdlib.h>
 #include "string.h"
 #include "pers.h"
 #include "myeeprom.h"
@@ -83,6 +84,100 @@ uint32_t read32_eeprom_data( uint32_t eeAddress, uint8_t *buffer, uint32_t size
 	return 1 ;
 }
 
+// Journal records appended by the radio after the model data
+struct t_journal_header
+{
+	uint16_t offset ;			// Into the data, 0xFFFF is erased flash, end of journal
+	uint8_t length ;
+	uint8_t flags ;
+	uint16_t check ;			// Fletcher 16 over offset, length, flags and data
+} ;
+
+#define JOURNAL_RECORD_MAX		64
+#define JOURNAL_COMMIT				0x01	// In flags, last record of a save
+
+uint16_t journalCheck( struct t_journal_header *header, uint8_t *data )
+{
+	uint32_t sum1 = 0 ;
+	uint32_t sum2 = 0 ;
+	uint8_t *p = (uint8_t *)header ;
+	uint32_t i ;
+
+	for ( i = 0 ; i < 4 + (uint32_t)header->length ; i += 1 )
+	{
+		if ( i == 4 )
+		{
+			p = data ;
+		}
+		sum1 = ( sum1 + *p++ ) % 255 ;
+		sum2 = ( sum2 + sum1 ) % 255 ;
+	}
+	return ( sum2 << 8 ) | sum1 ;
+}
+
+// Read and check the journal record at address in a block, returns the size
+// of the record, or 0 if it is erased or not valid
+static uint32_t journalRecord( uint32_t block_no, uint32_t address, uint32_t imageSize, struct t_journal_header *header, uint8_t *data )
+{
+	read32_eeprom_data( (block_no << 12) + address, ( uint8_t *)header, sizeof(*header) ) ;
+	if ( ( header->offset == 0xFFFF ) || ( header->length == 0 ) || ( header->length > JOURNAL_RECORD_MAX )
+			 || ( (uint32_t)header->offset + header->length > imageSize )
+			 || ( address + sizeof(*header) + header->length > 4096 ) )
+	{
+		return 0 ;
+	}
+	read32_eeprom_data( (block_no << 12) + address + sizeof(*header), data, header->length ) ;
+	if ( journalCheck( header, data ) != header->check )
+	{
+		return 0 ;
+	}
+	return sizeof(*header) + header->length ;
+}
+
+// Read the file data in a block, then apply any journal records, a save at
+// a time, only when the save's commit record has been found
+void ee32ReadBlockData( uint32_t block_no, uint32_t imageSize, uint8_t *dest, uint32_t size )
+{
+	struct t_journal_header header ;
+	uint8_t data[JOURNAL_RECORD_MAX] ;
+	uint32_t address ;
+	uint32_t batch ;
+	uint32_t length ;
+	uint32_t i ;
+
+	read32_eeprom_data( (block_no << 12) + sizeof( struct t_eeprom_header), dest, size ) ;
+	address = sizeof( struct t_eeprom_header) + imageSize ;
+	batch = address ;
+	while ( address + sizeof(header) <= 4096 )
+	{
+		length = journalRecord( block_no, address, imageSize, &header, data ) ;
+		if ( length == 0 )
+		{
+			break ;
+		}
+		address += length ;
+		if ( header.flags & JOURNAL_COMMIT )
+		{
+			while ( batch < address )
+			{
+				length = journalRecord( block_no, batch, imageSize, &header, data ) ;
+				if ( length == 0 )
+				{
+					return ;
+				}
+				for ( i = 0 ; i < header.length ; i += 1 )
+				{
+					if ( header.offset + i < size )
+					{
+						dest[header.offset + i] = data[i] ;
+					}
+				}
+				batch += length ;
+			}
+		}
+	}
+}
+
 uint32_t get_current_block_number( uint32_t block_no, uint16_t *p_size, uint32_t *p_seq )
 {
 	struct t_eeprom_header b0 ;
@@ -750,7 +845,7 @@ bool ee32LoadGeneral(struct t_radioData *radioData)
 
 	if ( size )
 	{
-    read32_eeprom_data( ( radioData->File_system[0].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&radioData->generalSettings, size ) ;
+    ee32ReadBlockData( radioData->File_system[0].block_no, radioData->File_system[0].size, ( uint8_t *)&radioData->generalSettings, size ) ;
 	}
 	else
 	{
@@ -809,12 +904,12 @@ void ee32LoadModel(struct t_radioData *radioData, uint8_t id)
 			{
 				if ( size < 720 )
 				{
-					read32_eeprom_data( ( radioData->File_system[id+1].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&g_oldmodel, size ) ;
+					ee32ReadBlockData( radioData->File_system[id+1].block_no, radioData->File_system[id+1].size, ( uint8_t *)&g_oldmodel, size ) ;
 					convertModel( &radioData->models[id], &g_oldmodel ) ;
 				}
 				else
 				{
-					read32_eeprom_data( ( radioData->File_system[id+1].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&radioData->models[id], size ) ;
+					ee32ReadBlockData( radioData->File_system[id+1].block_no, radioData->File_system[id+1].size, ( uint8_t *)&radioData->models[id], size ) ;
 				}	 
 				
 				if ( version != 255 )
@@ -851,9 +946,12 @@ uint32_t rawloadFile( struct t_radioData *radioData, uint8_t *eeprom )
 	ee32_read_model_names(radioData) ;
 	DefaultModelType = 1 ;
 	ee32LoadGeneral(radioData) ;
+	// Models are only decoded when used
+	ee32SetModelSource( radioData, eeprom, EEFULLSIZE, MODEL_SOURCE_EEPROM ) ;
 	for ( i = 0 ; i < MAX_IMODELS ; i += 1 )
 	{
-		ee32LoadModel( radioData, i ) ;
+		memset( &radioData->models[i], 0, sizeof(SKYModelData) ) ;
+		radioData->modelPending[i] = 1 ;
 	}
 	radioData->valid = 1 ;
 
@@ -861,6 +959,449 @@ uint32_t rawloadFile( struct t_radioData *radioData, uint8_t *eeprom )
 	
 }
 
+// Keep a copy of the image the models are loaded from
+void ee32SetModelSource( t_radioData *radioData, uint8_t *data, uint32_t size, uint32_t type )
+{
+	free( radioData->source ) ;
+	radioData->source = 0 ;
+	radioData->sourceSize = 0 ;
+	if ( data && size )
+	{
+		radioData->source = (uint8_t *) malloc( size ) ;
+		if ( radioData->source == 0 )
+		{
+			type = MODEL_SOURCE_NONE ;
+		}
+		else
+		{
+			memcpy( radioData->source, data, size ) ;
+			radioData->sourceSize = size ;
+		}
+	}
+	radioData->sourceType = type ;
+	memset( radioData->modelPending, 0, sizeof(radioData->modelPending) ) ;
+}
+
+// Decode a model from the source if not yet done
+void ee32ModelNeeded( t_radioData *radioData, uint32_t id )
+{
+	if ( ( id >= MAX_IMODELS ) || ( radioData->modelPending[id] == 0 ) )
+	{
+		return ;
+	}
+	radioData->modelPending[id] = 0 ;
+	switch ( radioData->sourceType )
+	{
+		case MODEL_SOURCE_EEPROM :
+			Eeprom = radioData->source ;
+			ee32LoadModel( radioData, id ) ;
+		break ;
+
+		case MODEL_SOURCE_RLC :
+			eeLoadModelRlcSource( radioData, id ) ;
+		break ;
+
+		case MODEL_SOURCE_LIBRARY :
+			if ( libraryLoadModel( radioData->source, radioData->sourceSize, id, &radioData->models[id] ) == 0 )
+			{
+				memset( &radioData->models[id], 0, sizeof(SKYModelData) ) ;
+			}
+		break ;
+	}
+}
+
+
+// Unpack an archive image, returns 0 if it does not fit or is corrupt
+static uint32_t archiveUnpack( uint8_t *dest, uint8_t *src, uint32_t size, uint32_t imageSize, uint32_t flags )
+{
+	uint32_t i = 0 ;
+	uint32_t c ;
+	uint32_t count ;
+
+	if ( ( flags & MODEL_ARCHIVE_RLE ) == 0 )
+	{
+		if ( size != imageSize )
+		{
+			return 0 ;
+		}
+		memcpy( dest, src, size ) ;
+		return 1 ;
+	}
+	while ( size )
+	{
+		c = *src++ ;
+		size -= 1 ;
+		if ( c >= 0x80 )
+		{
+			count = c - 0x80 + 3 ;
+			if ( ( size == 0 ) || ( i + count > imageSize ) )
+			{
+				return 0 ;
+			}
+			memset( &dest[i], *src++, count ) ;
+			size -= 1 ;
+		}
+		else
+		{
+			count = c + 1 ;
+			if ( ( count > size ) || ( i + count > imageSize ) )
+			{
+				return 0 ;
+			}
+			memcpy( &dest[i], src, count ) ;
+			src += count ;
+			size -= count ;
+		}
+		i += count ;
+	}
+	return i == imageSize ;
+}
+
+static uint16_t archiveCheck( uint8_t *data, uint32_t size )
+{
+	uint32_t sum1 = 0 ;
+	uint32_t sum2 = 0 ;
+
+	while ( size-- )
+	{
+		sum1 = ( sum1 + *data++ ) % 255 ;
+		sum2 = ( sum2 + sum1 ) % 255 ;
+	}
+	return ( sum2 << 8 ) | sum1 ;
+}
+
+// Load the models from a radio model archive (.mbk)
+uint32_t rawloadModelArchive( t_radioData *radioData, uint8_t *data, uint32_t size )
+{
+	struct t_model_archive_header *header = (struct t_model_archive_header *) data ;
+	struct t_model_archive_entry *entry ;
+	uint8_t image[4096] ;
+	uint32_t i ;
+
+	if ( ( size < sizeof(*header) ) || memcmp( header->id, "MBK1", 4 )
+			 || ( size < sizeof(*header) + header->count * sizeof(*entry) ) )
+	{
+		return 0 ;
+	}
+	ee32SetModelSource( radioData, 0, 0, MODEL_SOURCE_NONE ) ;
+	for ( i = 0 ; ( i < header->count ) && ( i < MAX_IMODELS ) ; i += 1 )
+	{
+		entry = (struct t_model_archive_entry *) ( data + sizeof(*header) + i * sizeof(*entry) ) ;
+		memset( &radioData->models[i], 0, sizeof(SKYModelData) ) ;
+		radioData->File_system[i+1].size = 0 ;
+		memset( radioData->ModelNames[i+1], ' ', sizeof( radioData->models[0].name) ) ;
+		if ( entry->offset == 0 )
+		{
+			continue ;
+		}
+		if ( ( entry->imageSize > sizeof(image) ) || ( entry->offset + entry->size > size ) )
+		{
+			return 0 ;
+		}
+		memset( image, 0, sizeof(image) ) ;
+		if ( archiveUnpack( image, data + entry->offset, entry->size, entry->imageSize, entry->flags ) == 0 )
+		{
+			return 0 ;
+		}
+		if ( archiveCheck( image, entry->imageSize ) != entry->check )
+		{
+			return 0 ;
+		}
+		memcpy( &radioData->models[i], image, ( entry->imageSize < sizeof(SKYModelData) ) ? entry->imageSize : sizeof(SKYModelData) ) ;
+		radioData->File_system[i+1].size = sizeof(SKYModelData) ;
+		memcpy( radioData->ModelNames[i+1], radioData->models[i].name, sizeof( radioData->models[0].name) ) ;
+		radioData->ModelNames[i+1][sizeof( radioData->models[0].name)+1] = '\0' ;
+	}
+	radioData->valid = 1 ;
+	return 1 ;
+}
+
+// RLE pack as the radio's archive, returns the packed size
+// dest may be NULL to just get the size
+static uint32_t archivePack( uint8_t *dest, uint8_t *data, uint32_t size )
+{
+	uint32_t i = 0 ;
+	uint32_t literals = 0 ;
+	uint32_t total = 0 ;
+	uint32_t run ;
+
+	while ( i <= size )
+	{
+		run = 0 ;
+		if ( i < size )
+		{
+			run = 1 ;
+			while ( ( i + run < size ) && ( data[i+run] == data[i] ) && ( run < 130 ) )
+			{
+				run += 1 ;
+			}
+		}
+		if ( literals && ( ( run >= 3 ) || ( literals == 128 ) || ( i == size ) ) )
+		{
+			if ( dest )
+			{
+				dest[total] = literals - 1 ;
+				memcpy( &dest[total+1], &data[i-literals], literals ) ;
+			}
+			total += literals + 1 ;
+			literals = 0 ;
+		}
+		if ( i == size )
+		{
+			break ;
+		}
+		if ( run >= 3 )
+		{
+			if ( dest )
+			{
+				dest[total] = 0x80 + run - 3 ;
+				dest[total+1] = data[i] ;
+			}
+			total += 2 ;
+			i += run ;
+		}
+		else
+		{
+			literals += 1 ;
+			i += 1 ;
+		}
+	}
+	return total ;
+}
+
+// Model library (.mlb)
+// Each model image is cut into MODEL_LIBRARY_CHUNK byte chunks. Identical
+// chunks, typically the unused parts of models and the settings shared by
+// cloned models, are stored once, so a model only costs the chunks where it
+// differs from the others, plus a list of chunk numbers.
+
+#define LIBRARY_HASH_SIZE		8192		// Power of 2, > MAX_IMODELS * MODEL_LIBRARY_CHUNKS
+
+static uint8_t *LibraryChunks[MAX_IMODELS*MODEL_LIBRARY_CHUNKS] ;
+static uint8_t LibraryChunkLength[MAX_IMODELS*MODEL_LIBRARY_CHUNKS] ;
+static uint16_t LibraryHash[LIBRARY_HASH_SIZE] ;		// Chunk number + 1
+static uint16_t LibraryLists[MAX_IMODELS][MODEL_LIBRARY_CHUNKS] ;
+
+static uint32_t libraryHash( uint8_t *data, uint32_t size )
+{
+	uint32_t hash = 2166136261u ;		// FNV-1a
+
+	while ( size-- )
+	{
+		hash = ( hash ^ *data++ ) * 16777619u ;
+	}
+	return hash ;
+}
+
+// Find or add a chunk, returns its number
+static uint32_t libraryChunk( uint8_t *data, uint32_t length, uint32_t *count )
+{
+	uint32_t h ;
+	uint32_t n ;
+
+	h = libraryHash( data, length ) & ( LIBRARY_HASH_SIZE - 1 ) ;
+	while ( ( n = LibraryHash[h] ) )
+	{
+		n -= 1 ;
+		if ( ( LibraryChunkLength[n] == length ) && ( memcmp( LibraryChunks[n], data, length ) == 0 ) )
+		{
+			return n ;
+		}
+		h = ( h + 1 ) & ( LIBRARY_HASH_SIZE - 1 ) ;
+	}
+	n = *count ;
+	*count = n + 1 ;
+	LibraryChunks[n] = data ;
+	LibraryChunkLength[n] = length ;
+	LibraryHash[h] = n + 1 ;
+	return n ;
+}
+
+// Write the models to a library, data may be NULL to get the size needed
+// Returns the bytes used, 0 if size is too small
+uint32_t rawsaveModelLibrary( t_radioData *radioData, uint8_t *data, uint32_t size )
+{
+	struct t_model_library_header header ;
+	struct t_model_library_entry entry ;
+	struct t_model_library_chunk chunk ;
+	uint32_t chunkCount = 0 ;
+	uint32_t offset ;
+	uint32_t dataOffset ;
+	uint32_t i ;
+	uint32_t j ;
+	uint32_t length ;
+
+	memset( LibraryHash, 0, sizeof(LibraryHash) ) ;
+	for ( i = 0 ; i < MAX_IMODELS ; i += 1 )
+	{
+		if ( radioData->File_system[i+1].size )
+		{
+			for ( j = 0 ; j < MODEL_LIBRARY_CHUNKS ; j += 1 )
+			{
+				length = sizeof(SKYModelData) - j * MODEL_LIBRARY_CHUNK ;
+				if ( length > MODEL_LIBRARY_CHUNK )
+				{
+					length = MODEL_LIBRARY_CHUNK ;
+				}
+				LibraryLists[i][j] = libraryChunk( (uint8_t *)&radioData->models[i] + j * MODEL_LIBRARY_CHUNK, length, &chunkCount ) ;
+			}
+		}
+	}
+
+	// Header, index, chunk lists, chunk table then chunk data
+	offset = sizeof(header) + MAX_IMODELS * sizeof(entry) ;
+	memcpy( header.id, "MLB1", 4 ) ;
+	header.version = 1 ;
+	header.chunkSize = MODEL_LIBRARY_CHUNK ;
+	header.count = MAX_IMODELS ;
+	header.modelSize = sizeof(SKYModelData) ;
+	header.chunkCount = chunkCount ;
+	for ( i = 0 ; i < MAX_IMODELS ; i += 1 )
+	{
+		memset( &entry, 0, sizeof(entry) ) ;
+		if ( radioData->File_system[i+1].size )
+		{
+			entry.offset = offset ;
+			entry.imageSize = sizeof(SKYModelData) ;
+			entry.check = archiveCheck( (uint8_t *)&radioData->models[i], sizeof(SKYModelData) ) ;
+			memcpy( entry.name, radioData->models[i].name, sizeof(entry.name) ) ;
+			if ( data && ( offset + sizeof(LibraryLists[0]) <= size ) )
+			{
+				memcpy( data + offset, LibraryLists[i], sizeof(LibraryLists[0]) ) ;
+			}
+			offset += sizeof(LibraryLists[0]) ;
+		}
+		if ( data && ( sizeof(header) + ( i + 1 ) * sizeof(entry) <= size ) )
+		{
+			memcpy( data + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry) ) ;
+		}
+	}
+	header.chunkOffset = offset ;
+	dataOffset = offset + chunkCount * sizeof(chunk) ;
+	for ( i = 0 ; i < chunkCount ; i += 1 )
+	{
+		length = archivePack( 0, LibraryChunks[i], LibraryChunkLength[i] ) ;
+		chunk.flags = MODEL_ARCHIVE_RLE ;
+		if ( length >= LibraryChunkLength[i] )
+		{
+			length = LibraryChunkLength[i] ;
+			chunk.flags = 0 ;
+		}
+		chunk.offset = dataOffset ;
+		chunk.size = length ;
+		chunk.spare = 0 ;
+		if ( data && ( dataOffset + length <= size ) )
+		{
+			memcpy( data + offset, &chunk, sizeof(chunk) ) ;
+			if ( chunk.flags )
+			{
+				archivePack( data + dataOffset, LibraryChunks[i], LibraryChunkLength[i] ) ;
+			}
+			else
+			{
+				memcpy( data + dataOffset, LibraryChunks[i], length ) ;
+			}
+		}
+		offset += sizeof(chunk) ;
+		dataOffset += length ;
+	}
+	if ( data )
+	{
+		if ( dataOffset > size )
+		{
+			return 0 ;
+		}
+		memcpy( data, &header, sizeof(header) ) ;
+	}
+	return dataOffset ;
+}
+
+// Unpack one model from a library, returns 0 if it is corrupt
+uint32_t libraryLoadModel( uint8_t *data, uint32_t size, uint32_t index, SKYModelData *model )
+{
+	struct t_model_library_header *header = (struct t_model_library_header *) data ;
+	struct t_model_library_entry *entry ;
+	struct t_model_library_chunk *chunk ;
+	uint8_t image[4096] ;
+	uint16_t number ;
+	uint32_t i ;
+	uint32_t length ;
+
+	if ( index >= header->count )
+	{
+		return 0 ;
+	}
+	entry = (struct t_model_library_entry *) ( data + sizeof(*header) + index * sizeof(*entry) ) ;
+	if ( ( entry->imageSize > sizeof(image) ) || ( header->chunkSize == 0 )
+			 || ( entry->offset + ( entry->imageSize + header->chunkSize - 1 ) / header->chunkSize * sizeof(number) > size ) )
+	{
+		return 0 ;
+	}
+	for ( i = 0 ; i < entry->imageSize ; i += length )
+	{
+		memcpy( &number, data + entry->offset + i / header->chunkSize * sizeof(number), sizeof(number) ) ;
+		if ( number >= header->chunkCount )
+		{
+			return 0 ;
+		}
+		chunk = (struct t_model_library_chunk *) ( data + header->chunkOffset + number * sizeof(*chunk) ) ;
+		length = entry->imageSize - i ;
+		if ( length > header->chunkSize )
+		{
+			length = header->chunkSize ;
+		}
+		if ( ( chunk->offset + chunk->size > size )
+				 || ( archiveUnpack( &image[i], data + chunk->offset, chunk->size, length, chunk->flags ) == 0 ) )
+		{
+			return 0 ;
+		}
+	}
+	if ( archiveCheck( image, entry->imageSize ) != entry->check )
+	{
+		return 0 ;
+	}
+	memset( model, 0, sizeof(SKYModelData) ) ;
+	memcpy( model, image, ( entry->imageSize < sizeof(SKYModelData) ) ? entry->imageSize : sizeof(SKYModelData) ) ;
+	return 1 ;
+}
+
+// Load the models from a model library (.mlb)
+uint32_t rawloadModelLibrary( t_radioData *radioData, uint8_t *data, uint32_t size )
+{
+	struct t_model_library_header *header = (struct t_model_library_header *) data ;
+	struct t_model_library_entry *entry ;
+	uint32_t i ;
+
+	if ( ( size < sizeof(*header) ) || memcmp( header->id, "MLB1", 4 )
+			 || ( size < sizeof(*header) + header->count * sizeof(*entry) )
+			 || ( size < header->chunkOffset + header->chunkCount * sizeof(struct t_model_library_chunk) ) )
+	{
+		return 0 ;
+	}
+	// Only the names are read here, the models when used
+	ee32SetModelSource( radioData, data, size, MODEL_SOURCE_LIBRARY ) ;
+	for ( i = 0 ; i < MAX_IMODELS ; i += 1 )
+	{
+		memset( &radioData->models[i], 0, sizeof(SKYModelData) ) ;
+		radioData->File_system[i+1].size = 0 ;
+		memset( radioData->ModelNames[i+1], ' ', sizeof( radioData->models[0].name) ) ;
+		if ( i >= header->count )
+		{
+			continue ;
+		}
+		entry = (struct t_model_library_entry *) ( data + sizeof(*header) + i * sizeof(*entry) ) ;
+		if ( entry->offset == 0 )
+		{
+			continue ;
+		}
+		radioData->modelPending[i] = 1 ;
+		radioData->File_system[i+1].size = sizeof(SKYModelData) ;
+		memcpy( radioData->ModelNames[i+1], entry->name, sizeof( radioData->models[0].name) ) ;
+		radioData->ModelNames[i+1][sizeof( radioData->models[0].name)+1] = '\0' ;
+	}
+	radioData->valid = 1 ;
+	return 1 ;
+}
 
 uint32_t rawsaveFile( t_radioData *radioData, uint8_t *eeprom )
 {
@@ -83,6 +83,62 @@ struct t_eeprom_header
 	uint8_t hcsum ;
 } ;
 
+// Model archive written by the radio, see the radio's file.h
+#define MODEL_ARCHIVE_RLE		0x01
+
+struct t_model_archive_header
+{
+	uint8_t id[4] ;				// "MBK1"
+	uint8_t version ;
+	uint8_t count ;				// Entries in index
+	uint16_t modelSize ;
+} ;
+
+struct t_model_archive_entry
+{
+	uint32_t offset ;			// From start of file, 0 no model
+	uint16_t size ;				// Bytes in file
+	uint16_t imageSize ;	// Bytes when unpacked
+	uint16_t check ;			// Fletcher 16 of unpacked image
+	uint8_t flags ;
+	uint8_t spare ;
+	uint8_t name[10] ;
+} ;
+
+// Model library, models split into chunks, each different chunk stored once
+#define MODEL_LIBRARY_CHUNK		64
+#define MODEL_LIBRARY_CHUNKS	((sizeof(SKYModelData)+MODEL_LIBRARY_CHUNK-1)/MODEL_LIBRARY_CHUNK)
+
+struct t_model_library_header
+{
+	uint8_t id[4] ;				// "MLB1"
+	uint8_t version ;
+	uint8_t chunkSize ;
+	uint16_t count ;			// Entries in index
+	uint16_t modelSize ;
+	uint16_t chunkCount ;	// Different chunks
+	uint32_t chunkOffset ;	// Chunk table
+} ;
+
+// Each model is a list of chunk numbers at offset, a uint16_t for every
+// chunkSize bytes of the image
+struct t_model_library_entry
+{
+	uint32_t offset ;			// From start of file, 0 no model
+	uint16_t imageSize ;
+	uint16_t check ;			// Fletcher 16 of image
+	uint8_t name[10] ;
+	uint8_t spare[2] ;
+} ;
+
+struct t_model_library_chunk
+{
+	uint32_t offset ;			// From start of file
+	uint16_t size ;				// Bytes in file
+	uint8_t flags ;				// MODEL_ARCHIVE_RLE
+	uint8_t spare ;
+} ;
+
 struct t_eeprom_block
 {
 	struct t_eeprom_header header ;
@@ -106,11 +162,27 @@ struct t_radioData
 		uint32_t options ;
 		uint32_t T9xr_pro ;
 		uint32_t extraPots ;
-
+		// Models are decoded from source when first used
+		uint8_t *source ;
+		uint32_t sourceSize ;
+		uint32_t sourceType ;
+		uint8_t modelPending[MAX_IMODELS] ;
 } ;
 
+#define MODEL_SOURCE_NONE			0
+#define MODEL_SOURCE_EEPROM		1		// SKY type EEPROM image
+#define MODEL_SOURCE_RLC			2		// Taranis type EEPROM image
+#define MODEL_SOURCE_LIBRARY	3		// Model library (.mlb)
+#define MODEL_SOURCE_XML			4		// Decoded by MdiChild
+
 uint32_t rawloadFile( t_radioData *radioData, uint8_t *eeprom ) ;
 uint32_t rawsaveFile( t_radioData *radioData, uint8_t *eeprom ) ;
+uint32_t rawloadModelArchive( t_radioData *radioData, uint8_t *data, uint32_t size ) ;
+uint32_t rawloadModelLibrary( t_radioData *radioData, uint8_t *data, uint32_t size ) ;
+uint32_t rawsaveModelLibrary( t_radioData *radioData, uint8_t *data, uint32_t size ) ;
+uint32_t libraryLoadModel( uint8_t *data, uint32_t size, uint32_t index, SKYModelData *model ) ;
+void ee32SetModelSource( t_radioData *radioData, uint8_t *data, uint32_t size, uint32_t type ) ;
+void ee32ModelNeeded( t_radioData *radioData, uint32_t id ) ;
 
 //class EFile
 //{
@@ -194,7 +194,7 @@ MainWindow::MainWindow()
             burnToFlash(str);
         }
 
-        if(fileType==FILE_TYPE_EEPE || fileType==FILE_TYPE_EEPM  || fileType==FILE_TYPE_EEPG)
+        if(fileType==FILE_TYPE_EEPE || fileType==FILE_TYPE_EEPM  || fileType==FILE_TYPE_EEPG || fileType==FILE_TYPE_MBK || fileType==FILE_TYPE_MLB)
         {
             MdiChild *child = createMdiChild();
             if (child->loadFile(str))
@@ -82,6 +82,10 @@ MdiChild::MdiChild()
     //setWindowFlags(Qt::WindowTitleHint | Qt::WindowSystemMenuHint);
 
 		radioData.valid = 0 ;
+		radioData.source = 0 ;
+		radioData.sourceSize = 0 ;
+		radioData.sourceType = MODEL_SOURCE_NONE ;
+		memset( radioData.modelPending, 0, sizeof(radioData.modelPending) ) ;
 		changed = false ;
 		defaultModelType = 1 ;
 
@@ -305,6 +309,7 @@ void MdiChild::deleteSelected(bool ask=true)
            		if(index.row()>0)
 							{
                 radioData.File_system[index.row()].size = 0 ;
+								radioData.modelPending[index.row()-1] = 0 ;
 					 	//XXXXXXXXXXXX
 //							 	eeFile.DeleteModel(index.row());
 							}
@@ -373,6 +378,7 @@ void MdiChild::doCopy(QByteArray *gmData)
           if ( radioData.File_system[index.row()].size )
           {
             SKYModelData tmod;
+						modelNeeded( index.row()-1 ) ;
             memcpy( &tmod, &radioData.models[index.row()-1], sizeof( tmod ) ) ;
             gmData->append('m');
             gmData->append((char*)&tmod,sizeof(tmod));
@@ -656,6 +662,10 @@ void MdiChild::saveModelToFile()
     int cmod = currentRow()-1;
     bool genfile = currentRow()==0;
 
+		if ( !genfile )
+		{
+			modelNeeded( cmod ) ;
+		}
 //    ModelData tmod;
 //    EEGeneral tgen;
     QString fileName;
@@ -768,6 +778,7 @@ void MdiChild::duplicate()
             if(j<max_models)
 						{
 //							 eeFile.putModel(&gmodel,j);
+							modelNeeded( i ) ;
       	      memcpy( &radioData.models[j], &radioData.models[i], sizeof( radioData.models[0] ) ) ;
 			        setModelFile( j ) ;
 							setModified();
@@ -840,6 +851,7 @@ void MdiChild::OpenEditWindow()
 
 				radioData.extraPots = countExtraPots( &radioData.generalSettings) ;
     		QString mname = modelName(i-1) ;
+				modelNeeded( i-1 ) ;
         ModelEdit *t = new ModelEdit( &radioData,(i-1),this);
         
 				if(isNew) t->applyBaseTemplate();
@@ -1138,18 +1150,25 @@ bool MdiChild::loadFile(const QString &fileName, bool resetCurrentFile)
 						max_models = MAX_IMODELS ;
 					}
 
-          for(uint32_t i=0; i<max_models; i++)
+					// Only the names are read here, the model data when used
+					ee32SetModelSource( &radioData, 0, 0, MODEL_SOURCE_XML ) ;
+					xmlSource = doc ;
+          QDomNodeList ndl = doc.elementsByTagName("MODEL_DATA") ;
+          for ( int k = 0 ; k < ndl.count() ; k += 1 )
           {
-            SKYModelData tmod;
-            memset(&tmod,0,sizeof(tmod));
-            if(loadModelDataXML(&doc, &tmod, i))
+            QDomElement e = ndl.at(k).toElement() ;
+            uint32_t i = e.attribute("number").toInt() ;
+            if ( ( i >= max_models ) || radioData.modelPending[i] )
             {
-              radioData.File_system[i+1].size = sizeof(tmod) ;
-              memcpy( &radioData.models[i], &tmod, sizeof( tmod ) ) ;
-              memcpy( &radioData.ModelNames[i+1], &radioData.models[i].name, sizeof( radioData.models[0].name) ) ;
-              radioData.ModelNames[i+1][sizeof( radioData.models[0].name)+1] = '\0' ;
-              getNotesFromXML(&doc, i);
+              continue ;
             }
+            QByteArray name = e.elementsByTagName("Name").at(0).toElement().text().toLatin1() ;
+            memset( &radioData.models[i], 0, sizeof( radioData.models[0] ) ) ;
+            memset( &radioData.ModelNames[i+1], ' ', sizeof( radioData.models[0].name) ) ;
+            memcpy( &radioData.ModelNames[i+1], name.data(), qMin( (int)name.length(), (int)sizeof( radioData.models[0].name) ) ) ;
+            radioData.ModelNames[i+1][sizeof( radioData.models[0].name)+1] = '\0' ;
+            radioData.File_system[i+1].size = sizeof( radioData.models[0] ) ;
+            radioData.modelPending[i] = 1 ;
           }
 					radioData.valid = 1 ;
 //          ee32_read_model_names(&radioData) ;
@@ -1195,6 +1214,59 @@ bool MdiChild::loadFile(const QString &fileName, bool resetCurrentFile)
     }
 
 
+    if(fileType==FILE_TYPE_MBK) //read radio model backup
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            QMessageBox::critical(this, tr("Error"),
+                                 tr("Error opening file %1:\n%2.")
+                                 .arg(fileName)
+                                 .arg(file.errorString()));
+            return false;
+        }
+        QByteArray archive = file.readAll() ;
+        file.close();
+
+        if(!rawloadModelArchive( &radioData, (uint8_t *)archive.data(), archive.size() ) )
+        {
+            QMessageBox::critical(this, tr("Error"),
+                                 tr("Error loading file %1:\n"
+                                    "File may be corrupted, old or from a different system.")
+                                 .arg(fileName));
+            return false;
+        }
+        refreshList();
+        return true;
+    }
+
+    if(fileType==FILE_TYPE_MLB) //read model library
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            QMessageBox::critical(this, tr("Error"),
+                                 tr("Error opening file %1:\n%2.")
+                                 .arg(fileName)
+                                 .arg(file.errorString()));
+            return false;
+        }
+        QByteArray library = file.readAll() ;
+        file.close();
+
+        if(!rawloadModelLibrary( &radioData, (uint8_t *)library.data(), library.size() ) )
+        {
+            QMessageBox::critical(this, tr("Error"),
+                                 tr("Error loading file %1:\n"
+                                    "File may be corrupted, old or from a different system.")
+                                 .arg(fileName));
+            return false;
+        }
+        refreshList();
+        if(resetCurrentFile) setCurrentFile(fileName);
+        return true;
+    }
+
     if(fileType==FILE_TYPE_BIN) //read binary
     {
         QFile file(fileName);
@@ -1442,6 +1514,8 @@ bool MdiChild::saveFile(const QString &fileName, bool setCurrent)
 {
     QFile file(fileName);
 
+		allModelsNeeded() ;
+
     int fileType = getFileType(fileName);
 
 
@@ -1505,6 +1579,34 @@ bool MdiChild::saveFile(const QString &fileName, bool setCurrent)
 //        return true;
 //    }
 
+    if(fileType==FILE_TYPE_MLB) //write model library
+    {
+        if (!file.open(QFile::WriteOnly)) {
+            QMessageBox::warning(this, tr("Error"),
+                                 tr("Cannot write file %1:\n%2.")
+                                 .arg(fileName)
+                                 .arg(file.errorString()));
+            return false;
+        }
+
+        QByteArray library ;
+        library.resize( rawsaveModelLibrary( &radioData, 0, 0 ) ) ;
+        rawsaveModelLibrary( &radioData, (uint8_t *)library.data(), library.size() ) ;
+        long result = file.write( library ) ;
+        file.close();
+        if(result != library.size())
+        {
+            QMessageBox::warning(this, tr("Error"),
+                                 tr("Error writing file %1:\n%2.")
+                                 .arg(fileName)
+                                 .arg(file.errorString()));
+            return false;
+        }
+
+        if(setCurrent) setCurrentFile(fileName);
+        return true;
+    }
+
     if(fileType==FILE_TYPE_BIN) //write binary
     {
         if (!file.open(QFile::WriteOnly)) {
@@ -1549,6 +1651,7 @@ QString MdiChild::userFriendlyCurrentFile()
 void MdiChild::closeEvent(QCloseEvent *event)
 {
     if (maybeSave()) {
+				ee32SetModelSource( &radioData, 0, 0, MODEL_SOURCE_NONE ) ;
         event->accept();
     } else {
         event->ignore();
@@ -1659,6 +1762,8 @@ int MdiChild::getFileType(const QString &fullFileName)
     if(QFileInfo(fullFileName).suffix().toUpper()=="EEPM") return FILE_TYPE_EEPM;
     if(QFileInfo(fullFileName).suffix().toUpper()=="EEPG") return FILE_TYPE_EEPG;
     if(QFileInfo(fullFileName).suffix().toUpper()=="EEPE") return FILE_TYPE_EEPE;
+    if(QFileInfo(fullFileName).suffix().toUpper()=="MBK")  return FILE_TYPE_MBK;
+    if(QFileInfo(fullFileName).suffix().toUpper()=="MLB")  return FILE_TYPE_MLB;
     return 0;
 }
 
@@ -1866,6 +1971,7 @@ void MdiChild::simulate()
     SKYModelData gm;
 		if( !radioData.File_system[0].size ) return ;
     if( !radioData.File_system[currentRow()].size ) return ;
+		modelNeeded( currentRow()-1 ) ;
     memcpy( &gg, &radioData.generalSettings, sizeof(EEGeneral) ) ;
     memcpy( &gm, &radioData.models[currentRow()-1], sizeof(SKYModelData) ) ;
 #else
@@ -1889,6 +1995,7 @@ void MdiChild::print()
 
 #ifdef SKY
     SKYModelData gm;
+		modelNeeded( currentRow()-1 ) ;
 		memcpy( &gg, &radioData.generalSettings, sizeof(EEGeneral) ) ;
     memcpy( &gm, &radioData.models[currentRow()-1], sizeof(SKYModelData) ) ;
 #else
@@ -2024,12 +2131,40 @@ void MdiChild::modelDefault(uint8_t id)
 void MdiChild::setModelFile(uint8_t id)
 {
 	radioData.File_system[id+1].size = sizeof(radioData.models[0]) ;
+	radioData.modelPending[id] = 0 ;
 	memcpy( &radioData.ModelNames[id+1], &radioData.models[id].name, sizeof( radioData.models[0].name) ) ;
 	radioData.ModelNames[id+1][sizeof( radioData.models[0].name)+1] = '\0' ;
 	radioData.valid = 1 ;
   refreshList() ;
 }
 
+// Models are decoded from the loaded file when first used
+void MdiChild::modelNeeded(int id)
+{
+	if ( ( id < 0 ) || ( id >= MAX_IMODELS ) || ( radioData.modelPending[id] == 0 ) )
+	{
+		return ;
+	}
+	if ( radioData.sourceType == MODEL_SOURCE_XML )
+	{
+		radioData.modelPending[id] = 0 ;
+		loadModelDataXML( &xmlSource, &radioData.models[id], id ) ;
+		getNotesFromXML( &xmlSource, id ) ;
+	}
+	else
+	{
+		ee32ModelNeeded( &radioData, id ) ;
+	}
+}
+
+void MdiChild::allModelsNeeded()
+{
+	for ( int i = 0 ; i < MAX_IMODELS ; i += 1 )
+	{
+		modelNeeded( i ) ;
+	}
+}
+
 void convertEr9xSwitch( int8_t *p )
 {
 	int x = *p ;
@@ -47,6 +47,8 @@
 #define FILE_TYPE_EEPE 3
 #define FILE_TYPE_EEPM 4
 #define FILE_TYPE_EEPG 5
+#define FILE_TYPE_MBK  6
+#define FILE_TYPE_MLB  7
 
 #include <QtGui>
 #include <QtXml>
@@ -75,8 +77,10 @@
 #define EEPE_FILES_FILTER    "EEPE EEPROM files (*.eepe);;"
 #define EEPM_FILES_FILTER    "EEPE MODEL files (*.eepm);;"
 #define EEPG_FILES_FILTER    "EEPE GENERAL SETTINGS files (*.eepg);;"
-#define EEPE_ALL_FILES_FILTER    "All EEPE files (*.eepe *.eepm *.eepg *.bin *.hex);;"
-#define EEPROM_FILES_FILTER  BIN_FILES_FILTER EEPE_FILES_FILTER EEPE_ALL_FILES_FILTER EEPM_FILES_FILTER EEPG_FILES_FILTER HEX_FILES_FILTER
+#define MBK_FILES_FILTER     "Radio model backup files (*.mbk);;"
+#define MLB_FILES_FILTER     "Model library files (*.mlb);;"
+#define EEPE_ALL_FILES_FILTER    "All EEPE files (*.eepe *.eepm *.eepg *.bin *.hex *.mbk *.mlb);;"
+#define EEPROM_FILES_FILTER  BIN_FILES_FILTER EEPE_FILES_FILTER EEPE_ALL_FILES_FILTER EEPM_FILES_FILTER EEPG_FILES_FILTER HEX_FILES_FILTER MBK_FILES_FILTER MLB_FILES_FILTER
 #define FLASH_FILES_FILTER   "FLASH files (*.bin *.hex);;" BIN_FILES_FILTER HEX_FILES_FILTER
 #define EXTERNAL_EEPROM_FILES_FILTER   "EEPROM files (*.bin *.hex);;" BIN_FILES_FILTER HEX_FILES_FILTER
 
@@ -116,6 +120,9 @@ private:
 		void generalDefault() ;
 		void modelDefault(uint8_t id) ;
 		void setModelFile(uint8_t id) ;
+		void modelNeeded(int id) ;
+		void allModelsNeeded() ;
+		QDomDocument xmlSource ;
 
 //    ModelData g_model;
 //    EEGeneral g_eeGeneral;
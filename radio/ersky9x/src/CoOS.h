@@ -135,6 +135,13 @@ extern "C" StatusType  CoSuspendTask(OS_TID taskID);
 extern "C" StatusType  CoSetPriority(OS_TID taskID,U8 priority);
 extern "C" OS_TID      CreateTask(FUNCPtr task,void *argv,U32 parameter,OS_STK *stk);
 
+#if CFG_TASK_PROFILE_EN > 0
+#define CO_TASK_SLOTS   (CFG_MAX_USER_TASKS+1)     /* User tasks and idle task */
+extern "C" void        CoUpdateTaskProfile(void);
+extern "C" U16         CoGetTaskCpu(OS_TID taskID);
+extern "C" U16         CoGetStackSize(OS_TID taskID);
+#endif
+
 /* Implement in file "time.c"      */
 extern "C" U64         CoGetOSTime(void);
 extern "C" StatusType  CoTickDelay(U32 ticks);
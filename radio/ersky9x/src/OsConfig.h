@@ -125,6 +125,11 @@ Enable(1) or disable(0) stack overflow checkout .
 */		
 #define CFG_STK_CHECKOUT_EN     (0)		
 
+/*!< 
+Enable(1) or disable(0) per task run time and stack high water accounting.
+*/		
+#define CFG_TASK_PROFILE_EN     (0)		
+
 
 
 /*---------------------- Memory Management Config ----------------------------*/
@@ -49,6 +49,7 @@
 #include "drivers.h"
 #include "stringidx.h"
 #include "ff.h"
+#include "base64.h"
 #ifndef SIMU
 #include "CoOS.h"
 #endif
@@ -243,39 +244,78 @@ void modelDefault(uint8_t id)
 }
 
 
-static uint8_t EeFsRead(blkid_t blk, uint8_t ofs)
+// RAM copy of the link byte of every block, loaded by EeFsOpen(), and
+// a bitmap of the blocks on the free list
+blkid_t EeFsLinks[BLOCKS] ;
+uint32_t EeFsFreeMap[(BLOCKS+31)/32] ;
+
+static void EeFsGetData(blkid_t blk, uint8_t ofs, uint8_t *buf, uint8_t len)
 {
-  uint8_t ret;
-#if defined(CPUARM)
-  eeprom_read_block(&ret, (uint16_t)(blk*BS+ofs+BLOCKS_OFFSET), 1);
-#elif defined(SIMU)
-  eeprom_read_block(&ret, (const void*)(uint64_t)(blk*BS+ofs+BLOCKS_OFFSET), 1);
-#endif
-  return ret;
+  eeprom_read_block(buf, (uint16_t)(blk*BS+ofs+sizeof(blkid_t)+BLOCKS_OFFSET), len);
 }
 
 static blkid_t EeFsGetLink(blkid_t blk)
 {
-  blkid_t ret;
-  eeprom_read_block((uint8_t *)&ret, blk*BS+BLOCKS_OFFSET, sizeof(blkid_t));
-  return ret;
+  return EeFsLinks[blk] ;
 }
 
 static void EeFsSetLink(blkid_t blk, blkid_t val)
 {
-  static blkid_t s_link; // we write asynchronously, then nothing on the stack!
-  s_link = val;
-  eeWriteBlockCmp((uint8_t *)&s_link, (blk*BS)+BLOCKS_OFFSET, sizeof(blkid_t));
+  EeFsLinks[blk] = val ;
+  eeWriteBlockCmp((uint8_t *)&EeFsLinks[blk], (blk*BS)+BLOCKS_OFFSET, sizeof(blkid_t));
+}
+
+// Write link and data of a block, len bytes from the start of the block
+static void EeFsWriteBlock(blkid_t blk, uint8_t *buf, uint8_t len)
+{
+  EeFsLinks[blk] = buf[0] ;
+  eeWriteBlockCmp(buf, (blk*BS)+BLOCKS_OFFSET, len);
 }
 
-static uint8_t EeFsGetDat(blkid_t blk, uint8_t ofs)
+static uint32_t EeFsIsFree(blkid_t blk)
 {
-  return EeFsRead(blk, ofs+sizeof(blkid_t));
+  return EeFsFreeMap[blk >> 5] & ( 1 << (blk & 31) ) ;
 }
 
-static void EeFsSetDat(blkid_t blk, uint8_t ofs, uint8_t *buf, uint8_t len)
+static void EeFsMarkFree(blkid_t blk)
 {
-  eeWriteBlockCmp(buf, (blk*BS)+ofs+sizeof(blkid_t)+BLOCKS_OFFSET, len);
+  EeFsFreeMap[blk >> 5] |= 1 << (blk & 31) ;
+  freeBlocks++;
+}
+
+static void EeFsMarkUsed(blkid_t blk)
+{
+  EeFsFreeMap[blk >> 5] &= ~( 1 << (blk & 31) ) ;
+  freeBlocks--;
+}
+
+// Rebuild the free bitmap from the free list
+static void EeFsBuildFreeMap()
+{
+  blkidL_t count = 0 ;
+  blkid_t blk = eeFs.freeList ;
+
+  memclear( EeFsFreeMap, sizeof(EeFsFreeMap) ) ;
+  freeBlocks = 0 ;
+  while ( blk && ( count++ < BLOCKS ) )
+  {
+    EeFsMarkFree( blk ) ;
+    blk = EeFsGetLink( blk ) ;
+  }
+}
+
+// Take the first block of the free list, the caller flushes the free list
+static blkid_t EeFsAlloc()
+{
+  blkid_t blk = eeFs.freeList ;
+
+  if ( blk && EeFsIsFree( blk ) )
+  {
+    eeFs.freeList = EeFsGetLink( blk ) ;
+    EeFsMarkUsed( blk ) ;
+    return blk ;
+  }
+  return 0 ;		// Empty, or the free list is corrupt
 }
 
 static void EeFsFlushFreelist()
@@ -308,11 +348,11 @@ static void EeFsFree(blkid_t blk)
   blkid_t i = blk;
   blkid_t tmp;
 
-  freeBlocks++;
+  EeFsMarkFree(i);
 
   while ((tmp=EeFsGetLink(i))) {
     i = tmp;
-    freeBlocks++;
+    EeFsMarkFree(i);
   }
 
   EeFsSetLink(i, eeFs.freeList);
@@ -366,19 +406,17 @@ int8_t EeFsck()
 
   }
 
-  freeBlocks = blocksCount;
-
   for (blk=FIRSTBLK; blk<BLOCKS; blk++)
 	{
     if (!bufp[blk])
 		{ // unused block
-      freeBlocks++;
       EeFsSetLink(blk, eeFs.freeList);
       eeFs.freeList = blk; // chain in front
       EeFsFlushFreelist();
     }
     wdt_reset();
   }
+  EeFsBuildFreeMap() ;
 
   ENABLE_SYNC_WRITE(false);
 
@@ -401,7 +439,7 @@ void EeFsFormat()
   }
   EeFsSetLink(BLOCKS-1, 0);
   eeFs.freeList = FIRSTBLK;
-  freeBlocks = BLOCKS ;
+  EeFsBuildFreeMap() ;
   EeFsFlush();
 
   ENABLE_SYNC_WRITE(false);
@@ -411,6 +449,12 @@ bool EeFsOpen()
 {
   eeprom_read_block((uint8_t *)&eeFs, 0, sizeof(eeFs));
 
+  EeFsLinks[0] = 0 ;
+  for (blkidL_t i=FIRSTBLK; i<BLOCKS; i++)
+	{
+    eeprom_read_block(&EeFsLinks[i], (uint16_t)(i*BS+BLOCKS_OFFSET), sizeof(blkid_t));
+  }
+
 #ifdef SIMU
   if (eeFs.version != EEFS_VERS) {
     printf("bad eeFs.version (%d instead of %d)\n", eeFs.version, EEFS_VERS);
@@ -483,13 +527,18 @@ uint8_t EFile::read(uint8_t *buf, uint8_t i_len)
   uint8_t remaining = i_len;
   while (remaining) {
     if (!m_currBlk) break;
-  
-    *buf++ = EeFsGetDat(m_currBlk, m_ofs++);
+
+    // As much as possible from this block in one read
+    uint8_t count = BS-sizeof(blkid_t)-m_ofs;
+    if (count > remaining) count = remaining;
+    EeFsGetData(m_currBlk, m_ofs, buf, count);
+    buf += count;
+    m_ofs += count;
     if (m_ofs >= BS-sizeof(blkid_t)) {
       m_ofs = 0;
       m_currBlk = EeFsGetLink(m_currBlk);
     }
-    remaining--;
+    remaining -= count;
   }
 
   i_len -= remaining;
@@ -543,70 +592,81 @@ void RlcFile::write(uint8_t *buf, uint8_t i_len)
   m_write_len = i_len;
   m_write_buf = buf;
 
-  do {
+  // When not synchronous the data is taken by nextWriteStep()
+  while (IS_SYNC_WRITE_ENABLE() && m_write_len && !s_write_err) {
     nextWriteStep();
-  } while (IS_SYNC_WRITE_ENABLE() && m_write_len && !s_write_err);
+  }
 }
 
+/*
+ * Data is collected in m_blkBuf and each block is written, link and
+ * data, with a single EEPROM write when it is full or the file is closed.
+ * Returns after each EEPROM write, copies to the buffer run on.
+ */
 void RlcFile::nextWriteStep()
 {
-  if (!m_currBlk && m_pos==0) {
-    eeFs.files[FILE_TMP].startBlk = m_currBlk = eeFs.freeList;
-    if (m_currBlk) {
-      freeBlocks--;
-      eeFs.freeList = EeFsGetLink(m_currBlk);
-      m_write_step |= WRITE_FIRST_LINK;
-      EeFsFlushFreelist();
-      return;
+  for (;;) {
+    if (!m_write_len) {
+      if (s_write_err || IS_SYNC_WRITE_ENABLE() || !isWriting()) {
+        break;
+      }
+      nextRlcWriteStep();
+      if (!m_write_len) {
+        return;    // A directory or free list write was done
+      }
+      continue;
     }
-  }
 
-  if ((m_write_step & 0x0f) == WRITE_FIRST_LINK) {
-    m_write_step -= WRITE_FIRST_LINK;
-    EeFsSetLink(m_currBlk, 0);
-    return;
-  }
+    if (!m_currBlk && m_pos==0) {
+      eeFs.files[FILE_TMP].startBlk = m_currBlk = EeFsAlloc();
+      if (m_currBlk) {
+        m_blkBuf[0] = 0;
+        m_blkDirty = 1;
+        EeFsFlushFreelist();
+        return;
+      }
+    }
 
-  while (m_write_len) {
     if (!m_currBlk) {
       s_write_err = ERR_FULL;
       break;
     }
+
+    if (!m_blkDirty) {
+      // Starting on a block of the chain already in FILE_TMP
+      m_blkBuf[0] = EeFsGetLink(m_currBlk);
+      m_blkDirty = 1;
+    }
+
     if (m_ofs >= (BS-sizeof(blkid_t))) {
-      m_ofs = 0;
-      blkid_t nextBlk = EeFsGetLink(m_currBlk);
-      if (!nextBlk) {
-        if (!eeFs.freeList) {
+      if (!m_blkBuf[0]) {
+        m_blkBuf[0] = EeFsAlloc();
+        if (!m_blkBuf[0]) {
           s_write_err = ERR_FULL;
           break;
         }
-        m_write_step += WRITE_NEXT_LINK_1;
-        EeFsSetLink(m_currBlk, eeFs.freeList);
-        // TODO not good
-        return;
-      }
-      m_currBlk = nextBlk;
-    }
-    switch (m_write_step & 0x0f) {
-      case WRITE_NEXT_LINK_1:
-        m_currBlk = eeFs.freeList;
-        freeBlocks--;
-        eeFs.freeList = EeFsGetLink(eeFs.freeList);
-        m_write_step += 1;
+        m_write_step |= WRITE_NEXT_LINK;
         EeFsFlushFreelist();
         return;
-      case WRITE_NEXT_LINK_2:
-        m_write_step -= WRITE_NEXT_LINK_2;
-        EeFsSetLink(m_currBlk, 0);
-        return;
+      }
+      writeBlock();
+      m_currBlk = EeFsGetLink(m_currBlk);
+      m_ofs = 0;
+      if (m_write_step & WRITE_NEXT_LINK) {
+        // New block, don't follow its free list link
+        m_write_step &= ~WRITE_NEXT_LINK;
+        m_blkBuf[0] = 0;
+        m_blkDirty = 1;
+      }
+      return;
     }
+
     uint8_t tmp = BS-sizeof(blkid_t)-m_ofs; if(tmp>m_write_len) tmp = m_write_len;
+    memcpy(&m_blkBuf[sizeof(blkid_t)+m_ofs], m_write_buf, tmp);
     m_write_buf += tmp;
     m_write_len -= tmp;
     m_ofs += tmp;
     m_pos += tmp;
-    EeFsSetDat(m_currBlk, m_ofs-tmp, m_write_buf-tmp, tmp);
-    return;
   }
 
   if (s_write_err == ERR_FULL) {
@@ -614,12 +674,17 @@ void RlcFile::nextWriteStep()
     m_write_step = 0;
     m_write_len = 0;
     m_cur_rlc_len = 0;
-  }
-  else if (!IS_SYNC_WRITE_ENABLE()) {
-    nextRlcWriteStep();
+    m_blkDirty = 0;
   }
 }
 
+// Write the buffered part of the current block
+void RlcFile::writeBlock()
+{
+  m_blkDirty = 0;
+  EeFsWriteBlock(m_currBlk, m_blkBuf, sizeof(blkid_t)+m_ofs);
+}
+
 void RlcFile::create(uint8_t i_fileId, uint8_t typ, uint8_t sync_write)
 {
   // all write operations will be executed on FILE_TMP
@@ -627,6 +692,7 @@ void RlcFile::create(uint8_t i_fileId, uint8_t typ, uint8_t sync_write)
   eeFs.files[FILE_TMP].typ      = typ;
   eeFs.files[FILE_TMP].size     = 0;
   m_fileId = i_fileId;
+  m_blkDirty = 0;
   ENABLE_SYNC_WRITE(sync_write);
 }
 
@@ -652,7 +718,12 @@ bool RlcFile::copy(uint8_t i_fileDst, uint8_t i_fileSrc)
   }
 
   blkid_t fri=0;
-  if (m_currBlk && (fri=EeFsGetLink(m_currBlk)))
+  if (m_blkDirty) {
+    fri = m_blkBuf[0];
+    m_blkBuf[0] = 0;
+    writeBlock();
+  }
+  else if (m_currBlk && (fri=EeFsGetLink(m_currBlk)))
     EeFsSetLink(m_currBlk, 0);
 
   if (fri) EeFsFree(fri);  //chain in
@@ -900,23 +971,19 @@ void RlcFile::nextRlcWriteStep()
 
    switch(m_write_step) {
      case WRITE_START_STEP:
-     {
-       blkid_t fri=0;
-
-       if (m_currBlk && (fri=EeFsGetLink(m_currBlk))) {
-         // TODO reuse EeFsFree!!!
-         blkid_t prev_freeList = eeFs.freeList;
-         eeFs.freeList = fri;
-         freeBlocks++;
-         while( EeFsGetLink(fri)) {
-           fri = EeFsGetLink(fri);
-           freeBlocks++;
-         }
-         m_write_step = WRITE_FREE_UNUSED_BLOCKS_STEP1;
-         EeFsSetLink(fri, prev_freeList);
+       // Last block, with the unused part of the old chain cut off
+       if (m_blkDirty) {
+         m_tailBlk = m_blkBuf[0];
+         m_blkBuf[0] = 0;
+         m_write_step = m_tailBlk ? WRITE_FREE_UNUSED_BLOCKS_STEP : WRITE_FINAL_DIRENT_STEP;
+         writeBlock();
+         return;
+       }
+       if (m_currBlk && (m_tailBlk=EeFsGetLink(m_currBlk))) {
+         m_write_step = WRITE_FREE_UNUSED_BLOCKS_STEP;
+         EeFsSetLink(m_currBlk, 0);
          return;
        }
-     }
 
      case WRITE_FINAL_DIRENT_STEP:
      {
@@ -937,14 +1004,9 @@ void RlcFile::nextRlcWriteStep()
        EeFsFlushDirEnt(FILE_TMP);
        return;
 
-     case WRITE_FREE_UNUSED_BLOCKS_STEP1:
-       m_write_step = WRITE_FREE_UNUSED_BLOCKS_STEP2;
-       EeFsSetLink(m_currBlk, 0);
-       return;
-
-     case WRITE_FREE_UNUSED_BLOCKS_STEP2:
+     case WRITE_FREE_UNUSED_BLOCKS_STEP:
        m_write_step = WRITE_FINAL_DIRENT_STEP;
-       EeFsFlushFreelist();
+       EeFsFree(m_tailBlk);
        return;
    }
 }
@@ -1398,194 +1460,6 @@ void setModelFilename( uint8_t *filename, uint8_t modelIndex, uint32_t type )
 	cpystr( bptr, type ? (uint8_t *)".txt" : (uint8_t *)".eepm" ) ;		// ".eepm"
 }
 
-static const uint8_t base64digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" ;
-
-// write XML file
-FRESULT writeXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalWritten )
-{
-  UINT written ;
-  UINT total = 0 ;
-	uint32_t i ;
-	FRESULT result ;
-  uint8_t bytes[104] ;
-
-  result = f_write( archiveFile, (BYTE *)"<!DOCTYPE ERSKY9X_EEPROM_FILE>\n<ERSKY9X_EEPROM_FILE>\n <MODEL_DATA number=\0420\042>\n  <Version>", 89, &written ) ;
-	total += written ;
-// MDVERS (2)
-  bytes[0] = MDSKYVERS + '0' ;
-  bytes[1] = 0 ;
-  result = f_write( archiveFile, bytes, 1, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Version>\n  <Name>", 19, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)TempModelStore.name, sizeof(g_model.name), &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Name>\n  <Data><![CDATA[", 25, &written) ;
-	total += written ;
-
-// Send base 64 here
-	i = 0 ;
-	while ( size > 2 )
-	{
-		bytes[i++] = base64digits[data[0] >> 2];
- 		bytes[i++] = base64digits[((data[0] << 4) & 0x30) | (data[1] >> 4)];
-		bytes[i++] = base64digits[((data[1] << 2) & 0x3c) | (data[2] >> 6)];
-		bytes[i++] = base64digits[data[2] & 0x3f];
-		data += 3 ;
-		size -= 3 ;
-		if ( i >= 100 )
-		{
-		  result = f_write( archiveFile, bytes, 100, &written) ;
-			total += written ;
-			i = 0 ;
-		}
-	}
-
-	uint8_t fragment ;
-	if ( size )
-	{
-		bytes[i++] = base64digits[data[0] >> 2] ;
-		fragment = (data[0] << 4) & 0x30 ;
-		if ( --size )
-		{
- 			fragment |= data[1] >> 4 ;
-			bytes[i++] = base64digits[fragment];
-		}
-		bytes[i++] = ( size == 2 ) ? base64digits[(data[1] << 2) & 0x3c] : '=' ;
-		bytes[i++] = '=' ;
-		result = f_write( archiveFile, bytes, i, &written) ;
-		total += written ;
-	}
-  result = f_write( archiveFile, (BYTE *)"]]></Data>\n </MODEL_DATA>\n</ERSKY9X_EEPROM_FILE>\n", 49, &written) ;
-	total += written ;
-	*totalWritten = total ;
- return result ;
-}
-
-uint8_t xmlDecode( uint8_t value )
-{
-	if ( value >= 'A' )
-	{
-		if ( value <= 'Z' )
-		{
-			return value - 'A' ;
-		}
-		return value - ( 'a' - 26 ) ;		// 'a'-'z'		
-	}
-	else
-	{
-		if ( value >= '0' )
-		{
-			return value + 4 ;
-		}
-		if ( value == '+' )
-		{
-			return 62 ;
-		}
-		else if ( value == '/' )
-		{
-			return 63 ;
-		}
-		else
-		{
-			return 255 ;		// '='
-		}
-	}
-}
-
-
-int32_t readXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalRead )
-{
-  UINT nread ;
-  UINT total = 0 ;
-	uint32_t i ;
-	uint32_t j ;
-	FRESULT result ;
-	uint8_t stream[4] ;
-  uint8_t bytes[104] ;
-
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	if ( strncmp( (const char *)&bytes[10], "ERSKY9X_", 8 ) )
-	{
-		return -1 ;		// Invalid file
-	}
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	// Search for "CDATA[" starting at offset 30
-	for ( i = 30 ; i < 50 ; i += 1 )
-	{
-		if ( !strncmp( (const char *)&bytes[i], "CDATA[", 6 ) )
-		{
-			break ;
-		}
-	}
-	if ( i >= 50 )
-	{
-		return -1 ;		// Invalid file
-	}
-	i += 6 ;	// Index of base64 data
-	j = 0 ;
-	while ( size )
-	{
-		if ( i >= nread )
-		{
-			result = f_read( archiveFile,  bytes, 100, &nread ) ;
-			total += nread ;
-			i = 0 ;
-		}
-		if ( i < nread )
-		{
-			uint8_t value = bytes[i] ;
-			if ( value == ']' )		// End of input data
-			{
-				stream[j++] = 0 ;
-			}
-			else
-			{
-				i += 1 ;
-				stream[j++] = xmlDecode( value ) ;
-			}
-		}
-		else
-		{
-			break ;
-		}
-		if ( j >= 4 )
-		{
-		  *data++ = ( stream[0] << 2) | (stream[1] >> 4) ;
-			size -= 1 ;
-			if ( size == 0 )
-			{
-				break ;
-			}
-			if ( stream[2] != 255 )
-			{
-		  	*data++ = ((stream[1] << 4) & 0xf0) | (stream[2] >> 2);
-				size -= 1 ;
-				if ( size == 0 )
-				{
-					break ;
-				}
-			}
-			if ( stream[3] != 255 )
-			{
-  			*data++ = ((stream[2] << 6) & 0xc0) | stream[3] ;
-				size -= 1 ;
-			}
-			j = 0 ;
-		}
-	}
-	while ( size )
-	{
-		*data++ = 0 ;
-		size -= 1 ;
-	}
-	*totalRead = total ;
-	return result ; 
-}
-
-
 const char *ee32BackupModel( uint8_t modelIndex )
 {
   uint16_t size ;
@@ -1624,7 +1498,7 @@ const char *ee32BackupModel( uint8_t modelIndex )
   }
 
 //  result = f_write(&archiveFile, (uint8_t *)&Eeprom_buffer.data.sky_model_data, size, &written) ;
-	result = writeXMLfile( &archiveFile, (uint8_t *)&TempModelStore, size, &written) ;
+	result = writeXMLfile( &archiveFile, (uint8_t *)&TempModelStore, size, &written, (uint8_t *)TempModelStore.name ) ;
   
 	f_close(&archiveFile) ;
   if (result != FR_OK ) //	|| written != size)
@@ -147,12 +147,9 @@ class RlcFile: public EFile
   uint8_t  m_zeroes;
 
   uint8_t m_flags;
-#define WRITE_FIRST_LINK               0x01
-#define WRITE_NEXT_LINK_1              0x02
-#define WRITE_NEXT_LINK_2              0x03
+#define WRITE_NEXT_LINK                0x01
 #define WRITE_START_STEP               0x10
-#define WRITE_FREE_UNUSED_BLOCKS_STEP1 0x20
-#define WRITE_FREE_UNUSED_BLOCKS_STEP2 0x30
+#define WRITE_FREE_UNUSED_BLOCKS_STEP  0x20
 #define WRITE_FINAL_DIRENT_STEP        0x40
 #define WRITE_TMP_DIRENT_STEP          0x50
   uint8_t m_write_step;
@@ -162,6 +159,10 @@ class RlcFile: public EFile
   uint8_t m_write1_byte;
   uint8_t m_write_len;
   uint8_t * m_write_buf;
+  // Current block is built here, then written in one go
+  uint8_t m_blkBuf[BS];
+  uint8_t m_blkDirty;
+  blkid_t m_tailBlk;    // blocks to free when the file is closed
 
 //#if defined (EEPROM_PROGRESS_BAR)
 //  uint8_t m_ratio;
@@ -181,6 +182,7 @@ public:
   void write1(uint8_t b);
   void nextWriteStep();
   void nextRlcWriteStep();
+  void writeBlock();
   void writeRlc(uint8_t i_fileId, uint8_t typ, uint8_t *buf, uint16_t i_len, uint8_t sync_write);
 
   // flush the current write operation if any
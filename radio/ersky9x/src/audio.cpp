@@ -80,6 +80,28 @@ uint8_t VoiceFlushing ;
 /*static*/ uint8_t toneOrPause ;
 /*static*/ uint8_t toneActive ;
 /*static*/ uint8_t toneVarioVolume ;
+struct t_varioTone VarioTone ;
+static void varioFill( uint16_t *buffer, uint32_t count ) ;
+
+static uint32_t varioSounding()
+{
+	return VarioTone.frequency || VarioTone.level ;
+}
+
+// Tones are waiting, or the vario has to keep the tone output running
+// as there is no voice or music for it to be mixed into
+static uint32_t tonePending()
+{
+	if ( ToneQueueRidx != ToneQueueWidx )
+	{
+		return 1 ;
+	}
+	if ( varioSounding() && ( ( SystemOptions & SYS_OPT_MUTE ) == 0 ) && ( Voice.VoiceQueueCount == 0 ) )
+	{
+		return ( MusicPlaying == MUSIC_STOPPED ) || ( MusicPlaying == MUSIC_PAUSED ) ;
+	}
+	return 0 ;
+}
 
 
 //uint16_t Sine16k[32] =
@@ -618,23 +640,40 @@ void voice0to99Name( uint16_t index )
 	}
 }
 
-// Announce a value using voice
-void voice_numeric( int16_t value, uint8_t num_decimals, uint16_t units_index )
+// A number is announced as a short phrase of words, compiled once and
+// kept in a small cache, as the same values tend to be announced repeatedly
+#define VOICE_PHRASE_WORDS		8
+#define VOICE_PHRASE_CACHE		4
+
+// Phrase word types, a word with neither of these set is a number
+// for voice0to99Name()
+#define PHRASE_POINT		0x8000		// POINT_x
+#define PHRASE_SYSTEM		0xC000		// SysVoiceNames[] entry
+
+struct t_voicePhrase
+{
+	int16_t value ;
+	uint16_t units ;
+	uint8_t decimals ;
+	uint8_t count ;			// 0 if entry not used
+	uint16_t words[VOICE_PHRASE_WORDS] ;
+} ;
+
+struct t_voicePhrase VoicePhrases[VOICE_PHRASE_CACHE] ;
+uint8_t VoicePhraseNext ;
+
+static uint32_t voicePhraseCompile( int16_t value, uint8_t num_decimals, uint16_t units_index, uint16_t *words )
 {
 	uint8_t decimals = 0 ;
 	uint8_t actualDecimals = 0 ;
 	div_t qr ;
 	uint32_t flag = 0 ;
+	uint32_t count = 0 ;
 
-//	if ( units_index > 127 )
-//	{
-//		void putSystemVoice( uint16_t sname, uint16_t value )
-////		putSysNumVoiceQueue( units_index ) ;
-//	}
 	if ( value < 0 )
 	{
 		value = - value ;
-		putSystemVoice( SV_MINUS, 0 ) ;
+		words[count++] = PHRASE_SYSTEM | SV_MINUS ;
 	}
 
 	if ( num_decimals )
@@ -655,55 +694,40 @@ void voice_numeric( int16_t value, uint8_t num_decimals, uint16_t units_index )
 			qr = div( qr.quot, 10 ) ;
 			if ( qr.quot < 21 )
 			{
-//				putVoiceQueue( qr.quot + 110 ) ;
-//				putSysNumVoiceQueue( qr.quot + 110 ) ;
-				voice0to99Name( qr.quot * 1000 ) ;
+				words[count++] = qr.quot * 1000 ;
 			}
 			else
 			{
-//				putVoiceQueue( qr.quot + 400 ) ;
-//				putSysNumVoiceQueue( qr.quot + 400 ) ;
-				voice0to99Name( qr.quot ) ;
-				putSystemVoice( SV_THOUSAND, V_THOUSAND ) ;
-//				putVoiceQueue( V_THOUSAND | VLOC_NUMSYS ) ;
+				words[count++] = qr.quot ;
+				words[count++] = PHRASE_SYSTEM | SV_THOUSAND ;
 			}
 			qr.quot = qr.rem ;			
 		}
 		if ( qr.quot )		// There are hundreds
 		{
-//			putVoiceQueue( qr.quot + 100 ) ;
-//			putSysNumVoiceQueue( qr.quot + 100 ) ;
-			voice0to99Name( qr.quot * 100 ) ;
-//			putVoiceQueue( decimals + 400 ) ;
+			words[count++] = qr.quot * 100 ;
 			if ( decimals )
 			{
-//				putSysNumVoiceQueue( decimals + 400 ) ;
-				voice0to99Name( decimals ) ;
+				words[count++] = decimals ;
 			}
 			flag = 1 ;
 		}
 		else
 		{
-//			putVoiceQueue( decimals + 400 ) ;
-//			putSysNumVoiceQueue( decimals + 400 ) ;
 			if ( decimals )
 			{
-				voice0to99Name( decimals ) ;
+				words[count++] = decimals ;
 			}
 			flag = 1 ;
 		}
 		if ( ( flag == 0 ) && (qr.rem) )
 		{
-//			putVoiceQueue( qr.rem + 400 ) ;
-//			putSysNumVoiceQueue( qr.rem + 400 ) ;
-			voice0to99Name( qr.rem ) ;
+			words[count++] = qr.rem ;
 		}
 	}
 	else
 	{
-//		putVoiceQueue( qr.rem + 400 ) ;
-//		putSysNumVoiceQueue( qr.rem + 400 ) ;
-		voice0to99Name( qr.rem ) ;
+		words[count++] = qr.rem ;
 	}
 
 	if ( num_decimals )
@@ -711,23 +735,75 @@ void voice_numeric( int16_t value, uint8_t num_decimals, uint16_t units_index )
 		if ( num_decimals == 2 )
 		{
 			qr = div( actualDecimals, 10 ) ;
-			voicePointName( qr.quot ) ;
-//			putVoiceQueue( qr.quot + 6 ) ;		// Point x
-//			putVoiceQueue( qr.rem + 400 ) ;
-//			putSysNumVoiceQueue( qr.rem + 400 ) ;
-			voice0to99Name( qr.rem ) ;
+			words[count++] = PHRASE_POINT | qr.quot ;
+			words[count++] = qr.rem ;
 		}
 		else
 		{
-			voicePointName( actualDecimals ) ;
-//			putVoiceQueue( decimals + 6 ) ;		// Point x
+			words[count++] = PHRASE_POINT | actualDecimals ;
 		}
 	}
 		 
 	if ( units_index )
 	{
-		putSystemVoice( units_index, 0 ) ;
+		words[count++] = PHRASE_SYSTEM | units_index ;
 	}
+	return count ;
+}
+
+// Queue all of a phrase, or none of it if the queue is too full
+static void putVoicePhrase( uint16_t *words, uint32_t count )
+{
+	uint32_t i ;
+
+	if ( Voice.VoiceQueueCount + count > VOICE_Q_LENGTH )
+	{
+		return ;
+	}
+	for ( i = 0 ; i < count ; i += 1 )
+	{
+		uint16_t word = words[i] ;
+		if ( ( word & PHRASE_SYSTEM ) == PHRASE_SYSTEM )
+		{
+			word &= ~PHRASE_SYSTEM ;
+			putSystemVoice( word, ( word == SV_THOUSAND ) ? V_THOUSAND : 0 ) ;
+		}
+		else if ( word & PHRASE_POINT )
+		{
+			voicePointName( word & ~PHRASE_POINT ) ;
+		}
+		else
+		{
+			voice0to99Name( word ) ;
+		}
+	}
+}
+
+// Announce a value using voice
+void voice_numeric( int16_t value, uint8_t num_decimals, uint16_t units_index )
+{
+	struct t_voicePhrase *phrase ;
+	uint32_t i ;
+
+	for ( i = 0 ; i < VOICE_PHRASE_CACHE ; i += 1 )
+	{
+		phrase = &VoicePhrases[i] ;
+		if ( phrase->count && ( phrase->value == value ) && ( phrase->decimals == num_decimals ) && ( phrase->units == units_index ) )
+		{
+			putVoicePhrase( phrase->words, phrase->count ) ;
+			return ;
+		}
+	}
+	phrase = &VoicePhrases[VoicePhraseNext] ;
+	if ( ++VoicePhraseNext >= VOICE_PHRASE_CACHE )
+	{
+		VoicePhraseNext = 0 ;
+	}
+	phrase->value = value ;
+	phrase->decimals = num_decimals ;
+	phrase->units = units_index ;
+	phrase->count = voicePhraseCompile( value, num_decimals, units_index, phrase->words ) ;
+	putVoicePhrase( phrase->words, phrase->count ) ;
 }
 
 void putVoiceQueue( uint16_t value )
@@ -987,11 +1063,13 @@ uint32_t wavU16Convert( uint16_t *src, uint16_t *dest , uint32_t count, uint32_t
 	uint16_t *saveDest = dest ;
 	uint32_t returnValue = 1 ;
 	uint32_t padSize ;
+	uint32_t length ;
 	if ( count > VOICE_BUFFER_SIZE )
 	{
 		count = VOICE_BUFFER_SIZE ;
 	}
 	padSize = VOICE_BUFFER_SIZE - count ;
+	length = count ;
 #ifndef PCB9XT
 	if ( ( g_eeGeneral.softwareVolume ) || addTone )
 #endif
@@ -1043,6 +1121,10 @@ uint32_t wavU16Convert( uint16_t *src, uint16_t *dest , uint32_t count, uint32_t
 	{
 		returnValue = toneFill( saveDest, TONE_ADD ) ;
 	}
+	else
+	{
+		varioFill( saveDest, length ) ;		// Vario is mixed over voice and music
+	}
 	return returnValue ;
 }
 
@@ -1189,7 +1271,7 @@ void doTone()
 		{
 			x = 0 ;							
 		}
-		if ( toneOver )
+		if ( toneOver && !tonePending() )
 		{
 			// finish
 			waitVoiceAllSent( v_index ) ;
@@ -1650,7 +1732,7 @@ void voice_task(void* pdata)
 		 	// Play a tone
 			else
 			{
-				if (ToneQueueRidx != ToneQueueWidx)
+				if ( tonePending() )
 				{
 //#ifdef PCBX12D
 //	GPIOI->BSRRL = AUDIO_SD_GPIO_PIN ;	// Set high
@@ -1692,7 +1774,7 @@ extern uint32_t sdMounted( void ) ;
 				playListRead = 1 ;
 		 }
 	 
-		 while ( ( Voice.VoiceQueueCount == 0 ) && (ToneQueueRidx == ToneQueueWidx) )
+		 while ( ( Voice.VoiceQueueCount == 0 ) && !tonePending() )
 		 {
 				AudioActive = 0 ;
 //#ifdef PCB9XT
@@ -2052,7 +2134,7 @@ extern uint32_t sdMounted( void ) ;
 		 {
 		 	
 		 	// Play a tone
-			if (ToneQueueRidx != ToneQueueWidx)
+			if ( tonePending() )
 			{
 //#ifdef PCBX12D
 //	GPIOI->BSRRL = AUDIO_SD_GPIO_PIN ;	// Set high
@@ -2069,7 +2151,7 @@ extern uint32_t sdMounted( void ) ;
 		{
 			SDlastError = fr ;
 		 	// Play a tone
-			if (ToneQueueRidx != ToneQueueWidx)
+			if ( tonePending() )
 			{
 				AudioActive = 1 ;
 //#ifdef PCBX12D
@@ -2132,6 +2214,16 @@ void queueTone( uint8_t place, uint8_t freq, int8_t freqInc, uint8_t time, uint8
 }
 
 
+void varioTone( uint16_t frequency, uint16_t period, uint16_t onTime )
+{
+	if ( frequency && ( VarioTone.frequency == 0 ) )
+	{
+		VarioTone.cadence = 0 ;		// Start with a beep
+	}
+	VarioTone.period = period ;
+	VarioTone.onTime = onTime ;
+	VarioTone.frequency = frequency ;
+}
 
 void nextToneData()
 {
@@ -2198,6 +2290,113 @@ void nextToneData()
 	}
 }
 
+// Mix the vario over the count samples already in the buffer.
+// The phase carries on from buffer to buffer, the frequency glides to its
+// new value across the buffer and the cadence ramps on and off, so an
+// update never clicks.
+static void varioFill( uint16_t *buffer, uint32_t count )
+{
+	uint32_t i ;
+	uint32_t rate ;
+	uint32_t target ;
+	int32_t step ;
+	uint32_t onSamples ;
+	uint32_t periodSamples ;
+	uint32_t gate ;
+	int32_t multiplier ;
+	int32_t value ;
+	struct t_varioTone *vptr = &VarioTone ;
+
+	if ( count == 0 )
+	{
+		return ;
+	}
+	if ( !varioSounding() )
+	{
+		vptr->increment = 0 ;		// Next start is at the new pitch
+		return ;
+	}
+	rate = currentFrequency ? currentFrequency : 16000 ;
+	target = ( ( (uint32_t)vptr->frequency << 16 ) / rate ) << 8 ;
+	if ( vptr->increment == 0 )
+	{
+		vptr->increment = target ;
+	}
+	step = target ? ( (int32_t)target - (int32_t)vptr->increment ) / (int32_t)count : 0 ;
+	periodSamples = vptr->period * rate / 1000 ;
+	onSamples = vptr->onTime * rate / 1000 ;
+
+#ifndef PCB9XT
+	if ( g_eeGeneral.softwareVolume )
+	{
+#endif
+		multiplier = swVolumeLevel() ;
+		if ( multiplier )
+		{	// Mute if master volume is zero
+			if ( g_model.varioExtraData.volume )
+			{
+				multiplier = SwVolume_scale[g_model.varioExtraData.volume] ;
+			}
+		}
+#ifndef PCB9XT
+	}
+	else
+	{
+		multiplier = 256 ;
+	}
+#endif
+
+	for ( i = 0 ; i < count ; i += 1 )
+	{
+		gate = target ;
+		if ( periodSamples )
+		{
+			if ( vptr->cadence >= onSamples )
+			{
+				gate = 0 ;
+			}
+			if ( ++vptr->cadence >= periodSamples )
+			{
+				vptr->cadence = 0 ;
+			}
+		}
+		if ( gate )
+		{
+			if ( vptr->level < VARIO_LEVEL_MAX )
+			{
+				vptr->level += 1 ;
+			}
+		}
+		else if ( vptr->level )
+		{
+			vptr->level -= 1 ;
+		}
+		vptr->increment += step ;
+		vptr->phase += vptr->increment ;
+		if ( vptr->level )
+		{
+			value = Sine16kInt[( vptr->phase >> 19 ) & 0x1F] ;
+			value *= vptr->level * multiplier ;
+			value >>= 14 ;
+			value += *buffer ;
+			if ( value < 0 )
+			{
+				value = 0 ;
+			}
+			else if ( value > 4095 )
+			{
+				value = 4095 ;
+			}
+			*buffer = value ;
+		}
+		buffer += 1 ;
+	}
+	if ( target )
+	{
+		vptr->increment = target ;
+	}
+}
+
 // This for 16kHz sample rate
 // Returns +ve or zero, remaining time
 //   -ve offset into buffer of blank time
@@ -2207,6 +2406,7 @@ int32_t toneFill( uint16_t *buffer, uint32_t add )
 	uint32_t y ;
 	uint32_t multiplier ;
 	int32_t value ;
+	uint16_t *start = buffer ;
 	multiplier = swVolumeLevel() ;
 
 	if ( toneTimeLeft == 0 )
@@ -2332,6 +2532,7 @@ int32_t toneFill( uint16_t *buffer, uint32_t add )
 			i += 1 ;
 		}
 	}
+	varioFill( start, 512 ) ;
 	return toneTimeLeft == 0 ;
 }
 
@@ -248,9 +248,25 @@ struct toneQentry
 	uint8_t toneRepeat ;
 } ;						    
 
+// Continuous vario tone, set from the 100mS loop, synthesised in the
+// tone fill of every audio buffer
+struct t_varioTone
+{
+	uint16_t frequency ;	// Hz, 0 is off
+	uint16_t period ;			// mS, 0 is a continuous tone
+	uint16_t onTime ;			// mS of each period sounding
+	uint32_t phase ;			// index in the top 5 of 24 bits
+	uint32_t increment ;	// phase step << 8
+	uint32_t cadence ;		// samples into the period
+	uint8_t level ;				// envelope, 0 to VARIO_LEVEL_MAX
+} ;
+
+#define VARIO_LEVEL_MAX		64
+
 
 extern struct t_voice Voice ;
 extern struct toneQentry ToneQueue[] ;
+extern struct t_varioTone VarioTone ;
 
 extern void putVoiceQueue( uint16_t value ) ;
 extern void putNamedVoiceQueue( const char *name, uint16_t value ) ;
@@ -260,6 +276,7 @@ extern void flushVoiceQueue( void ) ;
 extern void voice_task(void* pdata) ;
 extern bool ToneFreeSlots( void ) ;
 extern void queueTone( uint8_t place, uint8_t freq, int8_t freqInc, uint8_t time, uint8_t pause, uint8_t repeat ) ;
+extern void varioTone( uint16_t frequency, uint16_t period, uint16_t onTime ) ;
 extern void voiceSystemNameNumberAudio( uint16_t name, uint16_t number, uint8_t audio ) ;
 extern void flushVoiceQueue( void ) ;
 
@@ -0,0 +1,297 @@
+/****************************************************************************
+*  Copyright (c) 2014 by Michael Blandford. All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*  1. Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*  3. Neither the name of the author nor the names of its contributors may
+*     be used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+*  THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+*  OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+*  AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+*  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+*  SUCH DAMAGE.
+*
+****************************************************************************
+*  History:
+*
+****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "ersky9x.h"
+#include "myeeprom.h"
+#include "ff.h"
+#include "base64.h"
+
+// Model XML files are read and written a sector at a time through
+// SharedMemory.ArchiveBuffer, base64 is encoded and decoded a block at a time
+
+extern union t_sharedMemory SharedMemory ;
+
+const uint8_t Base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" ;
+
+// Value of each character, or BASE64_xxx
+const uint8_t Base64Values[256] =
+{
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x42,0x42,0xFF,0xFF,0x42,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0x42,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x3E,0xFF,0xFF,0xFF,0x3F,
+	0x34,0x35,0x36,0x37,0x38,0x39,0x3A,0x3B,0x3C,0x3D,0xFF,0xFF,0xFF,0x40,0xFF,0xFF,
+	0xFF,0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0A,0x0B,0x0C,0x0D,0x0E,
+	0x0F,0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,0x18,0x19,0xFF,0xFF,0x41,0xFF,0xFF,
+	0xFF,0x1A,0x1B,0x1C,0x1D,0x1E,0x1F,0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27,0x28,
+	0x29,0x2A,0x2B,0x2C,0x2D,0x2E,0x2F,0x30,0x31,0x32,0x33,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+	0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
+} ;
+
+// Encode size bytes, the last group padded with '='
+// Returns the number of characters in dest
+uint32_t base64Encode( uint8_t *dest, uint8_t *src, uint32_t size )
+{
+	uint8_t *p = dest ;
+	uint32_t value ;
+
+	while ( size > 2 )
+	{
+		value = ( src[0] << 16 ) | ( src[1] << 8 ) | src[2] ;
+		p[0] = Base64Digits[value >> 18] ;
+		p[1] = Base64Digits[( value >> 12 ) & 0x3F] ;
+		p[2] = Base64Digits[( value >> 6 ) & 0x3F] ;
+		p[3] = Base64Digits[value & 0x3F] ;
+		p += 4 ;
+		src += 3 ;
+		size -= 3 ;
+	}
+	if ( size )
+	{
+		value = src[0] << 16 ;
+		if ( size > 1 )
+		{
+			value |= src[1] << 8 ;
+		}
+		p[0] = Base64Digits[value >> 18] ;
+		p[1] = Base64Digits[( value >> 12 ) & 0x3F] ;
+		p[2] = ( size > 1 ) ? Base64Digits[( value >> 6 ) & 0x3F] : '=' ;
+		p[3] = '=' ;
+		p += 4 ;
+	}
+	return p - dest ;
+}
+
+// Decode up to count characters from src into at most size bytes of dest
+// May be called again with following characters, returns the bytes output
+// and the characters used. Stops at '=', ']' or an invalid character.
+uint32_t base64Decode( struct t_base64Decoder *decoder, uint8_t *src, uint32_t count, uint8_t *dest, uint32_t size, uint32_t *used )
+{
+	uint8_t *p = dest ;
+	uint8_t *start = src ;
+	uint8_t *end = src + count ;
+	uint32_t bits = decoder->bits ;
+	uint32_t nbits = decoder->count ;
+	uint32_t value ;
+
+	while ( ( src < end ) && ( decoder->done == 0 ) )
+	{
+		// Whole groups of 4 characters
+		if ( ( nbits == 0 ) && ( end - src >= 4 ) && ( size - (uint32_t)( p - dest ) >= 3 ) )
+		{
+			uint32_t a = Base64Values[src[0]] ;
+			uint32_t b = Base64Values[src[1]] ;
+			uint32_t c = Base64Values[src[2]] ;
+			uint32_t d = Base64Values[src[3]] ;
+			if ( ( a | b | c | d ) < 0x40 )
+			{
+				value = ( a << 18 ) | ( b << 12 ) | ( c << 6 ) | d ;
+				p[0] = value >> 16 ;
+				p[1] = value >> 8 ;
+				p[2] = value ;
+				p += 3 ;
+				src += 4 ;
+				continue ;
+			}
+		}
+		value = Base64Values[*src] ;
+		if ( value == BASE64_SPACE )
+		{
+			src += 1 ;
+			continue ;
+		}
+		if ( value >= 0x40 )
+		{
+			decoder->done = 1 ;
+			break ;
+		}
+		if ( ( nbits >= 2 ) && ( (uint32_t)( p - dest ) >= size ) )
+		{
+			break ;		// Output full
+		}
+		src += 1 ;
+		bits = ( bits << 6 ) | value ;
+		nbits += 6 ;
+		if ( nbits >= 8 )
+		{
+			nbits -= 8 ;
+			*p++ = bits >> nbits ;
+			bits &= ( 1 << nbits ) - 1 ;
+		}
+	}
+	decoder->bits = bits ;
+	decoder->count = nbits ;
+	*used = src - start ;
+	return p - dest ;
+}
+
+static FRESULT xmlWrite( FIL *archiveFile, uint8_t *buffer, uint32_t *count, UINT *total )
+{
+	UINT written ;
+	FRESULT result = FR_OK ;
+
+	if ( *count )
+	{
+		result = f_write( archiveFile, buffer, *count, &written ) ;
+		*total += written ;
+		*count = 0 ;
+	}
+	return result ;
+}
+
+// write XML file
+FRESULT writeXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalWritten, uint8_t *name )
+{
+	uint8_t *buffer = SharedMemory.ArchiveBuffer ;
+	uint32_t count ;
+	uint32_t length ;
+  UINT total = 0 ;
+	FRESULT result = FR_OK ;
+	FRESULT answer ;
+
+	count = cpystr( buffer, (uint8_t *)"<!DOCTYPE ERSKY9X_EEPROM_FILE>\n<ERSKY9X_EEPROM_FILE>\n <MODEL_DATA number=\0420\042>\n  <Version>" ) - buffer ;
+	buffer[count++] = MDSKYVERS + '0' ;
+	count = cpystr( &buffer[count], (uint8_t *)"</Version>\n  <Name>" ) - buffer ;
+	memcpy( &buffer[count], name, sizeof(g_model.name) ) ;
+	count += sizeof(g_model.name) ;
+	count = cpystr( &buffer[count], (uint8_t *)"</Name>\n  <Data><![CDATA[" ) - buffer ;
+
+// Send base 64 here, filling the buffer each time
+	while ( size )
+	{
+		length = ( ( sizeof(SharedMemory.ArchiveBuffer) - count ) / 4 ) * 3 ;
+		if ( length > size )
+		{
+			length = size ;
+		}
+		count += base64Encode( &buffer[count], data, length ) ;
+		data += length ;
+		size -= length ;
+		if ( count > sizeof(SharedMemory.ArchiveBuffer) - 4 )
+		{
+			if ( ( answer = xmlWrite( archiveFile, buffer, &count, &total ) ) != FR_OK )
+			{
+				result = answer ;
+			}
+		}
+	}
+	if ( count > sizeof(SharedMemory.ArchiveBuffer) - 50 )
+	{
+		if ( ( answer = xmlWrite( archiveFile, buffer, &count, &total ) ) != FR_OK )
+		{
+			result = answer ;
+		}
+	}
+	count = cpystr( &buffer[count], (uint8_t *)"]]></Data>\n </MODEL_DATA>\n</ERSKY9X_EEPROM_FILE>\n" ) - buffer ;
+	if ( ( answer = xmlWrite( archiveFile, buffer, &count, &total ) ) != FR_OK )
+	{
+		result = answer ;
+	}
+	*totalWritten = total ;
+	return result ;
+}
+
+int32_t readXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalRead )
+{
+	struct t_base64Decoder decoder ;
+	uint8_t *buffer = SharedMemory.ArchiveBuffer ;
+  UINT nread ;
+  UINT total = 0 ;
+	uint32_t i ;
+	uint32_t length ;
+	uint32_t used ;
+	FRESULT result ;
+
+	result = f_read( archiveFile, buffer, 100, &nread ) ;
+	total += nread ;
+	if ( strncmp( (const char *)&buffer[10], "ERSKY9X_", 8 ) )
+	{
+		return -1 ;		// Invalid file
+	}
+	result = f_read( archiveFile, buffer, 100, &nread ) ;
+	total += nread ;
+	// Search for "CDATA[" starting at offset 30
+	for ( i = 30 ; i < 50 ; i += 1 )
+	{
+		if ( !strncmp( (const char *)&buffer[i], "CDATA[", 6 ) )
+		{
+			break ;
+		}
+	}
+	if ( i >= 50 )
+	{
+		return -1 ;		// Invalid file
+	}
+	i += 6 ;	// Index of base64 data
+
+	decoder.bits = 0 ;
+	decoder.count = 0 ;
+	decoder.done = 0 ;
+	while ( size && ( decoder.done == 0 ) )
+	{
+		if ( i >= nread )
+		{
+			result = f_read( archiveFile, buffer, sizeof(SharedMemory.ArchiveBuffer), &nread ) ;
+			total += nread ;
+			i = 0 ;
+			if ( ( result != FR_OK ) || ( nread == 0 ) )
+			{
+				break ;
+			}
+		}
+		length = base64Decode( &decoder, &buffer[i], nread - i, data, size, &used ) ;
+		data += length ;
+		size -= length ;
+		i += used ;
+		if ( ( length == 0 ) && ( used == 0 ) )
+		{
+			break ;
+		}
+	}
+	while ( size )
+	{
+		*data++ = 0 ;
+		size -= 1 ;
+	}
+	*totalRead = total ;
+	return result ; 
+}
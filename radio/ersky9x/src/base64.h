@@ -0,0 +1,56 @@
+/****************************************************************************
+*  Copyright (c) 2014 by Michael Blandford. All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*  1. Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*  3. Neither the name of the author nor the names of its contributors may
+*     be used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+*  THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+*  OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+*  AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+*  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+*  SUCH DAMAGE.
+*
+****************************************************************************
+*  History:
+*
+****************************************************************************/
+
+// Base64 for model XML files
+
+#define BASE64_PAD			0x40		// '='
+#define BASE64_END			0x41		// ']', end of CDATA
+#define BASE64_SPACE		0x42		// White space, ignored
+#define BASE64_BAD			0xFF
+
+struct t_base64Decoder
+{
+	uint32_t bits ;				// Decoded bits not yet output
+	uint8_t count ;				// Number of bits
+	uint8_t done ;				// Pad or end seen
+} ;
+
+extern const uint8_t Base64Digits[] ;
+extern const uint8_t Base64Values[] ;
+
+extern uint32_t base64Encode( uint8_t *dest, uint8_t *src, uint32_t size ) ;
+extern uint32_t base64Decode( struct t_base64Decoder *decoder, uint8_t *src, uint32_t count, uint8_t *dest, uint32_t size, uint32_t *used ) ;
+extern FRESULT writeXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalWritten, uint8_t *name ) ;
+extern int32_t readXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalRead ) ;
+
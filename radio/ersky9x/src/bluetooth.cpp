@@ -210,7 +210,10 @@ uint8_t Com1TxBuffer[32] ;
 
 #define SBUS_FRAME_LENGTH 28
 uint8_t BtSbusFrame[SBUS_FRAME_LENGTH] ;
+uint8_t BtFreshFrame[SBUS_FRAME_LENGTH] ;		// Latest good trainer frame received
+uint8_t BtFreshSize ;
 uint16_t BtLastSbusSendTime ;
+struct t_btLinkStats BtLinkStats ;
 
 uint16_t BtParaDebug ;
 
@@ -264,7 +267,6 @@ uint32_t txPdcBt( struct t_serial_tx *data )
 
 void btEncTx()
 {
-	int32_t y ;
 	uint32_t x ;
 	BtSerPkt.bytes[1] = ~BtSerPkt.bytes[0] ;
 	BtSerPkt.bytes[2] = 0 ;
@@ -274,17 +276,16 @@ void btEncTx()
 	txPdcCom2( &Com2_tx ) ;
 	// Read in any data received
 
-	x = 0 ;
-	while ( ( y = get_fifo128( &Com2_fifo ) ) != -1 )
+	x = read_fifo128( &Com2_fifo, BtSerRxPkt.bytes, 4 ) ;
+	if ( x == 4 )
 	{
-		if ( x < 4 )
-		{
-			BtSerRxPkt.bytes[x++] = y ;
-		}
-		else
+		uint8_t *data ;
+		uint32_t count ;
+		while ( ( count = fifo128Contiguous( &Com2_fifo, &data ) ) )
 		{
-			x += 1 ;
-      put_fifo128( &Bt_fifo, y ) ;
+			write_fifo128( &Bt_fifo, data, count ) ;
+			fifo128Consume( &Com2_fifo, count ) ;
+			x += count ;
       CoSetFlag( Bt_flag ) ;                  // Tell the Bt task something to do
 		}
 	}
@@ -314,14 +315,25 @@ void checkFunction()
 	}
 }
 
+// Wake the BT task, from task level only
+void btWake()
+{
+	if ( BtControl.BtReady )
+	{
+		CoSetFlag( Bt_flag ) ;
+	}
+}
+
 void scriptRequestBt()
 {
 	BtCurrentFunction = BT_SCRIPT ;
+	btWake() ;
 }
 
 void scriptReleasetBt()
 {
 	BtCurrentFunction = BtEepromFunction ;
+	btWake() ;
 }
 
 static void btPowerOn()
@@ -528,9 +540,31 @@ int32_t btSend( uint32_t length, uint8_t *data )
 		*end++ = *data++ ;
 	} while ( --length ) ;
 	Bt_tx.size = end - BtTxBuffer ;
+	btWake() ;
 	return 1 ;
 }
 
+// Sleep until interval (2MHz ticks) after the last trainer frame was sent
+static void btWaitSendTime( uint16_t interval )
+{
+	uint16_t x ;
+
+	for(;;)
+	{
+		x = getTmr2MHz() - BtLastSbusSendTime ;
+		if ( x >= interval )
+		{
+			if ( x >= interval + interval/2 )
+			{
+				BtLastSbusSendTime = getTmr2MHz() - interval ;	// Missed a frame, resync
+			}
+			break ;
+		}
+		CoTickDelay( ( interval - x + 3999 ) / 4000 ) ;		// 2mS ticks
+	}
+	BtLastSbusSendTime += interval ;
+}
+
 void bt_send_buffer()
 {
 	Bt_tx.buffer = BtTxBuffer ;
@@ -1267,36 +1301,19 @@ void getBtState()
 {
 	uint8_t buffer[20] ;
 	uint8_t saveData[30] ;
-	uint32_t i ;
 	uint32_t count ;
-	int32_t y ;
 	BtControl.BtStateRequest = 0 ;
 	uint8_t bitfieldtype = BtControl.BtModuleType ;
 	if ( bitfieldtype & (BT_BITTYPE_HC05) )
 	{
 		BT_ENABLE_HIGH ;						// Set bit B12 HIGH
 		CoTickDelay(10) ;					// 20mS
-		count = 0 ;
-		for ( i = 0 ; i < 30 ; i += 1 )		// Save unread data
-		{
-			if ( ( y = get_fifo128( &Bt_fifo ) ) != -1 )
-			{
-				saveData[i] = y ;
-				count += 1 ;
-			}
-			else
-			{
-				break ;	// i 
-			}
-		}
+		count = read_fifo128( &Bt_fifo, saveData, 30 ) ;		// Save unread data
 
 		btTransaction( (uint8_t *)"AT+STATE?\r\n", buffer, 19 ) ;
 		CoTickDelay(10) ;					// 20mS
 		btParse( BtState, buffer, 15 ) ;
-		for ( i = 0 ; i < count ; i += 1 )	// Restore unread data
-		{
-      put_fifo128( &Bt_fifo, saveData[i] ) ;
-		}
+		write_fifo128( &Bt_fifo, saveData, count ) ;	// Restore unread data
 		BT_ENABLE_LOW ;							// Set bit B12 LOW
 	}
 }
@@ -1510,6 +1527,7 @@ void processParaTrainerFrame( uint8_t *frame )
   	i += 3 ;
 	}
 	ppmInValid = 100 ;
+	trainerFrameStats( 0 ) ;
 }
 
 void putTrainerByte( uint8_t byte )
@@ -1544,6 +1562,110 @@ void putTrainerByte( uint8_t byte )
 }
 #endif
 
+void clearBtLinkStats()
+{
+	BtLinkStats.rtt = 0 ;
+	BtLinkStats.rttAverage = 0 ;
+	BtLinkStats.rttJitter = 0 ;
+	BtLinkStats.lost = 0 ;
+	BtLinkStats.awaiting = 0 ;
+}
+
+// The 2MHz timer extended to 32 bits. The 10mS tick gives how many times
+// the 16 bit timer may have wrapped since the last call.
+static uint32_t btLinkClock()
+{
+	static uint32_t clock ;
+	static uint16_t lastTimer ;
+	static uint16_t lastTick ;
+	uint16_t timer ;
+	uint16_t tick ;
+	uint32_t coarse ;
+	uint32_t fine ;
+
+	timer = getTmr2MHz() ;
+	tick = get_tmr10ms() ;
+	coarse = (uint32_t)(uint16_t)( tick - lastTick ) * 20000 ;
+	fine = (uint16_t)( timer - lastTimer ) ;
+	if ( coarse > fine + 20000 )
+	{
+		fine += ( coarse - 20000 - fine + 65535 ) & 0xFFFF0000 ;
+	}
+	clock += fine ;
+	lastTimer = timer ;
+	lastTick = tick ;
+	return clock ;
+}
+
+// Master sending a trainer frame, time it unless still waiting for a reply
+static void btLinkSend()
+{
+	uint32_t now = btLinkClock() ;
+	struct t_btLinkStats *p = &BtLinkStats ;
+
+	if ( p->awaiting )
+	{
+		if ( now - p->sendTime < BT_LINK_TIMEOUT )
+		{
+			return ;
+		}
+		p->lost += 1 ;
+	}
+	p->sendTime = now ;
+	p->awaiting = 1 ;
+}
+
+static void btLinkReply()
+{
+	uint32_t rtt ;
+	int32_t deviation ;
+	struct t_btLinkStats *p = &BtLinkStats ;
+
+	if ( p->awaiting == 0 )
+	{
+		return ;
+	}
+	rtt = btLinkClock() - p->sendTime ;
+	if ( rtt >= BT_LINK_TIMEOUT )
+	{
+		return ;		// Counted as lost when the next frame is sent
+	}
+	p->awaiting = 0 ;
+	p->rtt = rtt ;
+	if ( p->rttAverage == 0 )
+	{
+		p->rttAverage = rtt << 4 ;
+		return ;
+	}
+	deviation = rtt - ( p->rttAverage >> 4 ) ;
+	p->rttAverage += deviation ;
+	if ( deviation < 0 )
+	{
+		deviation = -deviation ;
+	}
+	p->rttJitter += deviation - ( p->rttJitter >> 4 ) ;
+}
+
+// Use the latest frame of a receive burst, older ones are stale.
+// Returns 1 if a frame was used.
+static uint32_t btFreshTrainerFrame()
+{
+	uint32_t size = BtFreshSize ;
+
+	if ( size == 0 )
+	{
+		return 0 ;
+	}
+	BtFreshSize = 0 ;
+	TrainerProfile *tProf = &g_eeGeneral.trainerProfile[g_model.trainerProfile] ;
+	if ( tProf->channel[0].source == TRAINER_BT )
+	{
+		return processSBUSframe( BtFreshFrame, g_ppmIns, size ) ;
+	}
+	trainerFrameStats( 0 ) ;		// Timing of the frames from the other end
+	return processSBUSframe( BtFreshFrame, 0, size ) ;
+}
+
 void processBtRx( int32_t data, uint32_t rxTimeout )
 {
 	uint16_t rxchar ;
@@ -1579,11 +1701,9 @@ void processBtRx( int32_t data, uint32_t rxTimeout )
 					BtControl.BtRxOccured = 1 ;
 					if ( BtControl.BtRxChecksum == 0 )
 					{
-						TrainerProfile *tProf = &g_eeGeneral.trainerProfile[g_model.trainerProfile] ;
-						if ( processSBUSframe( BtSbusFrame, ( tProf->channel[0].source == TRAINER_BT ) ? g_ppmIns : 0, BtControl.BtSbusIndex ) )
-						{
-							BtControl.BtSbusReceived = 1 ;
-						}
+						memcpy( BtFreshFrame, BtSbusFrame, BtControl.BtSbusIndex ) ;
+						BtFreshSize = BtControl.BtSbusIndex ;
+						btLinkReply() ;
 					}
 					else
 					{
@@ -2274,15 +2394,7 @@ void bt_task(void* pdata)
 				// Send data to COM2
 				if ( Bt_tx.ready == 0 )	// Buffer available
 				{
-					Bt_tx.size = 0 ;
-					while ( ( y = get_fifo128( &Bt_fifo ) ) != -1 )
-					{
-						BtTxBuffer[Bt_tx.size++] = y ;
-						if ( Bt_tx.size > 63 )
-						{
-							break ;
-						}	
-					}
+					Bt_tx.size = read_fifo128( &Bt_fifo, BtTxBuffer, 64 ) ;
 					if ( Bt_tx.size )
 					{
 						Bt_tx.buffer = BtTxBuffer ;
@@ -2330,7 +2442,7 @@ void bt_task(void* pdata)
 					bt_send_buffer() ;
 				}
 				BtRxTimer = 100 ;		// keep running
-				CoTickDelay(2) ;		// 4mS, request will only be avery 10mS
+				CoWaitForSingleFlag( Bt_flag, 50 ) ;		// btSend() wakes us, 100mS otherwise
 			}
 			else
 			{
@@ -2342,9 +2454,9 @@ void bt_task(void* pdata)
 				if ( x == E_OK )
 				{
 					// We have some data in the Fifo
-					while ( ( y = get_fifo128( &Bt_fifo ) ) != -1 )
+					while ( ( y = read_fifo128( &Bt_fifo, &BtTxBuffer[Bt_tx.size], 64 - Bt_tx.size ) ) )
 					{
-						BtTxBuffer[Bt_tx.size++] = y ;
+						Bt_tx.size += y ;
 						if ( Bt_tx.size > 63 )
 						{
 							bt_send_buffer() ;
@@ -2417,15 +2529,8 @@ void bt_task(void* pdata)
 					}
 					else
 					{
-						uint16_t x ;
-						do
-						{
-							CoTickDelay(1) ;					// 2mS
-							x = getTmr2MHz() - BtLastSbusSendTime ;
-						} while ( x < 28000 ) ;
-						BtLastSbusSendTime += 28000 ;
-	//					} while ( x < 40000 ) ;
-	//					BtLastSbusSendTime += 40000 ;
+						btWaitSendTime( 28000 ) ;
+						btLinkSend() ;
 					}
 					sendSbusFrame() ;
 				}
@@ -2448,13 +2553,7 @@ void bt_task(void* pdata)
 					{
 						if ( BtStatus == BT_STATUS_CONNECTED )
 						{
-							uint16_t x ;
-							do
-							{
-								CoTickDelay(1) ;					// 2mS
-								x = getTmr2MHz() - BtLastSbusSendTime ;
-							} while ( x < 36000 ) ;
-							BtLastSbusSendTime += 36000 ;
+							btWaitSendTime( 36000 ) ;
 							Bt_tx.size = 0 ;
 							BtTxBuffer[Bt_tx.size++] = BT_PARA_START_STOP ;
   						uint8_t crc = 0x00 ;
@@ -2536,17 +2635,16 @@ void bt_task(void* pdata)
 							BtRxTimer = 100 ;
 						}
 						processBtRx( x, 0 ) ;
-						if ( pBtControl->BtSbusReceived )
-						{
-							pBtControl->BtSbusReceived = 0 ;
-							if ( btBits & BT_IS_SLAVE )
-							{
-								btBits |= BT_SLAVE_SEND_SBUS ;						
-							}
-						}
 						lastTimer = getTmr2MHz() ;
 						btBits &= ~BT_RX_TIMEOUT ;
 					}
+					if ( btFreshTrainerFrame() )
+					{
+						if ( btBits & BT_IS_SLAVE )
+						{
+							btBits |= BT_SLAVE_SEND_SBUS ;						
+						}
+					}
 				}
 				else
 				{
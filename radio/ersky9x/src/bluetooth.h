@@ -119,6 +119,24 @@ struct t_bt_control
 
 extern struct t_bt_control BtControl ;
 
+// Trainer link timing, the master times a frame it sends to the reply.
+// No other frame is timed until the reply, or BT_LINK_TIMEOUT, so a slow
+// reply is not paired with a later frame.
+struct t_btLinkStats
+{
+	uint32_t sendTime ;			// btLinkClock() when the timed frame was sent
+	uint32_t rtt ;					// Last round trip, 0.5uS units
+	uint32_t rttAverage ;		// Mean round trip * 16
+	uint32_t rttJitter ;		// Mean deviation from the mean round trip * 16
+	uint16_t lost ;					// Timed frames with no reply
+	uint8_t awaiting ;
+} ;
+
+#define BT_LINK_TIMEOUT		200000		// 100mS in 2MHz counts
+
+extern struct t_btLinkStats BtLinkStats ;
+extern void clearBtLinkStats( void ) ;
+
 
 extern struct t_fifo128 Bt_fifo ;
 extern OS_FlagID Bt_flag ;
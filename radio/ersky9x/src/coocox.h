@@ -429,6 +429,10 @@ extern P_OSTCB  TCBRdy;       /*!< A pointer to TCB that is ready status      */
 extern P_OSTCB  TCBNext;      /*!< A pointer to TCB next be scheduled.        */	
 extern P_OSTCB  TCBRunning;   /*!< A pointer to TCB that is running.          */
 
+#if CFG_TASK_PROFILE_EN > 0
+extern void  TaskProfileSwitch(void);
+#endif
+
 extern U64      OSCheckTime;
 extern volatile U8   OSIntNesting; /*!< Use to indicate interrupt nesting level.*/   				
 extern volatile U8   OSSchedLock;  /*!< Schedule is lock(LOCK) or unlock(UN_LOCK).*/  	
@@ -1443,6 +1443,98 @@ void CoIdleTask(void* pdata)
 }
 
 
+#if CFG_TASK_PROFILE_EN > 0
+U32      TaskRunTime[CFG_MAX_USER_TASKS+SYS_TASK_NUM]; /*!< 2MHz counts run   */
+U16      TaskCpu[CFG_MAX_USER_TASKS+SYS_TASK_NUM];     /*!< Last period, 0.01%*/
+U16      TaskStkSize[CFG_MAX_USER_TASKS+SYS_TASK_NUM]; /*!< Stack size, words */
+static U16 TaskProfileTime;   /*!< Timer value when run time last charged     */
+#endif
+
+#if CFG_TASK_PROFILE_EN > 0
+/**
+ *******************************************************************************
+ * @brief      Charge run time to the running task	 
+ * @param[in]  None	 
+ * @param[out] None 
+ * @retval     None	 
+ *
+ * @par Description
+ * @details    Called on each context switch and each system tick. The time
+ *             since the last call, from the 2MHz timer also used by the IDLE
+ *             task, is added to the running task. Interrupt time is charged
+ *             to the task that was interrupted.
+ *******************************************************************************
+ */
+void TaskProfileSwitch(void)
+{
+	U32 primask ;
+	U16 now ;
+	__asm volatile ( " MRS %0, primask\n CPSID i\n" : "=r" (primask) : : "memory" ) ;
+#ifdef PCBSKY
+	now = TC1->TC_CHANNEL[0].TC_CV ;
+#endif
+#if defined(PCBX9D) || defined(PCB9XT) || defined(PCBX12D) || defined(PCBX10) || defined(PCBLEM1)
+	now = TIM7->CNT ;
+#endif
+	if ( TCBRunning != NULL )
+	{
+		TaskRunTime[TCBRunning->taskID] += (U16)( now - TaskProfileTime ) ;
+	}
+	TaskProfileTime = now ;
+	__asm volatile ( " MSR primask, %0\n" : : "r" (primask) : "memory" ) ;
+}
+
+
+/**
+ *******************************************************************************
+ * @brief      Close a profile period	 
+ * @param[in]  None	 
+ * @param[out] None 
+ * @retval     None	 
+ *
+ * @par Description
+ * @details    Converts the run time of each task since the last call into
+ *             0.01% units of the total, then starts a new period. Called once
+ *             a second.
+ *******************************************************************************
+ */
+void CoUpdateTaskProfile(void)
+{
+	U32 runTime[CFG_MAX_USER_TASKS+SYS_TASK_NUM] ;
+	U32 total = 0 ;
+	U32 i ;
+
+	TaskProfileSwitch() ;
+	OsSchedLock() ;
+	for ( i = 0 ; i < CFG_MAX_USER_TASKS+SYS_TASK_NUM ; i += 1 )
+	{
+		runTime[i] = TaskRunTime[i] ;
+		TaskRunTime[i] = 0 ;
+		total += runTime[i] ;
+	}
+	OsSchedUnlock() ;
+	if ( total )
+	{
+		for ( i = 0 ; i < CFG_MAX_USER_TASKS+SYS_TASK_NUM ; i += 1 )
+		{
+			TaskCpu[i] = (U64)runTime[i] * 10000 / total ;
+		}
+	}
+}
+
+
+U16 CoGetTaskCpu(OS_TID taskID)
+{
+	return ( taskID < CFG_MAX_USER_TASKS+SYS_TASK_NUM ) ? TaskCpu[taskID] : 0 ;
+}
+
+U16 CoGetStackSize(OS_TID taskID)
+{
+	return ( taskID < CFG_MAX_USER_TASKS+SYS_TASK_NUM ) ? TaskStkSize[taskID] : 0 ;
+}
+#endif
+
+
 /**
  *******************************************************************************
  * @brief      Hook for stack overflow	 
@@ -4453,6 +4545,9 @@ void Schedule(void)
     }   
 #endif
  	
+#if CFG_TASK_PROFILE_EN > 0
+    TaskProfileSwitch();                  /* Charge run time to current task  */
+#endif
     SwitchContext();                              /* Call task context switch */
 }
 
@@ -4553,6 +4648,11 @@ OS_TID CreateTask(FUNCPtr task,void *argv,U32 parameter,OS_STK *stk)
     {
         return E_CREATE_FAIL;           /* Yes,error return                   */
     }
+
+#if CFG_TASK_PROFILE_EN > 0
+    TaskStkSize[ptcb->taskID] = (parameter&0xfff00)>>8;
+    TaskRunTime[ptcb->taskID] = 0;
+#endif
     
     ptcb->stkPtr = stkTopPtr;           /* Initialize TCB as user set         */
     ptcb->prio   = prio;
@@ -5383,6 +5483,9 @@ void SysTick_Handler(void)
 {
     OSSchedLock++;                  /* Lock scheduler.                        */
     OSTickCnt++;                    /* Increment systerm time.                */
+#if CFG_TASK_PROFILE_EN > 0
+    TaskProfileSwitch();            /* Charge run time so the timer can't wrap*/
+#endif
 #if CFG_TASK_WAITTING_EN >0    
     if(DlyList != NULL)             /* Have task in delay list?               */
     {
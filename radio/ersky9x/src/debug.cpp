@@ -75,8 +75,10 @@
 #include "debug.h"
 #include "file.h"
 #include "ff.h"
+#include "base64.h"
 #include "audio.h"
 #include "timers.h"
+#include "pulses.h"
 
 #ifdef PCBX12D
 #include "logicio.h"
@@ -92,6 +94,7 @@ void crlf( void ) ;
 void p8hex( uint32_t value ) ;
 void p4hex( uint16_t value ) ;
 void p2hex( unsigned char c ) ;
+void pdecimal( uint32_t value ) ;
 void hex_digit_send( unsigned char c ) ;
 
 #ifdef PCB9XT
@@ -144,6 +147,20 @@ void p2hex( unsigned char c )
 	hex_digit_send( c ) ;
 }
 
+// Send the value to the RS232 port as decimal digits
+void pdecimal( uint32_t value )
+{
+	char digits[11] ;
+	uint32_t i = 10 ;
+	digits[10] = 0 ;
+	do
+	{
+		digits[--i] = '0' + value % 10 ;
+		value /= 10 ;
+	} while ( value ) ;
+	uputs( &digits[i] ) ;
+}
+
 // Send a single 4 bit value to the RS232 port as a hex digit
 void hex_digit_send( unsigned char c )
 {
@@ -328,6 +345,464 @@ void sendHbt( uint8_t *s )
 }
 #endif
 
+// Protocol encoder self test, 'T' on the debug port.
+// The frame builders are fed fixed channel vectors and module settings, the
+// CRC of each frame is checked against the reference value and the frame is
+// dumped so it may be compared with a capture. PXX, DSM and ACCESS frames are
+// compared byte for byte with reference frames. Build time is then measured
+// with the 2MHz timer. Nothing used by the live pulse output is touched.
+
+#define ENC_TEST_VECTORS		3
+#define ENC_TEST_FAILSAFES	4
+#define ENC_TEST_LOOPS			100
+
+static const int16_t EncTestChannels[ENC_TEST_VECTORS][16] =
+{
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ -1024, -888, -752, -616, -480, -344, -208, -72, 64, 200, 336, 472, 608, 744, 880, 1016 },
+	{ 1500, -1500, 1024, -1024, 1, -1, 512, -512, 1200, -1200, 0, 100, -100, 1023, -1023, 2 }
+} ;
+
+static const uint8_t EncTestFailsafeModes[ENC_TEST_FAILSAFES] =
+{
+	FAILSAFE_NOT_SET, FAILSAFE_CUSTOM, FAILSAFE_HOLD, FAILSAFE_NO_PULSES
+} ;
+
+static const uint16_t EncTestMultiCrc[ENC_TEST_VECTORS][ENC_TEST_FAILSAFES] =
+{
+	{ 0x319D, 0x856A, 0x77B3, 0x009B },
+	{ 0x51C3, 0x856A, 0x77B3, 0x009B },
+	{ 0xA19F, 0x856A, 0x77B3, 0x009B }
+} ;
+
+#ifdef XFIRE
+static const uint16_t EncTestXfireCrc[ENC_TEST_VECTORS] =
+{
+	0x03A9, 0xD750, 0x7B78
+} ;
+#endif
+
+static const uint8_t EncTestCheck[9] = { '1','2','3','4','5','6','7','8','9' } ;
+
+// The reference frames below were worked out by hand from the frame layouts,
+// not taken from the builders. A PXX or ACCESS channel is value*3/4 + 1024,
+// limited to 1-2046, 11 bits packed in pairs into 3 bytes, low byte first. PXX
+// channels 9-16 have 2048 added. A failsafe value is (value*3933 >> 9) + 1024,
+// limited to 1-2046. The PXX CRC is sent high byte first; its table is the
+// reflected 0x8408 polynomial, used msb first ("123456789" gives 0x604A).
+static const int16_t EncTestPxxChans[16] =
+{
+	0, -1500, 1500, -977, 1, -1, 700, -333,
+	100, 200, 300, 400, 1024, -1024, 1023, -1023
+} ;
+
+#define ENC_TEST_PXX			5
+
+// flag1, lpass, failsafe mode; a sub protocol of 3 (R9M) also sets the extra flags
+static const uint8_t EncTestPxxSetup[ENC_TEST_PXX][3] =
+{
+	{ 0x00, 0, FAILSAFE_NOT_SET },
+	{ 0x00, 1, FAILSAFE_NOT_SET },
+	{ PXX_SEND_FAILSAFE, 0, FAILSAFE_CUSTOM },
+	{ PXX_SEND_FAILSAFE, 0, FAILSAFE_HOLD },
+	{ 0xC0, 0, FAILSAFE_NOT_SET }
+} ;
+
+static const uint8_t EncTestPxxFrames[ENC_TEST_PXX][PXX_FRAME_BYTES+2] =
+{
+	{ 0x03, 0x00, 0x00, 0x00, 0x14, 0x00, 0xFE, 0x47, 0x12, 0x00, 0x04, 0x40, 0x0D, 0x76, 0x30, 0x00, 0xFC, 0x89 },
+	{ 0x03, 0x00, 0x00, 0x4B, 0x6C, 0xC9, 0xE1, 0xCC, 0xD2, 0x00, 0x0F, 0x90, 0xFF, 0x1E, 0x90, 0x00, 0x19, 0x26 },
+	{ 0x03, 0x10, 0x00, 0x66, 0x10, 0x0E, 0x5C, 0x61, 0x1D, 0x51, 0xC2, 0x2C, 0x47, 0x23, 0x3C, 0x00, 0x81, 0x3A },
+	{ 0x03, 0x10, 0x00, 0xFF, 0xF7, 0x7F, 0xFF, 0xF7, 0x7F, 0xFF, 0xF7, 0x7F, 0xFF, 0xF7, 0x7F, 0x00, 0xD5, 0x60 },
+	{ 0x03, 0xC0, 0x00, 0x00, 0x14, 0x00, 0xFE, 0x47, 0x12, 0x00, 0x04, 0x40, 0x0D, 0x76, 0x30, 0x56, 0x64, 0x00 }
+} ;
+
+// DSM2 words are the channel number in bits 13-10 and (value*13 >> 5) + 512,
+// limited to 0-1023, in bits 9-0, high byte first
+static const int16_t EncTestDsmChans[6] = { 0, 1024, -1024, -1, -512, 1500 } ;
+
+static const uint8_t EncTestDsmFrame[12] =
+{
+	0x02, 0x00, 0x07, 0xA0, 0x08, 0x60, 0x0D, 0xFF, 0x11, 0x30, 0x17, 0xFF
+} ;
+
+#ifdef ACCESS
+static const int8_t EncTestAccessFailsafe[8] = { -100, -50, 0, 50, 100, 127, -128, 1 } ;
+
+// Channels 1-8, then the failsafe values for 9-16 and 17-24
+static const uint8_t EncTestAccessFrames[3][12] =
+{
+	{ 0x00, 0x14, 0x00, 0xFE, 0x47, 0x12, 0x00, 0x04, 0x40, 0x0D, 0x76, 0x30 },
+	{ 0x3D, 0x84, 0x4B, 0x33, 0xE5, 0x5A, 0x29, 0x36, 0x6A, 0x1E, 0x97, 0x79 },
+	{ 0xFF, 0xF0, 0x27, 0x00, 0x04, 0x58, 0x00, 0xF7, 0x7C, 0x28, 0x70, 0x40 }
+} ;
+#endif
+
+uint16_t encTestCrc( uint8_t *p, uint32_t length )
+{
+	uint16_t crc = 0 ;
+	while ( length-- )
+	{
+	  crc = (crc<<8) ^ CRCTable( (crc>>8) ^ *p++ ) ;
+	}
+	return crc ;
+}
+
+static void encTestSetModule( struct t_module *pmodule, uint32_t failsafeMode )
+{
+	uint32_t i ;
+	memset( (uint8_t *)pmodule, 0, sizeof(*pmodule) ) ;
+	pmodule->protocol = PROTO_MULTI ;
+	pmodule->sub_protocol = M_DSM - 1 ;
+	pmodule->channels = 0x50 ;
+	pmodule->pxxRxNum = 3 ;
+	pmodule->failsafeMode = failsafeMode ;
+	for ( i = 0 ; i < 16 ; i += 1 )
+	{
+		pmodule->failsafe[i] = i * 16 - 120 ;
+	}
+}
+
+static void encTestResult( const char *name, uint16_t crc, uint16_t expected )
+{
+	uputs( (char *)name ) ;
+	txmit( ' ' ) ;
+	p4hex( crc ) ;
+	uputs( (char *)( ( crc == expected ) ? " OK" : " FAIL" ) ) ;
+	crlf() ;
+}
+
+static void encTestDump( uint8_t *p, uint32_t length )
+{
+	while ( length-- )
+	{
+		p2hex( *p++ ) ;
+	}
+	crlf() ;
+}
+
+static void encTestFrame( const char *name, uint8_t *frame, const uint8_t *expected, uint32_t length )
+{
+	uputs( (char *)name ) ;
+	uputs( (char *)( memcmp( frame, expected, length ) ? " FAIL" : " OK" ) ) ;
+	crlf() ;
+	encTestDump( frame, length ) ;
+}
+
+static void encTestTime( const char *name, uint16_t ticks )
+{
+	uputs( (char *)name ) ;
+	txmit( ' ' ) ;
+	pdecimal( (uint32_t)ticks * 500 / ENC_TEST_LOOPS ) ;	// 2MHz ticks
+	uputs( (char *)" nS/frame" ) ;
+	crlf() ;
+}
+
+void encoderSelfTest()
+{
+	uint32_t i ;
+	uint32_t j ;
+	uint16_t start ;
+	uint16_t crc ;
+	uint8_t frame[40] ;
+	struct t_module testModule ;
+	int16_t chans[NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+	uint16_t multiChans[NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+	uint16_t pxxChans[NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+
+	memset( (uint8_t *)chans, 0, sizeof(chans) ) ;
+	crlf() ;
+	encTestResult( "PXX check", encTestCrc( (uint8_t *)EncTestCheck, 9 ), 0x604A ) ;
+#ifdef XFIRE
+	encTestResult( "CRC8 check", crc8( EncTestCheck, 9 ), 0x00BC ) ;
+#endif
+
+	for ( i = 0 ; i < ENC_TEST_VECTORS ; i += 1 )
+	{
+		memcpy( (uint8_t *)chans, (uint8_t *)EncTestChannels[i], sizeof(EncTestChannels[i]) ) ;
+		for ( j = 0 ; j < NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ; j += 1 )
+		{
+			multiChans[j] = scaleForMulti( chans[j] ) ;
+		}
+		for ( j = 0 ; j < ENC_TEST_FAILSAFES ; j += 1 )
+		{
+			encTestSetModule( &testModule, EncTestFailsafeModes[j] ) ;
+			multiSerialFrame( frame, &testModule, multiChans, j != 0, 0 ) ;
+			encTestResult( "Multi", encTestCrc( frame, 26 ), EncTestMultiCrc[i][j] ) ;
+			encTestDump( frame, 26 ) ;
+		}
+#ifdef XFIRE
+		j = xfireChannelFrame( frame, chans ) ;
+		encTestResult( "Xfire", encTestCrc( frame, j ), EncTestXfireCrc[i] ) ;
+		encTestDump( frame, j ) ;
+#endif
+	}
+
+	memset( (uint8_t *)chans, 0, sizeof(chans) ) ;
+	memcpy( (uint8_t *)chans, (uint8_t *)EncTestPxxChans, sizeof(EncTestPxxChans) ) ;
+	for ( j = 0 ; j < NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ; j += 1 )
+	{
+		pxxChans[j] = limit( (int16_t)1, (int16_t)(chans[j] *3 / 4 + 1024), (int16_t)2046 ) ;
+	}
+	for ( i = 0 ; i < ENC_TEST_PXX ; i += 1 )
+	{
+		encTestSetModule( &testModule, EncTestPxxSetup[i][2] ) ;
+		testModule.protocol = PROTO_PXX ;
+		testModule.sub_protocol = EncTestPxxSetup[i][0] >> 6 ;
+		if ( testModule.sub_protocol == 3 )
+		{
+			testModule.r9mPower = 2 ;
+			testModule.r9MflexMode = 2 ;
+			testModule.highChannels = 1 ;
+			testModule.disableTelemetry = 1 ;
+		}
+		j = pxxFrameBytes( frame, &testModule, pxxChans, EncTestPxxSetup[i][0], EncTestPxxSetup[i][1] ) ;
+		crc = encTestCrc( frame, j ) ;
+		frame[j++] = crc >> 8 ;
+		frame[j++] = crc ;
+		encTestFrame( "PXX", frame, EncTestPxxFrames[i], j ) ;
+	}
+
+#ifdef ACCESS
+	encTestSetModule( &testModule, FAILSAFE_CUSTOM ) ;
+	testModule.protocol = PROTO_ACCESS ;
+	for ( i = 0 ; i < 3 ; i += 1 )
+	{
+		accessChannelBytes( frame, &testModule, (int8_t *)EncTestAccessFailsafe, pxxChans, i * 8, i != 0 ) ;
+		encTestFrame( "ACCESS", frame, EncTestAccessFrames[i], 12 ) ;
+	}
+#endif
+
+	memset( (uint8_t *)chans, 0, sizeof(chans) ) ;
+	memcpy( (uint8_t *)chans, (uint8_t *)EncTestDsmChans, sizeof(EncTestDsmChans) ) ;
+	dsmChannelBytes( frame, chans, 6 ) ;
+	encTestFrame( "DSM", frame, EncTestDsmFrame, 12 ) ;
+
+	encTestSetModule( &testModule, FAILSAFE_NOT_SET ) ;
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < ENC_TEST_LOOPS ; i += 1 )
+	{
+		multiSerialFrame( frame, &testModule, multiChans, 0, 0 ) ;
+	}
+	encTestTime( "Multi", getTmr2MHz() - start ) ;
+#ifdef XFIRE
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < ENC_TEST_LOOPS ; i += 1 )
+	{
+		xfireChannelFrame( frame, chans ) ;
+	}
+	encTestTime( "Xfire", getTmr2MHz() - start ) ;
+#endif
+	encTestSetModule( &testModule, FAILSAFE_NOT_SET ) ;
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < ENC_TEST_LOOPS ; i += 1 )
+	{
+		j = pxxFrameBytes( frame, &testModule, pxxChans, 0, 0 ) ;
+		encTestCrc( frame, j ) ;
+	}
+	encTestTime( "PXX", getTmr2MHz() - start ) ;
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < ENC_TEST_LOOPS ; i += 1 )
+	{
+		dsmChannelBytes( frame, chans, 6 ) ;
+	}
+	encTestTime( "DSM", getTmr2MHz() - start ) ;
+#ifdef ACCESS
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < ENC_TEST_LOOPS ; i += 1 )
+	{
+		accessChannelBytes( frame, &testModule, (int8_t *)EncTestAccessFailsafe, pxxChans, 0, 0 ) ;
+	}
+	encTestTime( "ACCESS", getTmr2MHz() - start ) ;
+#endif
+}
+
+// Base64 self test, 'B' on the debug port.
+// The RFC 4648 examples are checked first. Pseudo random data of every length
+// up to BASE64_TEST_MAX bytes, so each padding case many times over, is then
+// encoded and decoded again, in one call and a few characters per call as
+// readXMLfile() does across a sector boundary. Encode and decode speed is
+// then measured with the 2MHz timer.
+
+#define BASE64_TEST_MAX			96
+#define BASE64_TEST_LOOPS		20
+
+static const char *Base64TestText[7][2] =
+{
+	{ "", "" },
+	{ "f", "Zg==" },
+	{ "fo", "Zm8=" },
+	{ "foo", "Zm9v" },
+	{ "foob", "Zm9vYg==" },
+	{ "fooba", "Zm9vYmE=" },
+	{ "foobar", "Zm9vYmFy" }
+} ;
+
+static const uint8_t Base64TestChunks[4] = { 0, 1, 3, 5 } ;	// 0 is all at once
+
+static uint32_t base64TestDecode( uint8_t *dest, uint8_t *src, uint32_t count, uint32_t chunk )
+{
+	struct t_base64Decoder decoder ;
+	uint32_t length = 0 ;
+	uint32_t used ;
+	uint32_t n ;
+
+	decoder.bits = 0 ;
+	decoder.count = 0 ;
+	decoder.done = 0 ;
+	while ( count && ( decoder.done == 0 ) )
+	{
+		n = ( chunk && ( chunk < count ) ) ? chunk : count ;
+		length += base64Decode( &decoder, src, n, &dest[length], BASE64_TEST_MAX - length, &used ) ;
+		src += used ;
+		count -= used ;
+		if ( used == 0 )
+		{
+			break ;
+		}
+	}
+	return length ;
+}
+
+static void base64TestSpeed( const char *name, uint16_t ticks )
+{
+	uputs( (char *)name ) ;
+	txmit( ' ' ) ;
+	if ( ticks == 0 )
+	{
+		ticks = 1 ;
+	}
+	pdecimal( (uint32_t)BASE64_TEST_MAX * BASE64_TEST_LOOPS * 2000 / ticks ) ;	// 2MHz ticks
+	uputs( (char *)" kB/s" ) ;
+	crlf() ;
+}
+
+void base64SelfTest()
+{
+	uint32_t i ;
+	uint32_t j ;
+	uint32_t count ;
+	uint32_t length ;
+	uint32_t pads ;
+	uint32_t fails = 0 ;
+	uint32_t seed = 0x12345678 ;
+	uint16_t start ;
+	uint8_t data[BASE64_TEST_MAX] ;
+	uint8_t text[BASE64_TEST_MAX/3*4+1] ;
+	uint8_t result[BASE64_TEST_MAX] ;
+
+	crlf() ;
+	for ( i = 0 ; i < 7 ; i += 1 )
+	{
+		const char *plain = Base64TestText[i][0] ;
+		const char *coded = Base64TestText[i][1] ;
+		count = base64Encode( text, (uint8_t *)plain, strlen( plain ) ) ;
+		length = base64TestDecode( result, (uint8_t *)coded, strlen( coded ), 0 ) ;
+		if ( ( count != strlen( coded ) ) || memcmp( text, coded, count )
+				 || ( length != strlen( plain ) ) || memcmp( result, plain, length ) )
+		{
+			uputs( (char *)"RFC FAIL " ) ;
+			uputs( (char *)coded ) ;
+			crlf() ;
+			fails += 1 ;
+		}
+	}
+
+	for ( i = 0 ; i <= BASE64_TEST_MAX ; i += 1 )
+	{
+		for ( j = 0 ; j < i ; j += 1 )
+		{
+			seed = seed * 1103515245 + 12345 ;
+			data[j] = seed >> 24 ;
+		}
+		count = base64Encode( text, data, i ) ;
+		// 4 characters per 3 bytes, the last group padded with 1 or 2 '='
+		pads = 0 ;
+		for ( j = 0 ; j < count ; j += 1 )
+		{
+			if ( text[j] == '=' )
+			{
+				pads += 1 ;
+			}
+		}
+		if ( ( count != ( i + 2 ) / 3 * 4 ) || ( pads != ( 3 - i % 3 ) % 3 )
+				 || ( pads && ( text[count-1] != '=' ) ) )
+		{
+			uputs( (char *)"Encode FAIL " ) ;
+			pdecimal( i ) ;
+			crlf() ;
+			fails += 1 ;
+			continue ;
+		}
+		text[count] = ']' ;			// End of CDATA, as in the file
+		for ( j = 0 ; j < 4 ; j += 1 )
+		{
+			memset( result, 0, sizeof(result) ) ;
+			length = base64TestDecode( result, text, count + 1, Base64TestChunks[j] ) ;
+			if ( ( length != i ) || memcmp( result, data, i ) )
+			{
+				uputs( (char *)"Decode FAIL " ) ;
+				pdecimal( i ) ;
+				txmit( '/' ) ;
+				pdecimal( Base64TestChunks[j] ) ;
+				crlf() ;
+				fails += 1 ;
+			}
+		}
+	}
+	uputs( (char *)( fails ? "Base64 FAIL" : "Base64 OK" ) ) ;
+	crlf() ;
+
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < BASE64_TEST_LOOPS ; i += 1 )
+	{
+		count = base64Encode( text, data, BASE64_TEST_MAX ) ;
+	}
+	base64TestSpeed( "Encode", getTmr2MHz() - start ) ;
+	start = getTmr2MHz() ;
+	for ( i = 0 ; i < BASE64_TEST_LOOPS ; i += 1 )
+	{
+		base64TestDecode( result, text, count, 0 ) ;
+	}
+	base64TestSpeed( "Decode", getTmr2MHz() - start ) ;
+}
+
+#if CFG_TASK_PROFILE_EN > 0
+extern const char *taskName( OS_TID id ) ;
+extern int32_t taskStackFree( OS_TID id ) ;
+
+// One line per task: id, name, CPU% over the last second, stack free/size
+void taskProfileDump()
+{
+	uint32_t i ;
+	uint32_t cpu ;
+	for ( i = 0 ; i < CO_TASK_SLOTS ; i += 1 )
+	{
+		if ( CoGetStackSize( i ) == 0 )
+		{
+			continue ;
+		}
+		p2hex( i ) ;
+		txmit( ' ' ) ;
+		uputs( (char *)taskName( i ) ) ;
+		txmit( ' ' ) ;
+		cpu = CoGetTaskCpu( i ) ;
+		pdecimal( cpu / 100 ) ;
+		txmit( '.' ) ;
+		txmit( '0' + ( cpu / 10 ) % 10 ) ;
+		txmit( '0' + cpu % 10 ) ;
+		uputs( (char *)"% " ) ;
+		if ( taskStackFree( i ) >= 0 )
+		{
+			pdecimal( taskStackFree( i ) ) ;
+		}
+		txmit( '/' ) ;
+		pdecimal( CoGetStackSize( i ) ) ;
+		crlf() ;
+	}
+}
+#endif
+
 void handle_serial(void* pdata)
 {
 	uint16_t rxchar ;
@@ -1265,6 +1740,27 @@ extern uint8_t DebugUnderRun ;
 //			crlf() ;
 //		}
 
+		if ( rxchar == 'T' )
+		{
+			txmit( 'T' ) ;
+			encoderSelfTest() ;
+		}
+
+		if ( rxchar == 'B' )
+		{
+			txmit( 'B' ) ;
+			base64SelfTest() ;
+		}
+
+#if CFG_TASK_PROFILE_EN > 0
+		if ( rxchar == 'U' )
+		{
+			txmit( 'U' ) ;
+			crlf() ;
+			taskProfileDump() ;
+		}
+#endif
+
 		if ( rxchar == 'V' )
 		{
 #ifdef PCB9XT
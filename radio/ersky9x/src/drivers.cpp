@@ -37,6 +37,7 @@
 #include "logicio.h"
 #endif
 #include "pulses.h"
+#include "sbus.h"
 #include "lcd.h"
 #include "debug.h"
 #include "frsky.h"
@@ -827,6 +828,89 @@ int32_t peek_fifo128( struct t_fifo128 *pfifo )
 	return -1 ;
 }
 
+// Bulk access to a fifo128. The producer only moves in, and the consumer
+// only moves out, after the data is copied, as the byte functions do, so
+// these may be mixed with put_fifo128() from an interrupt.
+uint32_t fifo128Count( struct t_fifo128 *pfifo )
+{
+	return ( pfifo->in - pfifo->out ) & 0x7F ;
+}
+
+// Readable bytes that are contiguous from the out position, for a
+// consumer (or DMA) that can work directly on the buffer.
+uint32_t fifo128Contiguous( struct t_fifo128 *pfifo, uint8_t **pdata )
+{
+	uint32_t in = pfifo->in ;
+	uint32_t out = pfifo->out ;
+
+	*pdata = &pfifo->fifo[out] ;
+	if ( in >= out )
+	{
+		return in - out ;
+	}
+	return 128 - out ;
+}
+
+void fifo128Consume( struct t_fifo128 *pfifo, uint32_t count )
+{
+	pfifo->out = ( pfifo->out + count ) & 0x7F ;
+}
+
+uint32_t read_fifo128( struct t_fifo128 *pfifo, uint8_t *buffer, uint32_t size )
+{
+	uint32_t count ;
+	uint32_t out = pfifo->out ;
+	uint8_t *p ;
+	uint8_t *end ;
+
+	count = ( pfifo->in - out ) & 0x7F ;
+	if ( count > size )
+	{
+		count = size ;
+	}
+	size = count ;
+	p = &pfifo->fifo[out] ;
+	end = &pfifo->fifo[128] ;
+	while ( size-- )
+	{
+		*buffer++ = *p++ ;
+		if ( p == end )
+		{
+			p = pfifo->fifo ;
+		}
+	}
+	pfifo->out = ( out + count ) & 0x7F ;
+	return count ;
+}
+
+// Writes as much as fits, returns the number written
+uint32_t write_fifo128( struct t_fifo128 *pfifo, uint8_t *buffer, uint32_t size )
+{
+	uint32_t count ;
+	uint32_t in = pfifo->in ;
+	uint8_t *p ;
+	uint8_t *end ;
+
+	count = fifo128Space( pfifo ) ;
+	if ( count > size )
+	{
+		count = size ;
+	}
+	size = count ;
+	p = &pfifo->fifo[in] ;
+	end = &pfifo->fifo[128] ;
+	while ( size-- )
+	{
+		*p++ = *buffer++ ;
+		if ( p == end )
+		{
+			p = pfifo->fifo ;
+		}
+	}
+	pfifo->in = ( in + count ) & 0x7F ;
+	return count ;
+}
+
 #ifdef REVX
 void put_16bit_fifo32( struct t_16bit_fifo32 *pfifo, uint16_t word )
 {
@@ -2841,30 +2925,11 @@ extern uint8_t TrainerPolarity ;
   	val = (uint16_t)(capture - lastCapt) / 2 ;
   	lastCapt = capture;
 
-  	// We prcoess g_ppmInsright here to make servo movement as smooth as possible
-  	//    while under trainee control
-  	if (val>4000 && val < 19000) // G: Prioritize reset pulse. (Needed when less than 8 incoming pulses)
-  	  ppmInState = 1; // triggered
-  	else
-  	{
-  		if(ppmInState && ppmInState<=16)
-			{
-  	  	if(val>800 && val<2200)
-				{
-					TrainerProfile *tProf = &g_eeGeneral.trainerProfile[g_model.trainerProfile] ;
-					if ( tProf->channel[0].source == TRAINER_JACK )
-					{
-						ppmInValid = 100 ;
-  		  	  g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500) ;
-						//+-500 != 512, but close enough.
-					}
-		    }
-				else
-				{
-  		    ppmInState=0; // not triggered
-  	  	}
-  	  }
-  	}
+		TrainerProfile *tProf = &g_eeGeneral.trainerProfile[g_model.trainerProfile] ;
+		if ( tProf->channel[0].source == TRAINER_JACK )
+		{
+			processPpmInPulse( val ) ;
+		}
 	}
 }
 
@@ -147,6 +147,11 @@ extern void put_fifo128( struct t_fifo128 *pfifo, uint8_t byte ) ;
 extern int32_t get_fifo128( struct t_fifo128 *pfifo ) ;
 extern uint32_t fifo128Space( struct t_fifo128 *pfifo ) ;
 extern int32_t peek_fifo128( struct t_fifo128 *pfifo ) ;
+extern uint32_t fifo128Count( struct t_fifo128 *pfifo ) ;
+extern uint32_t fifo128Contiguous( struct t_fifo128 *pfifo, uint8_t **pdata ) ;
+extern void fifo128Consume( struct t_fifo128 *pfifo, uint32_t count ) ;
+extern uint32_t read_fifo128( struct t_fifo128 *pfifo, uint8_t *buffer, uint32_t size ) ;
+extern uint32_t write_fifo128( struct t_fifo128 *pfifo, uint8_t *buffer, uint32_t size ) ;
 extern struct t_serial_tx Bt_tx ;
 extern uint32_t txPdcBt( struct t_serial_tx *data ) ;
 extern uint32_t txPdcCom2( struct t_serial_tx *data ) ;
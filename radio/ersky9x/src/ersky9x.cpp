@@ -199,6 +199,9 @@ uint32_t ee32_check_finished()
 #endif
 //#define STARTUP_DEBUG 1
 //#define STACK_PROBES	1
+#if !defined(SIMU) && CFG_TASK_PROFILE_EN > 0
+#define STACK_PROBES	1		// Task profile shows stack free
+#endif
 
 #if defined(PCBX12D) || defined(PCBX10)
 //#define	WHERE_TRACK		1
@@ -2110,10 +2113,7 @@ uint32_t stackSpace( uint32_t stack )
 				}
 			}
 		return i ;
-#ifndef PCBX12D
- #ifndef PCBX9LITE
-  #ifndef PCBX9D
-   #ifndef PCBX10
+#ifdef BLUETOOTH
 		case 3 :
 			for ( i = 0 ; i < BT_STACK_SIZE ; i += 1 )
 			{
@@ -2123,15 +2123,116 @@ uint32_t stackSpace( uint32_t stack )
 				}
 			}
 		return i ;
-   #endif
-  #endif
- #endif
+#endif
+#ifdef	DEBUG
+		case 4 :
+			for ( i = 0 ; i < DEBUG_STACK_SIZE ; i += 1 )
+			{
+				if ( debug_stk[i] != 0x55555555 )
+				{
+					break ;
+				}
+			}
+		return i ;
+#endif
+#ifdef SERIAL_HOST
+		case 5 :
+			for ( i = 0 ; i < HOST_STACK_SIZE ; i += 1 )
+			{
+				if ( Host_stk[i] != 0x55555555 )
+				{
+					break ;
+				}
+			}
+		return i ;
 #endif
 	}
 	return 0 ;
 }
 #endif
 
+#if !defined(SIMU) && CFG_TASK_PROFILE_EN > 0
+// Name of a task for the task profile display, id as returned by CoCreateTask
+const char *taskName( OS_TID id )
+{
+	if ( id == 0 )
+	{
+		return "Idle" ;
+	}
+	if ( id == MainTask )
+	{
+		return "Main" ;
+	}
+	if ( id == VoiceTask )
+	{
+		return "Voice" ;
+	}
+	if ( id == LogTask )
+	{
+		return "Log" ;
+	}
+#ifdef BLUETOOTH
+	if ( id == BtTask )
+	{
+		return "Bt" ;
+	}
+#endif
+#ifdef	DEBUG
+	if ( id == DebugTask )
+	{
+		return "Debug" ;
+	}
+#endif
+#ifdef SERIAL_HOST
+	if ( id == HostTask )
+	{
+		return "Host" ;
+	}
+#endif
+	return "" ;
+}
+
+// Stack words never used by a task, -1 if its stack is not probed
+int32_t taskStackFree( OS_TID id )
+{
+	if ( id == 0 )
+	{
+		return -1 ;		// Idle
+	}
+	if ( id == MainTask )
+	{
+		return stackSpace( 0 ) ;
+	}
+	if ( id == LogTask )
+	{
+		return stackSpace( 1 ) ;
+	}
+	if ( id == VoiceTask )
+	{
+		return stackSpace( 2 ) ;
+	}
+#ifdef BLUETOOTH
+	if ( id == BtTask )
+	{
+		return stackSpace( 3 ) ;
+	}
+#endif
+#ifdef	DEBUG
+	if ( id == DebugTask )
+	{
+		return stackSpace( 4 ) ;
+	}
+#endif
+#ifdef SERIAL_HOST
+	if ( id == HostTask )
+	{
+		return stackSpace( 5 ) ;
+	}
+#endif
+	return -1 ;
+}
+#endif
+
 
 //#if defined(PCBX12D) || defined(PCBX10)
 //void where( uint8_t chr )
@@ -3694,6 +3795,18 @@ extern void sdInit( void ) ;
 	{
 		main_stk[i] = 0x55555555 ;
 	}
+#ifdef	DEBUG
+	for ( i = 0 ; i < DEBUG_STACK_SIZE ; i += 1 )
+	{
+		debug_stk[i] = 0x55555555 ;
+	}
+#endif
+#ifdef SERIAL_HOST
+	for ( i = 0 ; i < HOST_STACK_SIZE ; i += 1 )
+	{
+		Host_stk[i] = 0x55555555 ;
+	}
+#endif
 #endif
 
 #ifdef BLUETOOTH
@@ -5972,6 +6085,109 @@ inline bool qSixPosCalibrating()
 }
 #endif
 
+// Vario climb rate, run every 100mS. An alpha-beta filter tracks the
+// barometric altitude (decimetres), a vario sensor reading pulls the rate
+// estimate towards it, so either or both may be fitted. Sources that are
+// not in cm/S are just smoothed.
+struct t_varioFilter
+{
+	int32_t altitude ;		// cm << 4
+	int32_t rate ;				// cm/S << 4
+	uint8_t state ;				// 1 rate set, 2 altitude set
+} VarioFilter ;
+
+static int16_t varioClimb( int16_t vspd, uint32_t useAltitude )
+{
+	struct t_varioFilter *fptr = &VarioFilter ;
+	int32_t error ;
+
+	if ( ( fptr->state & 1 ) == 0 )
+	{
+		fptr->rate = (int32_t)vspd << 4 ;
+		fptr->state = 1 ;
+	}
+	if ( useAltitude )
+	{
+		fptr->altitude += fptr->rate / 10 ;
+		if ( TelemetryDataValid[FR_ALT_BARO] )
+		{
+			error = (int32_t)(int16_t)FrskyHubData[FR_ALT_BARO] * 160 - fptr->altitude ;
+			if ( ( ( fptr->state & 2 ) == 0 ) || ( error > 50*160 ) || ( error < -50*160 ) )
+			{ // First reading, or altitude zeroed
+				fptr->altitude += error ;
+				fptr->state |= 2 ;
+				error = 0 ;
+			}
+			fptr->altitude += error / 4 ;
+			fptr->rate += error * 5 / 32 ;
+		}
+		if ( TelemetryDataValid[FR_VSPD] )
+		{
+			fptr->rate += ( ( (int32_t)vspd << 4 ) - fptr->rate ) / 4 ;
+		}
+	}
+	else
+	{
+		fptr->rate += ( ( (int32_t)vspd << 4 ) - fptr->rate ) / 2 ;
+	}
+	error = fptr->rate >> 4 ;
+	if ( error > 32000 )
+	{
+		error = 32000 ;
+	}
+	else if ( error < -32000 )
+	{
+		error = -32000 ;
+	}
+	return error ;
+}
+
+// Climb beeps faster and higher as the rate rises, sink is a continuous
+// lower tone, the pitch follows the rate rather than stepping
+static void varioSound( int16_t vspd )
+{
+	int32_t frequency ;
+	uint32_t period ;
+
+	frequency = BEEP_DEFAULT_FREQ + g_model.varioExtraData.baseFrequency ;
+	if ( vspd > 25 )			// OpenXsensor
+	{
+		frequency += g_model.varioExtraData.offsetFrequency + 1 ;
+		frequency = frequency * 125 / 4 + vspd * 5 / 4 ;
+		period = vspd > 200 ? 200 : 1000 - vspd * 4 ;
+		if ( period > 800 )
+		{
+			period = 800 ;
+		}
+		varioTone( limit( 300, (int)frequency, 8000 ), period, period / 2 ) ;
+	}
+	else if ( vspd < -25 )
+	{
+		if ( g_model.varioData.sinkTones )
+		{
+			varioTone( 0, 0, 0 ) ;
+		}
+		else
+		{
+			frequency -= g_model.varioExtraData.offsetFrequency + 1 ;
+			frequency = frequency * 125 / 4 + vspd * 5 / 4 ;
+			varioTone( limit( 300, (int)frequency, 8000 ), 0, 0 ) ;
+		}
+	}
+	else
+	{
+		if ( g_model.varioData.sinkTones )
+		{ // Level tick
+			frequency += g_model.varioExtraData.offsetFrequency + 1 ;
+			varioTone( frequency * 125 / 4, 2000, 100 ) ;
+		}
+		else
+		{
+			varioTone( 0, 0, 0 ) ;
+		}
+	}
+}
+
 uint32_t MixerRate ;
 uint32_t MixerCount ;
 
@@ -5983,8 +6199,6 @@ uint8_t EncoderI2cData[2] ;
 
 void mainSequence( uint32_t no_menu )
 {
-	CalcScaleNest = 0 ;
-
 #ifdef PCBSKY
 	static uint32_t coProTimer = 0 ;
 #endif
@@ -6239,6 +6453,9 @@ static uint32_t saveIdleCount ;
 				x = 9999 ;
 			}
 			IdlePercent = x ;
+#if !defined(SIMU) && CFG_TASK_PROFILE_EN > 0
+			CoUpdateTaskProfile() ;
+#endif
 
 			
 extern uint32_t TotalExecTime ;
@@ -6645,13 +6862,6 @@ extern uint8_t SpiEncoderValid ;
 			    }
 				}
 			}
-			for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
-			{
-				if ( g_model.eScalers[i].dest )
-				{
-					calc_scaler( i, 0, 0 ) ;					
-				}
-			}
 		}
 		 
 		for ( i = numSafety ; i < NUM_SKYCHNOUT+NUM_VOICE ; i += 1 )
@@ -6798,27 +7008,24 @@ extern uint8_t SpiEncoderValid ;
 
 		// Vario
 		{
-
-			static uint8_t varioRepeatRate = 0 ;
-			static uint8_t sounded = 0 ;
+			int16_t vspd = 0 ;
+			uint32_t sounding = 0 ;
 
 			if ( g_model.varioData.varioSource ) // Vario enabled
 			{
 				if ( getSwitch00( g_model.varioData.swtch ) )
 				{
-					uint8_t new_rate = 0 ;
-					if ( varioRepeatRate )
-					{
-						varioRepeatRate -= 1 ;
-					}
-					if ( varioRepeatRate == 0 )
-					{
-						sounded = 0 ;
-					}
-					int16_t vspd ;
+					sounding = 1 ;
 					if ( g_model.varioData.varioSource == 1 )
 					{
-						vspd = FrskyHubData[FR_VSPD] ;
+						if ( TelemetryDataValid[FR_VSPD] || TelemetryDataValid[FR_ALT_BARO] )
+						{
+							vspd = varioClimb( TelemetryDataValid[FR_VSPD] ? FrskyHubData[FR_VSPD] : 0, 1 ) ;
+						}
+						else
+						{
+							sounding = 0 ;
+						}
 
 						if ( g_model.varioData.param > 1 )
 						{
@@ -6833,6 +7040,7 @@ extern uint8_t SpiEncoderValid ;
 							vspd = 0 ;							
 						}
 						vspd *= g_model.varioData.param ;
+						vspd = varioClimb( vspd, 0 ) ;
 					}
 					else
 					{
@@ -6842,85 +7050,19 @@ extern uint8_t SpiEncoderValid ;
 						{
 							vspd /= g_model.varioData.param ;
 						}
-					}
-					if ( vspd )
-					{
-						if ( vspd < 0 )
-						{
-							vspd = -vspd ;
-							if (!g_model.varioData.sinkTones )
-							{
-								if ( vspd > 25 )		// OpenXsensor
-								{
-									if ( sounded != 2 )
-									{
-										sounded = 2 ;
-										varioRepeatRate = 0 ;
-  	  	     		    audio.event( AU_VARIO_DOWN, vspd/25 ) ;
-									}
-								}
-							}
-						}
-						else
-						{
-							if ( vspd > 25 )			// OpenXsensor
-							{
-								if ( sounded != 1 )
-								{
-									sounded = 1 ;
-									varioRepeatRate = 0 ;
-		  	        	audio.event( AU_VARIO_UP, vspd/25 ) ;
-								}
-							}
-						}
-						if ( vspd < 75 )
-						{
-							new_rate = 8 ;
-						}
-						else if ( vspd < 100 )
-						{
-							new_rate = 7 ;
-						}
-						else if ( vspd < 125 )
-						{
-							new_rate = 6 ;
-						}
-						else if ( vspd < 150 )
-						{
-							new_rate = 5 ;
-						}
-						else if ( vspd < 175 )
-						{
-							new_rate = 4 ;
-						}
-						else if ( vspd < 200 )
-						{
-							new_rate = 3 ;
-						}
-						else
-						{
-							new_rate = 2 ;
-						}
-					}
-					else
-					{
-						if (g_model.varioData.sinkTones )
-						{
-							if ( sounded == 0 )
-							{
-								new_rate = 20 ;
-								sounded = 3 ;
-								varioRepeatRate = 0 ;
-  	    	  		audio.event( AU_VARIO_UP, 0 ) ;
-							}
-						}
-					}
-					if ( varioRepeatRate == 0 )
-					{
-						varioRepeatRate = new_rate ;
+						vspd = varioClimb( vspd, 0 ) ;
 					}
 				}
 			}
+			if ( sounding )
+			{
+				varioSound( vspd ) ;
+			}
+			else
+			{
+				VarioFilter.state = 0 ;
+				varioTone( 0, 0, 0 ) ;
+			}
 		}	
 	}
 
@@ -10409,7 +10551,67 @@ const char *get_switches_string()
   return PSTR(SWITCHES_STR)+1	;
 }	
 
+#ifndef SMALL
+// All source values, taken once per mixer frame, so switches, alarms and
+// scripts don't go through getLiveValue() for every reference.
+int16_t SourceValues[NUM_SNAPSHOT_SOURCES] ;
+uint8_t SourceValuesValid ;
+
+void snapshotValues()
+{
+	int16_t *p = SourceValues ;
+	uint32_t i ;
+
+	for ( i = 0 ; i < 7 ; i += 1 )
+	{
+		*p++ = calibratedStick[i] ;
+	}
+	for ( ; i < PPM_BASE ; i += 1 )
+	{
+		*p++ = 0 ;
+	}
+	for ( i = 0 ; i < NUM_PPM ; i += 1 )
+	{
+		int16_t x ;
+		x = g_ppmIns[i] ;
+		if ( i < 4 )
+		{
+			x -= g_eeGeneral.trainerProfile[g_model.trainerProfile].channel[i].calib ;
+		}
+		*p++ = x * 2 ;
+	}
+	for ( i = 0 ; i < NUM_SKYCHNOUT ; i += 1 )
+	{
+		*p++ = ex_chans[i] ;
+	}
+	for ( i = 0 ; i < EXTRA_POTS_START-1-NUM_SKYXCHNRAW ; i += 1 )
+	{
+		*p++ = get_telemetry_value( i ) ;
+	}
+	for ( i = 7 ; i < 7+8 ; i += 1 )
+	{
+		*p++ = ( i < NUMBER_ANALOG+NUM_POSSIBLE_EXTRA_POTS ) ? calibratedStick[i] : 0 ;
+	}
+	for ( i = EXTRA_POTS_START-1+8-NUM_SKYXCHNRAW ; i < NUM_SNAPSHOT_SOURCES-NUM_SKYXCHNRAW ; i += 1 )
+	{
+		*p++ = get_telemetry_value( i ) ;
+	}
+	SourceValuesValid = 1 ;
+}
+#endif
+
 int16_t getValue(uint8_t i)
+{
+#ifndef SMALL
+	if ( SourceValuesValid && ( i < NUM_SNAPSHOT_SOURCES ) )
+	{
+		return SourceValues[i] ;
+	}
+#endif
+	return getLiveValue( i ) ;
+}
+
+int16_t getLiveValue(uint8_t i)
 {
   if(i<7) return calibratedStick[i];//-512..512
 	if ( i >= EXTRA_POTS_START-1 )
@@ -1042,8 +1042,11 @@ extern const int8_t TelemIndex[] ;
 extern const uint8_t TelemValid[] ;
 extern int16_t convertTelemConstant( int8_t channel, int8_t value) ;
 extern int16_t getValue(uint8_t i) ;
+extern int16_t getLiveValue(uint8_t i) ;
 #define NUM_TELEM_ITEMS 81
 #define TELEM_GAP_START	75
+#define NUM_SNAPSHOT_SOURCES	(NUM_SKYXCHNRAW+NUM_TELEM_ITEMS+8)
+extern void snapshotValues( void ) ;
 
 #define NUM_XCHNRAW (CHOUT_BASE+NUM_CHNOUT) // NUMCH + P1P2P3+ AIL/RUD/ELE/THR + MAX/FULL + CYC1/CYC2/CYC3
 #define NUM_SKYXCHNRAW (CHOUT_BASE+NUM_SKYCHNOUT) // NUMCH + P1P2P3+ AIL/RUD/ELE/THR + MAX/FULL + CYC1/CYC2/CYC3
@@ -1724,7 +1727,11 @@ union t_sharedMemory
 		struct t_filelist FileList ;
 		struct t_maintenance Mdata ;
 	} ;
-	FIL g_eebackupFile ;
+	struct
+	{
+		FIL g_eebackupFile ;
+		uint8_t ArchiveBuffer[512] ;
+	} ;
 	struct t_spectrumAnalyser SpectrumAnalyser ;
 } ;
 
@@ -31,6 +31,7 @@
 #include "drivers.h"
 #include "file.h"
 #include "ff.h"
+#include "base64.h"
 #include "frsky.h"
 #ifndef SIMU
 #include "CoOS.h"
@@ -66,6 +67,32 @@ extern PROGMEM s9xsplash[] ;
 
 // 'main' needs to load a model
 
+// Journaled model saves
+// A model block is erased and written with the header and data, leaving the
+// rest of the 4K block erased. When the current model is saved, and the only
+// changes are small (trims, GVARs, timers etc.), the changed bytes are
+// appended as records to this erased area instead of writing the whole model
+// to the other block. When the records don't fit, a full write is done.
+// Each record is a t_journal_header followed by the data. The header holds a
+// check over itself and the data. The last record of each save has
+// JOURNAL_COMMIT set, and a save is only applied once all its records, up to
+// the commit, are valid. A save torn by power loss is ignored as a whole, the
+// data is loaded as it was before that save, and no more records are added
+// to that block.
+
+// Directory
+// Blocks DIR_BLOCK and DIR_BLOCK+1 hold a directory of the files, so at
+// power on this is read instead of both headers and the name of every file.
+// A directory block has a header, a snapshot of an entry for every file, then
+// update records appended as files are written. A full file write appends a
+// DIR_PENDING record before the file block is erased, and a DIR_ENTRY record
+// with the new block, size, sequence and name when it has completed. A file
+// with a DIR_PENDING record and no later entry, or a record failing its
+// check, means power was lost part way, that file is scanned as before.
+// When the directory block is full, a new snapshot is written to the other
+// block. If neither block is valid, all the files are scanned and a
+// snapshot is written when the EEPROM is next idle.
+
 // These may not be needed, or might just be smaller
 uint8_t Spi_tx_buf[8] ;
 
@@ -113,6 +140,11 @@ uint32_t Eeprom32_data_size ;
 #define E32_READWAITING				7
 #define E32_BLANKCHECK				8
 #define E32_WRITESTART				9
+#define E32_JOURNALSENDING		10
+#define E32_JOURNALWAITING		11
+#define E32_DIRSNAPSHOT				12
+#define E32_DIRSENDING				13
+#define E32_DIRWAITING				14
 
 bool eeModelExists(uint8_t id) ;
 uint32_t get_current_block_number( uint32_t block_no, uint16_t *p_size, uint32_t *p_seq ) ;
@@ -122,9 +154,163 @@ void ee32_read_model_names( void ) ;
 void ee32LoadModelName(uint8_t id, unsigned char*buf,uint8_t len) ;
 void ee32_update_name( uint32_t id, uint8_t *source ) ;
 void convertModel( SKYModelData *dest, ModelData *source ) ;
+uint32_t ee32ReadBlockData( uint32_t block_no, uint32_t imageSize, uint8_t *dest, uint32_t size ) ;
+uint32_t ee32ReadJournal( uint32_t block_no, uint32_t imageSize, uint8_t *dest, uint32_t size ) ;
+uint32_t ee32JournalModel( uint32_t index ) ;
+void ee32JournalWriteStep( void ) ;
+uint32_t ee32ReadDirectory( void ) ;
 
 extern union t_sharedMemory SharedMemory ;
 
+struct t_journal_header
+{
+	uint16_t offset ;			// Into the data, 0xFFFF is erased flash, end of journal
+	uint8_t length ;			// Bytes of data following the header
+	uint8_t flags ;
+	uint16_t check ;			// Fletcher 16 over offset, length, flags and data
+} ;
+
+#define JOURNAL_RECORD_MAX		64		// Data bytes in a record
+#define JOURNAL_COMMIT				0x01	// In flags, last record of a save
+#define JOURNAL_BUFFER_SIZE		256		// Records written in one save
+
+uint8_t JournalBuffer[JOURNAL_BUFFER_SIZE] ;
+uint8_t Ee32_shadow_model ;		// File index whose saved data is in Eeprom_buffer, 0 none
+uint8_t Eeprom32_state_after_append ;
+uint16_t Eeprom32_append_size ;				// Bytes left to append
+
+#define DIR_BLOCK			( ( MAX_MODELS + 1 ) * 2 )
+#define DIR_MAGIC			0x5944
+#define DIR_ENTRY			1
+#define DIR_PENDING		2
+
+struct t_dir_header
+{
+	uint32_t sequence_no ;
+	uint16_t magic ;
+	uint8_t count ;				// MAX_MODELS+1 snapshot entries follow
+	uint8_t hcsum ;
+} ;
+
+struct t_dir_entry
+{
+	uint32_t sequence_no ;
+	uint16_t size ;
+	uint8_t block_no ;
+	uint8_t index ;				// File system entry
+	uint8_t name[sizeof(g_model.name)] ;
+	uint8_t type ;				// DIR_ENTRY or DIR_PENDING, 0xFF erased
+	uint8_t csum ;
+} ;
+
+#define DIR_SNAPSHOT_SIZE	( sizeof(struct t_dir_header) + (MAX_MODELS+1) * sizeof(struct t_dir_entry) )
+
+uint8_t Ee32_dir_block ;				// Current directory block
+uint8_t Ee32_dir_step ;					// Pending record written for file being written
+uint8_t Ee32_dir_state_after ;
+uint8_t Ee32_dir_page ;					// Snapshot page being written
+uint16_t Ee32_dir_next ;				// Offset for next record, 0 needs a snapshot
+uint32_t Ee32_dir_sequence ;
+
+uint16_t Ee32_block_erases[EE32_BLOCKS] ;		// Erases since power on
+uint32_t Ee32_ticks ;												// 10mS ticks since power on
+uint16_t Ee32_last_tick ;
+
+static void ee32CountErase( uint32_t eeAddress )
+{
+	uint32_t block = eeAddress >> 12 ;
+
+	if ( block < EE32_BLOCKS )
+	{
+		Ee32_block_erases[block] += 1 ;
+	}
+}
+
+// Erases of a block since the file system was created. Every full write of
+// a file erases the other block of its pair and increments its sequence
+// number, every directory snapshot does the same for the directory blocks.
+uint32_t ee32BlockErases( uint32_t block )
+{
+	uint32_t sequence ;
+	uint32_t current ;
+
+	if ( block >= EE32_BLOCKS )
+	{
+		return 0 ;
+	}
+	if ( block >= DIR_BLOCK )
+	{
+		sequence = Ee32_dir_sequence ;
+		current = Ee32_dir_block ;
+	}
+	else
+	{
+		sequence = File_system[block >> 1].sequence_no ;
+		current = File_system[block >> 1].block_no ;
+	}
+	return ( block == current ) ? ( sequence + 1 ) / 2 : sequence / 2 ;
+}
+
+// Hours until a block reaches EE32_ENDURANCE erases at the rate seen since
+// power on, for the block that gets there first. 0xFFFFFFFF if no erases.
+uint32_t ee32WearHours( uint32_t *pblock )
+{
+	uint32_t best = 0xFFFFFFFF ;
+	uint32_t block ;
+	uint32_t erases ;
+	uint64_t hours ;
+
+	for ( block = 0 ; block < EE32_BLOCKS ; block += 1 )
+	{
+		if ( Ee32_block_erases[block] == 0 )
+		{
+			continue ;
+		}
+		erases = ee32BlockErases( block ) ;
+		erases = ( erases < EE32_ENDURANCE ) ? EE32_ENDURANCE - erases : 0 ;
+		hours = (uint64_t)erases * Ee32_ticks / ( (uint64_t)Ee32_block_erases[block] * 360000 ) ;
+		if ( hours < best )
+		{
+			best = hours ;
+			*pblock = block ;
+		}
+	}
+	return best ;
+}
+
+#ifndef SMALL
+EEGeneral Ee32_general_saved ;			// Saved data of the general file, for journaled saves
+uint8_t Ee32_shadow_general ;				// Ee32_general_saved is valid
+#endif
+
+#ifndef SMALL
+// A model read ahead of it being selected, the one highlighted in the model
+// select menu, or the last one used. Filled a page at a time by ee32_process()
+// when the EEPROM is otherwise idle.
+struct t_model_prefetch
+{
+	uint8_t index ;				// File index, 0 none
+	uint8_t state ;
+	uint16_t size ;				// Bytes of data
+	uint16_t offset ;			// Bytes read so far
+	uint16_t journal ;		// File_system journal value to use with the data
+	uint32_t block_no ;		// File_system entry when read, data is stale if changed
+	uint32_t sequence_no ;
+	uint16_t imageSize ;
+	uint16_t entryJournal ;
+} ModelPrefetch ;
+
+SKYModelData ModelPrefetchData ;
+
+#define PREFETCH_IDLE			0
+#define PREFETCH_READING	1
+#define PREFETCH_VALID		2
+
+#define PREFETCH_PAGE			256
+
+void ee32PrefetchStep( void ) ;
+#endif
+
 
 
 // New file system
@@ -292,7 +478,12 @@ bool ee32CopyModel(uint8_t dst, uint8_t src)
 //#endif
 //	}
 
-  read32_eeprom_data( (File_system[src].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&Eeprom_buffer.data.sky_model_data, size, 0 ) ;
+	Ee32_shadow_model = 0 ;
+	if ( size > sizeof(g_model) )
+	{
+		size = sizeof(g_model) ;
+	}
+  ee32ReadBlockData( File_system[src].block_no, File_system[src].size, ( uint8_t *)&Eeprom_buffer.data.sky_model_data, size ) ;
 
   if (size > sizeof(g_model.name))
     memcpy( ModelNames[dst], Eeprom_buffer.data.sky_model_data.name, sizeof(g_model.name)) ;
@@ -313,6 +504,7 @@ void ee32SwapModels(uint8_t id1, uint8_t id2)
 //  // eeCheck(true) should have been called before entering here
 
   uint32_t id2_block_no ;
+  uint16_t id2_image_size ;
   uint16_t id2_size = File_system[id2].size ;
   uint16_t id1_size = File_system[id1].size ;
 	
@@ -329,6 +521,11 @@ void ee32SwapModels(uint8_t id1, uint8_t id2)
 	}
   
   id2_size = File_system[id2].size ;
+	id2_image_size = id2_size ;
+	if ( id2_size > sizeof(g_model) )
+	{
+		id2_size = sizeof(g_model) ;
+	}
 	id2_block_no = File_system[id2].block_no ;
 
   ee32CopyModel(id2, id1);
@@ -336,7 +533,7 @@ void ee32SwapModels(uint8_t id1, uint8_t id2)
 //  // block_no(id1) has been shifted now, but we have the size
   if (id2_size > sizeof(g_model.name))
 	{
-    read32_eeprom_data( (id2_block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&Eeprom_buffer.data.sky_model_data, id2_size, 0 ) ;
+    ee32ReadBlockData( id2_block_no, id2_image_size, ( uint8_t *)&Eeprom_buffer.data.sky_model_data, id2_size ) ;
     memcpy( ModelNames[id1], Eeprom_buffer.data.sky_model_data.name, sizeof(g_model.name)) ;
   }
   else
@@ -367,6 +564,7 @@ uint32_t write32_eeprom_2K( uint32_t eeAddress, register uint8_t *buffer )
 		*(p+2) = eeAddress >> 8 ;
 		*(p+3) = eeAddress ;		// 3 bytes address
 		spi_PDC_action( p, 0, 0, 4, 0 ) ;
+		ee32CountErase( eeAddress ) ;
 		wdt_reset() ;
 		// Wait for erase to complete
 		while ( Spi_complete == 0 )
@@ -588,7 +786,11 @@ bool ee32LoadGeneral()
 
 	if ( size )
 	{
-		read32_eeprom_data( ( File_system[0].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&g_eeGeneral, size, 0 ) ;
+		File_system[0].journal = ee32ReadBlockData( File_system[0].block_no, File_system[0].size, ( uint8_t *)&g_eeGeneral, size ) ;
+#ifndef SMALL
+		memcpy( &Ee32_general_saved, &g_eeGeneral, sizeof(g_eeGeneral) ) ;
+		Ee32_shadow_general = ( size == sizeof(g_eeGeneral) ) ;
+#endif
 	}
 	else
 	{
@@ -641,12 +843,122 @@ void ee32WaitLoadModel(uint8_t id)
 
 extern void closeLogs( void ) ;
 
+#ifndef SMALL
+static uint32_t ee32PrefetchCurrent()
+{
+	struct t_file_entry *entry = &File_system[ModelPrefetch.index] ;
+
+	return ( entry->block_no == ModelPrefetch.block_no ) && ( entry->sequence_no == ModelPrefetch.sequence_no )
+				 && ( entry->size == ModelPrefetch.imageSize ) && ( entry->journal == ModelPrefetch.entryJournal ) ;
+}
+
+static void ee32PrefetchStart( uint32_t index )
+{
+	struct t_file_entry *entry = &File_system[index] ;
+
+	ModelPrefetch.index = index ;
+	ModelPrefetch.block_no = entry->block_no ;
+	ModelPrefetch.sequence_no = entry->sequence_no ;
+	ModelPrefetch.imageSize = entry->size ;
+	ModelPrefetch.entryJournal = entry->journal ;
+	ModelPrefetch.size = ( entry->size > sizeof(g_model) ) ? sizeof(g_model) : entry->size ;
+	ModelPrefetch.offset = 0 ;
+	memset( &ModelPrefetchData, 0, sizeof(ModelPrefetchData) ) ;
+	ModelPrefetch.state = PREFETCH_READING ;
+}
+
+// Ask for model id to be read in the background
+void ee32PrefetchModel( uint8_t id )
+{
+	uint32_t index = id + 1 ;
+
+	if ( ( id >= MAX_MODELS ) || ( id == g_eeGeneral.currModel ) )
+	{
+		return ;		// Keep what we have, likely the last model used
+	}
+	if ( ( ModelPrefetch.index == index ) && ( ModelPrefetch.state != PREFETCH_IDLE ) && ee32PrefetchCurrent() )
+	{
+		return ;
+	}
+	ModelPrefetch.index = 0 ;
+	ModelPrefetch.state = PREFETCH_IDLE ;
+	if ( File_system[index].size >= 720 )		// Older formats need converting
+	{
+		ee32PrefetchStart( index ) ;
+	}
+}
+
+// Called from ee32_process() when idle, start reading the next page
+void ee32PrefetchStep()
+{
+	uint32_t size ;
+
+	if ( !ee32PrefetchCurrent() )
+	{
+		// Written since we started, read it again
+		if ( File_system[ModelPrefetch.index].size < 720 )
+		{
+			ModelPrefetch.state = PREFETCH_IDLE ;
+			ModelPrefetch.index = 0 ;
+			return ;
+		}
+		ee32PrefetchStart( ModelPrefetch.index ) ;
+	}
+	if ( ModelPrefetch.offset < ModelPrefetch.size )
+	{
+		size = ModelPrefetch.size - ModelPrefetch.offset ;
+		if ( size > PREFETCH_PAGE )
+		{
+			size = PREFETCH_PAGE ;
+		}
+		read32_eeprom_data( ( ModelPrefetch.block_no << 12 ) + sizeof( struct t_eeprom_header) + ModelPrefetch.offset,
+												(uint8_t *)&ModelPrefetchData + ModelPrefetch.offset, size, EE_NO_WAIT ) ;
+		ModelPrefetch.offset += size ;
+		Eeprom32_process_state = E32_READSENDING ;
+	}
+	else
+	{
+		ModelPrefetch.journal = ee32ReadJournal( ModelPrefetch.block_no, ModelPrefetch.imageSize, (uint8_t *)&ModelPrefetchData, ModelPrefetch.size ) ;
+		ModelPrefetch.state = PREFETCH_VALID ;
+	}
+}
+
+// Use the prefetched data for file index if we have it. The saved copy of
+// the model being left, in Eeprom_buffer, then becomes the prefetched model.
+static uint32_t ee32PrefetchTake( uint32_t index, uint32_t shadow )
+{
+	uint32_t taken = 0 ;
+
+	if ( ( ModelPrefetch.index == index ) && ( ModelPrefetch.state == PREFETCH_VALID ) && ee32PrefetchCurrent() )
+	{
+		memcpy( &g_model, &ModelPrefetchData, sizeof(g_model) ) ;
+		File_system[index].journal = ModelPrefetch.journal ;
+		taken = 1 ;
+	}
+	ModelPrefetch.index = 0 ;
+	ModelPrefetch.state = PREFETCH_IDLE ;
+	if ( shadow && ( shadow != index ) && ( File_system[shadow].size == sizeof(g_model) ) )
+	{
+		memcpy( &ModelPrefetchData, &Eeprom_buffer.data.sky_model_data, sizeof(g_model) ) ;
+		ee32PrefetchStart( shadow ) ;
+		ModelPrefetch.offset = ModelPrefetch.size ;
+		ModelPrefetch.journal = File_system[shadow].journal ;
+		ModelPrefetch.state = PREFETCH_VALID ;
+	}
+	return taken ;
+}
+#endif
+
 void ee32LoadModel(uint8_t id)
 {
 	uint16_t size ;
 	uint8_t version = 255 ;
+#ifndef SMALL
+	uint8_t shadow = Ee32_shadow_model ;
+#endif
 
   closeLogs() ;
+	Ee32_shadow_model = 0 ;
 
     if(id<MAX_MODELS)
     {
@@ -679,12 +991,23 @@ void ee32LoadModel(uint8_t id)
 			{
 				if ( size < 720 )
 				{
-					read32_eeprom_data( ( File_system[id+1].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&Eeprom_buffer.data.oldmodel, size, 0 ) ;
+					File_system[id+1].journal = ee32ReadBlockData( File_system[id+1].block_no, File_system[id+1].size, ( uint8_t *)&Eeprom_buffer.data.oldmodel, size ) ;
 					convertModel( &g_model, &Eeprom_buffer.data.oldmodel ) ;
 				}
 				else
 				{
-					read32_eeprom_data( ( File_system[id+1].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&g_model, size, 0 ) ;
+#ifndef SMALL
+					if ( ee32PrefetchTake( id+1, shadow ) == 0 )
+#endif
+					{
+						File_system[id+1].journal = ee32ReadBlockData( File_system[id+1].block_no, File_system[id+1].size, ( uint8_t *)&g_model, size ) ;
+					}
+					if ( size == sizeof(g_model) )
+					{
+						// Keep a copy of the saved data for journaled saves
+						memcpy( &Eeprom_buffer.data.sky_model_data, &g_model, sizeof(g_model) ) ;
+						Ee32_shadow_model = id + 1 ;
+					}
 				}	 
 				
 				if ( version != 255 )
@@ -895,11 +1218,135 @@ void fill_file_index()
 	}
 }
 
+// Fill in the file index and model names from the directory, returns 0
+// if the directory is not valid
+uint32_t ee32ReadDirectory()
+{
+	struct t_dir_header b0 ;
+	struct t_dir_header b1 ;
+	struct t_dir_entry *entry ;
+	uint8_t pending[MAX_MODELS+1] ;
+	uint32_t block ;
+	uint32_t address ;
+	uint32_t record ;
+	uint32_t size ;
+	uint32_t i ;
+	uint32_t j ;
+
+	Ee32_dir_next = 0 ;
+	// If neither block is valid, the first snapshot goes to DIR_BLOCK+1
+	Ee32_dir_block = DIR_BLOCK ;
+	Ee32_dir_sequence = 0 ;
+	read32_eeprom_data( DIR_BLOCK << 12, ( uint8_t *)&b0, sizeof(b0), EE_WAIT ) ;
+	read32_eeprom_data( (DIR_BLOCK+1) << 12, ( uint8_t *)&b1, sizeof(b1), EE_WAIT ) ;
+	if ( ( byte_checksum( ( uint8_t *)&b0, 7 ) != b0.hcsum ) || ( b0.magic != DIR_MAGIC ) || ( b0.count != MAX_MODELS+1 ) )
+	{
+		b0.sequence_no = 0 ;
+	}
+	if ( ( byte_checksum( ( uint8_t *)&b1, 7 ) != b1.hcsum ) || ( b1.magic != DIR_MAGIC ) || ( b1.count != MAX_MODELS+1 ) )
+	{
+		b1.sequence_no = 0 ;
+	}
+	if ( ( b0.sequence_no == 0 ) && ( b1.sequence_no == 0 ) )
+	{
+		return 0 ;
+	}
+	block = DIR_BLOCK ;
+	Ee32_dir_sequence = b0.sequence_no ;
+	if ( b1.sequence_no > b0.sequence_no )
+	{
+		block = DIR_BLOCK + 1 ;
+		Ee32_dir_sequence = b1.sequence_no ;
+	}
+	Ee32_dir_block = block ;
+
+	memset( pending, 0, sizeof(pending) ) ;
+	record = 0 ;
+	address = sizeof(struct t_dir_header) ;
+	// Read a buffer full of records at a time
+	while ( address + sizeof(struct t_dir_entry) <= 4096 )
+	{
+		size = ( JOURNAL_BUFFER_SIZE / sizeof(struct t_dir_entry) ) * sizeof(struct t_dir_entry) ;
+		if ( address + size > 4096 )
+		{
+			size = ( ( 4096 - address ) / sizeof(struct t_dir_entry) ) * sizeof(struct t_dir_entry) ;
+		}
+		read32_eeprom_data( ( block << 12 ) + address, JournalBuffer, size, EE_WAIT ) ;
+		for ( j = 0 ; j < size ; j += sizeof(struct t_dir_entry), address += sizeof(struct t_dir_entry), record += 1 )
+		{
+			entry = (struct t_dir_entry *) &JournalBuffer[j] ;
+			if ( record > MAX_MODELS )
+			{
+				// Update records
+				for ( i = 0 ; i < sizeof(struct t_dir_entry) ; i += 1 )
+				{
+					if ( JournalBuffer[j+i] != 0xFF )
+					{
+						break ;
+					}
+				}
+				if ( i == sizeof(struct t_dir_entry) )
+				{
+					Ee32_dir_next = address ;		// End of records, append here
+					goto done ;
+				}
+			}
+			if ( ( byte_checksum( ( uint8_t *)entry, sizeof(struct t_dir_entry) - 1 ) != entry->csum )
+					 || ( entry->index > MAX_MODELS )
+					 || ( ( record <= MAX_MODELS ) && ( ( entry->index != record ) || ( entry->type != DIR_ENTRY ) ) ) )
+			{
+				if ( record <= MAX_MODELS )
+				{
+					return 0 ;		// Bad snapshot
+				}
+				goto done ;			// Bad record, stop here and write a new snapshot
+			}
+			i = entry->index ;
+			if ( entry->type == DIR_PENDING )
+			{
+				pending[i] = 1 ;
+			}
+			else
+			{
+				pending[i] = 0 ;
+				File_system[i].block_no = entry->block_no ;
+				File_system[i].size = entry->size ;
+				File_system[i].sequence_no = entry->sequence_no ;
+				File_system[i].journal = 0 ;
+				if ( i )
+				{
+					memcpy( ModelNames[i], entry->name, sizeof(g_model.name) ) ;
+				}
+			}
+		}
+	}
+done:
+	// Files being written when power was lost
+	for ( i = 0 ; i <= MAX_MODELS ; i += 1 )
+	{
+		if ( pending[i] )
+		{
+			File_system[i].block_no = get_current_block_number( i * 2, &File_system[i].size, &File_system[i].sequence_no ) ;
+			if ( i )
+			{
+				ee32LoadModelName( i, ModelNames[i], sizeof(g_model.name) ) ;
+			}
+			Ee32_dir_next = 0 ;
+		}
+	}
+	return 1 ;
+}
+
 void init_eeprom()
 {
-	fill_file_index() ;
-	ee32_read_model_names() ;
 	Eeprom32_process_state = E32_IDLE ;
+	Ee32_dir_step = 0 ;
+	if ( ee32ReadDirectory() == 0 )
+	{
+		fill_file_index() ;
+		ee32_read_model_names() ;
+		Ee32_dir_next = 0 ;		// Snapshot written when idle
+	}
 }
 
 
@@ -947,89 +1394,447 @@ uint32_t ee32_check_finished()
 	return 1 ;
 }
 
-//#define SPI_PCB9XT 1
-
-//#ifdef SPI_PCB9XT
-//uint32_t DebugSpiEnc ;
-//#endif
-
-void ee32_process()
+uint16_t journalCheck( struct t_journal_header *header, uint8_t *data )
 {
-	register uint8_t *p ;
-	register uint8_t *q ;
-	register uint32_t x ;
-	register uint32_t eeAddress ;
-
-//	return 0 ;
+	uint32_t sum1 = 0 ;
+	uint32_t sum2 = 0 ;
+	uint8_t *p = (uint8_t *)header ;
+	uint32_t i ;
 
-	if ( General_timer )
+	for ( i = 0 ; i < 4 + (uint32_t)header->length ; i += 1 )
 	{
-		if ( --General_timer == 0 )
+		if ( i == 4 )
 		{
-			
-			// Time to write g_eeGeneral
-			Ee32_general_write_pending = 1 ;
+			p = data ;
 		}
+		sum1 = ( sum1 + *p++ ) % 255 ;
+		sum2 = ( sum2 + sum1 ) % 255 ;
 	}
-	if ( Model_timer )
+	return ( sum2 << 8 ) | sum1 ;
+}
+
+// Returns 1 if the block is erased from address to its end
+uint32_t ee32BlankToEnd( uint32_t blockAddress, uint32_t address )
+{
+	uint8_t temp[32] ;
+	uint32_t i ;
+	uint32_t size ;
+
+	while ( address < 4096 )
 	{
-		if ( --Model_timer == 0 )
+		size = 4096 - address ;
+		if ( size > sizeof(temp) )
 		{
-			
-			// Time to write model
-			Ee32_model_write_pending = 1 ;
+			size = sizeof(temp) ;
+		}
+		read32_eeprom_data( blockAddress + address, temp, size, 0 ) ;
+		for ( i = 0 ; i < size ; i += 1 )
+		{
+			if ( temp[i] != 0xFF )
+			{
+				return 0 ;
+			}
 		}
+		address += size ;
 	}
+	return 1 ;
+}
 
-#ifdef PCB9XT
-	if ( ( Eeprom32_process_state == E32_IDLE ) || Spi_complete )
-	{
-		// Poll an Arduino for encoder data
-//		uint32_t result ;
-		uint16_t result ;
-//extern uint32_t readSpiEncoder() ;
-extern uint16_t readSpiEncoder() ;
-		result = readSpiEncoder() ;
-
-//#ifdef SPI_PCB9XT
-//		DebugSpiEnc = result ;
-//#endif
+// Read size bytes of the data in a block, of which imageSize were written as
+// a whole, then apply any journal records. Returns the offset in the block
+// for the next record, or 0 if no more records may be added.
+uint32_t ee32ReadBlockData( uint32_t block_no, uint32_t imageSize, uint8_t *dest, uint32_t size )
+{
+	uint32_t blockAddress = block_no << 12 ;
 
-		if ( ( result & 0xFE00 ) == 0xAA00 )
-		{
-extern uint8_t EncoderI2cData[] ;
-extern uint8_t SpiEncoderValid ;
-			EncoderI2cData[1] = (result & 0x0100) ? 1 : 0 ;
-			EncoderI2cData[0] = result ;
-			SpiEncoderValid = 1 ;
-		}
+	if ( size )
+	{
+		read32_eeprom_data( blockAddress + sizeof( struct t_eeprom_header), dest, size, 0 ) ;
 	}
-#endif
+	return ee32ReadJournal( block_no, imageSize, dest, size ) ;
+}
 
-	if ( Eeprom32_process_state == E32_IDLE )
+// Read and check the journal record at address in a block. Returns the size
+// of the record, or 0 if it is erased (header->offset is 0xFFFF) or not valid
+static uint32_t journalRecord( uint32_t blockAddress, uint32_t address, uint32_t imageSize, struct t_journal_header *header, uint8_t *data )
+{
+	read32_eeprom_data( blockAddress + address, ( uint8_t *)header, sizeof(*header), 0 ) ;
+	if ( ( header->offset == 0xFFFF ) || ( header->length == 0 ) || ( header->length > JOURNAL_RECORD_MAX )
+			 || ( (uint32_t)header->offset + header->length > imageSize )
+			 || ( address + sizeof(*header) + header->length > 4096 ) )
 	{
-		if ( Ee32_general_write_pending )
-		{
-			Ee32_general_write_pending = 0 ;			// clear flag
+		return 0 ;
+	}
+	read32_eeprom_data( blockAddress + address + sizeof(*header), data, header->length, 0 ) ;
+	if ( journalCheck( header, data ) != header->check )
+	{
+		return 0 ;
+	}
+	return sizeof(*header) + header->length ;
+}
 
-			// Check we can write, == block is blank
+// Apply the journal records following the data in block_no to dest, a save
+// at a time, only when the save's commit record has been found
+uint32_t ee32ReadJournal( uint32_t block_no, uint32_t imageSize, uint8_t *dest, uint32_t size )
+{
+	struct t_journal_header header ;
+	uint8_t data[JOURNAL_RECORD_MAX] ;
+	uint32_t blockAddress = block_no << 12 ;
+	uint32_t address ;
+	uint32_t batch ;			// Start of the save being checked
+	uint32_t length ;
+	uint32_t i ;
 
-			Eeprom32_source_address = (uint8_t *)&g_eeGeneral ;		// Get data fromm here
-			Eeprom32_data_size = sizeof(g_eeGeneral) ;						// This much
-			Eeprom32_file_index = 0 ;								// This file system entry
-			Eeprom32_process_state = E32_BLANKCHECK ;
+	if ( imageSize == 0 )
+	{
+		return 0 ;
+	}
+	address = sizeof( struct t_eeprom_header) + imageSize ;
+	batch = address ;
+	while ( address + sizeof(header) <= 4096 )
+	{
+		length = journalRecord( blockAddress, address, imageSize, &header, data ) ;
+		if ( length == 0 )
+		{
+			if ( header.offset == 0xFFFF )
+			{
+				// End of journal, only append if no save was partly written here
+				return ( ( batch == address ) && ee32BlankToEnd( blockAddress, address ) ) ? address : 0 ;
+			}
+			break ;
 		}
-		else if ( Ee32_model_write_pending )
+		address += length ;
+		if ( header.flags & JOURNAL_COMMIT )
 		{
-			Ee32_model_write_pending = 0 ;			// clear flag
+			while ( batch < address )
+			{
+				length = journalRecord( blockAddress, batch, imageSize, &header, data ) ;
+				if ( length == 0 )
+				{
+					return 0 ;
+				}
+				for ( i = 0 ; i < header.length ; i += 1 )
+				{
+					if ( header.offset + i < size )
+					{
+						dest[header.offset + i] = data[i] ;
+					}
+				}
+				batch += length ;
+			}
+		}
+	}
+	return 0 ;
+}
 
-			// Check we can write, == block is blank
+// Start, or continue, appending Eeprom32_append_size bytes, a page at a time
+void ee32JournalWriteStep()
+{
+	uint32_t size ;
 
-			Eeprom32_source_address = (uint8_t *)&g_model ;		// Get data from here
-			Eeprom32_data_size = sizeof(g_model) ;						// This much
-			Eeprom32_file_index = Dirty.Model_dirty ;								// This file system entry
-			Eeprom32_process_state = E32_BLANKCHECK ;
-//			Writing_model = Dirty.Model_dirty ;
+	size = 256 - ( Eeprom32_address & 0xFF ) ;	// To the end of this page
+	if ( size > Eeprom32_append_size )
+	{
+		size = Eeprom32_append_size ;
+	}
+	write32_eeprom_block( Eeprom32_address, Eeprom32_buffer_address, size, 1 ) ;
+	Eeprom32_address += size ;
+	Eeprom32_buffer_address += size ;
+	Eeprom32_append_size -= size ;
+	Eeprom32_process_state = E32_JOURNALSENDING ;
+}
+
+// Save current as journal records in the current block of file index,
+// comparing it with saved, the copy of the data in the block, from byte i.
+// Returns 1 if this has been done, 0 if the whole file needs to be written.
+static uint32_t ee32JournalData( uint32_t index, uint8_t *saved, uint8_t *current, uint32_t size, uint32_t i )
+{
+	struct t_file_entry *entry = &File_system[index] ;
+	struct t_journal_header header ;
+	uint32_t used = 0 ;
+	uint32_t last = 0 ;
+	uint32_t start ;
+	uint32_t end ;
+
+	if ( ( entry->journal == 0 ) || ( entry->size < size ) )
+	{
+		return 0 ;
+	}
+	while ( i < size )
+	{
+		if ( saved[i] == current[i] )
+		{
+			i += 1 ;
+			continue ;
+		}
+		start = i ;
+		end = i + 1 ;
+		// Include gaps shorter than a header in the same record
+		for ( i = end ; i < size ; i += 1 )
+		{
+			if ( i - start >= JOURNAL_RECORD_MAX )
+			{
+				break ;
+			}
+			if ( saved[i] != current[i] )
+			{
+				end = i + 1 ;
+			}
+			else if ( i - end >= sizeof(header) )
+			{
+				break ;
+			}
+		}
+		if ( used + sizeof(header) + ( end - start ) > JOURNAL_BUFFER_SIZE )
+		{
+			return 0 ;		// Too many changes
+		}
+		header.offset = start ;
+		header.length = end - start ;
+		header.flags = 0 ;
+		header.check = journalCheck( &header, &current[start] ) ;
+		memcpy( &JournalBuffer[used], &header, sizeof(header) ) ;
+		memcpy( &JournalBuffer[used + sizeof(header)], &current[start], end - start ) ;
+		last = used ;
+		used += sizeof(header) + ( end - start ) ;
+		i = end ;
+	}
+	if ( used == 0 )
+	{
+		return 1 ;		// Nothing changed
+	}
+	// The save only counts once its last record has been written
+	memcpy( &header, &JournalBuffer[last], sizeof(header) ) ;
+	header.flags = JOURNAL_COMMIT ;
+	header.check = journalCheck( &header, &JournalBuffer[last + sizeof(header)] ) ;
+	memcpy( &JournalBuffer[last], &header, sizeof(header) ) ;
+	if ( entry->journal + used > 4096 )
+	{
+		return 0 ;		// Journal full, write the whole file
+	}
+	memcpy( saved, current, size ) ;
+	Eeprom32_address = ( entry->block_no << 12 ) + entry->journal ;
+	Eeprom32_buffer_address = JournalBuffer ;
+	Eeprom32_append_size = used ;
+	entry->journal += used ;
+	Eeprom32_state_after_append = E32_IDLE ;
+	ee32JournalWriteStep() ;
+	return 1 ;
+}
+
+// Save g_model as journal records, the copy of the saved data is in Eeprom_buffer
+uint32_t ee32JournalModel( uint32_t index )
+{
+	if ( Ee32_shadow_model != index )
+	{
+		return 0 ;
+	}
+	// Model names are read from the written data, not the journal
+	if ( memcmp( &Eeprom_buffer.data.sky_model_data, &g_model, sizeof(g_model.name) ) )
+	{
+		return 0 ;
+	}
+	return ee32JournalData( index, (uint8_t *)&Eeprom_buffer.data.sky_model_data, (uint8_t *)&g_model, sizeof(g_model), sizeof(g_model.name) ) ;
+}
+
+#ifndef SMALL
+// The general settings are the file saved most often, journal them as well
+// so the two blocks they use are not erased on every save
+uint32_t ee32JournalGeneral()
+{
+	if ( Ee32_shadow_general == 0 )
+	{
+		return 0 ;
+	}
+	return ee32JournalData( 0, (uint8_t *)&Ee32_general_saved, (uint8_t *)&g_eeGeneral, sizeof(g_eeGeneral), 0 ) ;
+}
+#endif
+
+// Build a directory entry for file index
+void ee32DirEntry( struct t_dir_entry *entry, uint32_t index, uint32_t type )
+{
+	entry->sequence_no = File_system[index].sequence_no ;
+	entry->size = File_system[index].size ;
+	entry->block_no = File_system[index].block_no ;
+	entry->index = index ;
+	memcpy( entry->name, ModelNames[index], sizeof(g_model.name) ) ;
+	entry->type = type ;
+	entry->csum = byte_checksum( ( uint8_t *)entry, sizeof(struct t_dir_entry) - 1 ) ;
+}
+
+// Append a directory record, then go to state
+void ee32DirRecord( uint32_t index, uint32_t type, uint32_t state )
+{
+	ee32DirEntry( (struct t_dir_entry *) JournalBuffer, index, type ) ;
+	Eeprom32_address = ( Ee32_dir_block << 12 ) + Ee32_dir_next ;
+	Eeprom32_buffer_address = JournalBuffer ;
+	Eeprom32_append_size = sizeof(struct t_dir_entry) ;
+	Ee32_dir_next += sizeof(struct t_dir_entry) ;
+	Eeprom32_state_after_append = state ;
+	ee32JournalWriteStep() ;
+}
+
+// Start writing a snapshot of the directory to the other block, then go to state
+void ee32DirSnapshot( uint32_t state )
+{
+	uint32_t eeAddress ;
+	uint8_t *p ;
+
+	Ee32_dir_state_after = state ;
+	Ee32_dir_page = ( DIR_SNAPSHOT_SIZE - 1 ) / 256 ;		// Last page first
+	eeAddress = ( Ee32_dir_block ^ 1 ) << 12 ;
+	eeprom_write_enable() ;
+	p = Spi_tx_buf ;
+	*p = 0x20 ;		// Block Erase command
+	*(p+1) = eeAddress >> 16 ;
+	*(p+2) = eeAddress >> 8 ;
+	*(p+3) = eeAddress ;		// 3 bytes address
+	spi_PDC_action( p, 0, 0, 4, 0 ) ;
+	ee32CountErase( eeAddress ) ;
+	Eeprom32_process_state = E32_ERASESENDING ;
+	Eeprom32_state_after_erase = E32_DIRSNAPSHOT ;
+}
+
+// Build and write one page of the snapshot
+void ee32DirSnapshotPage()
+{
+	struct t_dir_header header ;
+	struct t_dir_entry entry ;
+	uint32_t start = Ee32_dir_page * 256 ;
+	uint32_t end = start + 256 ;
+	uint32_t offset ;
+	uint32_t i ;
+	uint32_t j ;
+
+	if ( end > DIR_SNAPSHOT_SIZE )
+	{
+		end = DIR_SNAPSHOT_SIZE ;
+	}
+	if ( start == 0 )
+	{
+		header.sequence_no = Ee32_dir_sequence + 1 ;
+		header.magic = DIR_MAGIC ;
+		header.count = MAX_MODELS + 1 ;
+		header.hcsum = byte_checksum( ( uint8_t *)&header, 7 ) ;
+		memcpy( JournalBuffer, &header, sizeof(header) ) ;
+	}
+	// Entries that are all, or partly, in this page
+	i = ( start < sizeof(header) ) ? 0 : ( start - sizeof(header) ) / sizeof(entry) ;
+	for ( ; i <= MAX_MODELS ; i += 1 )
+	{
+		offset = sizeof(header) + i * sizeof(entry) ;
+		if ( offset >= end )
+		{
+			break ;
+		}
+		ee32DirEntry( &entry, i, DIR_ENTRY ) ;
+		for ( j = 0 ; j < sizeof(entry) ; j += 1 )
+		{
+			if ( ( offset + j >= start ) && ( offset + j < end ) )
+			{
+				JournalBuffer[offset + j - start] = ((uint8_t *)&entry)[j] ;
+			}
+		}
+	}
+	write32_eeprom_block( ( ( Ee32_dir_block ^ 1 ) << 12 ) + start, JournalBuffer, end - start, 1 ) ;
+	Eeprom32_process_state = E32_DIRSENDING ;
+}
+
+//#define SPI_PCB9XT 1
+
+//#ifdef SPI_PCB9XT
+//uint32_t DebugSpiEnc ;
+//#endif
+
+void ee32_process()
+{
+	register uint8_t *p ;
+	register uint8_t *q ;
+	register uint32_t x ;
+	register uint32_t eeAddress ;
+
+//	return 0 ;
+
+	x = get_tmr10ms() ;
+	Ee32_ticks += (uint16_t)( x - Ee32_last_tick ) ;
+	Ee32_last_tick = x ;
+	if ( General_timer )
+	{
+		if ( --General_timer == 0 )
+		{
+			
+			// Time to write g_eeGeneral
+			Ee32_general_write_pending = 1 ;
+		}
+	}
+	if ( Model_timer )
+	{
+		if ( --Model_timer == 0 )
+		{
+			
+			// Time to write model
+			Ee32_model_write_pending = 1 ;
+		}
+	}
+
+#ifdef PCB9XT
+	if ( ( Eeprom32_process_state == E32_IDLE ) || Spi_complete )
+	{
+		// Poll an Arduino for encoder data
+//		uint32_t result ;
+		uint16_t result ;
+//extern uint32_t readSpiEncoder() ;
+extern uint16_t readSpiEncoder() ;
+		result = readSpiEncoder() ;
+
+//#ifdef SPI_PCB9XT
+//		DebugSpiEnc = result ;
+//#endif
+
+		if ( ( result & 0xFE00 ) == 0xAA00 )
+		{
+extern uint8_t EncoderI2cData[] ;
+extern uint8_t SpiEncoderValid ;
+			EncoderI2cData[1] = (result & 0x0100) ? 1 : 0 ;
+			EncoderI2cData[0] = result ;
+			SpiEncoderValid = 1 ;
+		}
+	}
+#endif
+
+	if ( Eeprom32_process_state == E32_IDLE )
+	{
+		if ( Ee32_general_write_pending )
+		{
+			Ee32_general_write_pending = 0 ;			// clear flag
+#ifndef SMALL
+			if ( ee32JournalGeneral() == 0 )
+#endif
+			{
+				Ee32_shadow_model = 0 ;								// Eeprom_buffer will hold general
+
+				// Check we can write, == block is blank
+
+				Eeprom32_source_address = (uint8_t *)&g_eeGeneral ;		// Get data fromm here
+				Eeprom32_data_size = sizeof(g_eeGeneral) ;						// This much
+				Eeprom32_file_index = 0 ;								// This file system entry
+				Eeprom32_process_state = E32_BLANKCHECK ;
+			}
+		}
+		else if ( Ee32_model_write_pending )
+		{
+			Ee32_model_write_pending = 0 ;			// clear flag
+
+			if ( ee32JournalModel( Dirty.Model_dirty ) == 0 )
+			{
+				// Check we can write, == block is blank
+
+				Eeprom32_source_address = (uint8_t *)&g_model ;		// Get data from here
+				Eeprom32_data_size = sizeof(g_model) ;						// This much
+				Eeprom32_file_index = Dirty.Model_dirty ;								// This file system entry
+				Eeprom32_process_state = E32_BLANKCHECK ;
+//				Writing_model = Dirty.Model_dirty ;
+			}
 		}
 		else if ( Ee32_model_delete_pending )
 		{
@@ -1039,10 +1844,43 @@ extern uint8_t SpiEncoderValid ;
 			Ee32_model_delete_pending = 0 ;
 			Eeprom32_process_state = E32_BLANKCHECK ;
 		}
+		else if ( Ee32_dir_next == 0 )
+		{
+			ee32DirSnapshot( E32_IDLE ) ;
+		}
+#ifndef SMALL
+		else if ( ( ModelPrefetch.state == PREFETCH_READING ) && ( General_timer == 0 ) && ( Model_timer == 0 ) )
+		{
+			ee32PrefetchStep() ;
+		}
+#endif
+	}
+
+	if ( Eeprom32_process_state == E32_READSENDING )
+	{
+		if ( Spi_complete )
+		{
+			Eeprom32_process_state = E32_IDLE ;
+		}
 	}
 
 	if ( Eeprom32_process_state == E32_BLANKCHECK )
 	{
+		if ( Ee32_dir_step == 0 )
+		{
+			// Record the write in the directory first
+			if ( ( Ee32_dir_next == 0 ) || ( Ee32_dir_next + 2 * sizeof(struct t_dir_entry) > 4096 ) )
+			{
+				ee32DirSnapshot( E32_BLANKCHECK ) ;
+			}
+			else
+			{
+				Ee32_dir_step = 1 ;
+				ee32DirRecord( Eeprom32_file_index, DIR_PENDING, E32_BLANKCHECK ) ;
+			}
+		}
+		else
+		{
 		eeAddress = File_system[Eeprom32_file_index].block_no ^ 1 ;
 		eeAddress <<= 12 ;		// Block start address
 		Eeprom32_address = eeAddress ;						// Where to put new data
@@ -1053,8 +1891,10 @@ extern uint8_t SpiEncoderValid ;
 				*(p+2) = eeAddress >> 8 ;
 				*(p+3) = eeAddress ;		// 3 bytes address
 				spi_PDC_action( p, 0, 0, 4, 0 ) ;
+				ee32CountErase( eeAddress ) ;
 				Eeprom32_process_state = E32_ERASESENDING ;
 				Eeprom32_state_after_erase = E32_WRITESTART ;
+		}
 	}
 
 	if ( Eeprom32_process_state == E32_WRITESTART )
@@ -1069,6 +1909,18 @@ extern uint8_t SpiEncoderValid ;
 				*q++ = *p++ ;			// Copy the data to temp buffer
 			}
 		}
+		// Eeprom_buffer now matches the saved data if that is g_model
+		Ee32_shadow_model = ( ( Eeprom32_source_address == (uint8_t *)&g_model ) && ( Eeprom32_data_size == sizeof(g_model) ) ) ? Eeprom32_file_index : 0 ;
+#ifndef SMALL
+		if ( Eeprom32_file_index == 0 )
+		{
+			Ee32_shadow_general = ( Eeprom32_source_address == (uint8_t *)&g_eeGeneral ) && ( Eeprom32_data_size == sizeof(g_eeGeneral) ) ;
+			if ( Ee32_shadow_general )
+			{
+				memcpy( &Ee32_general_saved, &g_eeGeneral, sizeof(g_eeGeneral) ) ;
+			}
+		}
+#endif
 		Eeprom_buffer.header.sequence_no = ++File_system[Eeprom32_file_index].sequence_no ;
 		File_system[Eeprom32_file_index].size = Eeprom_buffer.header.data_size = Eeprom32_data_size ;
 		Eeprom_buffer.header.flags = 0 ;
@@ -1116,7 +1968,80 @@ extern uint8_t SpiEncoderValid ;
 			else
 			{
 				File_system[Eeprom32_file_index].block_no ^= 1 ;		// This is now the current block
+				File_system[Eeprom32_file_index].journal = ( Eeprom32_data_size ) ? sizeof( struct t_eeprom_header ) + Eeprom32_data_size : 0 ;
 				Eeprom32_process_state = E32_IDLE ;
+				if ( Eeprom32_file_index )
+				{
+					// Name as it will be read from the file
+					if ( Eeprom32_data_size > sizeof(g_model.name) )
+					{
+						memcpy( ModelNames[Eeprom32_file_index], Eeprom_buffer.data.sky_model_data.name, sizeof(g_model.name) ) ;
+					}
+					else
+					{
+						memset( ModelNames[Eeprom32_file_index], ' ', sizeof(g_model.name) ) ;
+					}
+				}
+				Ee32_dir_step = 0 ;
+				ee32DirRecord( Eeprom32_file_index, DIR_ENTRY, E32_IDLE ) ;
+			}
+		}
+	}	
+
+	if ( Eeprom32_process_state == E32_JOURNALSENDING )
+	{
+		if ( Spi_complete )
+		{
+			Eeprom32_process_state = E32_JOURNALWAITING ;
+		}			
+	}		
+
+	if ( Eeprom32_process_state == E32_JOURNALWAITING )
+	{
+		x = eeprom_read_status() ;
+		if ( ( x & 1 ) == 0 )
+		{
+			if ( Eeprom32_append_size )		// More to write
+			{
+				ee32JournalWriteStep() ;
+			}
+			else
+			{
+				Eeprom32_process_state = Eeprom32_state_after_append ;
+			}
+		}
+	}	
+
+	if ( Eeprom32_process_state == E32_DIRSNAPSHOT )
+	{
+		ee32DirSnapshotPage() ;
+	}
+
+	if ( Eeprom32_process_state == E32_DIRSENDING )
+	{
+		if ( Spi_complete )
+		{
+			Eeprom32_process_state = E32_DIRWAITING ;
+		}			
+	}		
+
+	if ( Eeprom32_process_state == E32_DIRWAITING )
+	{
+		x = eeprom_read_status() ;
+		if ( ( x & 1 ) == 0 )
+		{
+			if ( Ee32_dir_page )		// More to write
+			{
+				Ee32_dir_page -= 1 ;
+				Eeprom32_process_state = E32_DIRSNAPSHOT ;
+			}
+			else
+			{
+				// Header written last, the snapshot is now current
+				Ee32_dir_block ^= 1 ;
+				Ee32_dir_sequence += 1 ;
+				Ee32_dir_next = DIR_SNAPSHOT_SIZE ;
+				Eeprom32_process_state = Ee32_dir_state_after ;
 			}
 		}
 	}	
@@ -1369,205 +2294,15 @@ void setModelFilename( uint8_t *filename, uint8_t modelIndex, uint32_t type )
 
 #ifndef PCBDUE
 
-static const uint8_t base64digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" ;
-
-// write XML file
-FRESULT writeXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalWritten )
+const char *ee32BackupModel( uint8_t modelIndex )
 {
-  UINT written ;
-  UINT total = 0 ;
-	uint32_t i ;
+//	uint8_t filename[50] ;
+  uint16_t size ;
 	FRESULT result ;
-  uint8_t bytes[104] ;
-
-  result = f_write( archiveFile, (BYTE *)"<!DOCTYPE ERSKY9X_EEPROM_FILE>\n<ERSKY9X_EEPROM_FILE>\n <MODEL_DATA number=\0420\042>\n  <Version>", 89, &written ) ;
-	total += written ;
-  bytes[0] = MDSKYVERS + '0' ;
-  bytes[1] = 0 ;
-  result = f_write( archiveFile, bytes, 1, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Version>\n  <Name>", 19, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)Eeprom_buffer.data.sky_model_data.name, sizeof(g_model.name), &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Name>\n  <Data><![CDATA[", 25, &written) ;
-	total += written ;
-
-// Send base 64 here
-	i = 0 ;
-	while ( size > 2 )
-	{
-		bytes[i++] = base64digits[data[0] >> 2];
- 		bytes[i++] = base64digits[((data[0] << 4) & 0x30) | (data[1] >> 4)];
-		bytes[i++] = base64digits[((data[1] << 2) & 0x3c) | (data[2] >> 6)];
-		bytes[i++] = base64digits[data[2] & 0x3f];
-		data += 3 ;
-		size -= 3 ;
-		if ( i >= 100 )
-		{
-		  result = f_write( archiveFile, bytes, 100, &written) ;
-			total += written ;
-			i = 0 ;
-		}
-	}
-
-	uint8_t fragment ;
-	if ( size )
-	{
-		bytes[i++] = base64digits[data[0] >> 2] ;
-		fragment = (data[0] << 4) & 0x30 ;
-		if ( --size )
-		{
- 			fragment |= data[1] >> 4 ;
-		}
-		bytes[i++] = base64digits[fragment];
-		bytes[i++] = ( size == 1 ) ? base64digits[(data[1] << 2) & 0x3c] : '=' ;
-		bytes[i++] = '=' ;
-	}
-	if ( i )
-	{
-		result = f_write( archiveFile, bytes, i, &written) ;
-		total += written ;
-	}
-  result = f_write( archiveFile, (BYTE *)"]]></Data>\n </MODEL_DATA>\n</ERSKY9X_EEPROM_FILE>\n", 49, &written) ;
-	total += written ;
-	*totalWritten = total ;
- return result ;
-}
-
-uint8_t xmlDecode( uint8_t value )
-{
-	if ( value >= 'A' )
-	{
-		if ( value <= 'Z' )
-		{
-			return value - 'A' ;
-		}
-		return value - ( 'a' - 26 ) ;		// 'a'-'z'		
-	}
-	else
-	{
-		if ( value >= '0' )
-		{
-			return value + 4 ;
-		}
-		if ( value == '+' )
-		{
-			return 62 ;
-		}
-		else if ( value == '/' )
-		{
-			return 63 ;
-		}
-		else
-		{
-			return 255 ;		// '='
-		}
-	}
-}
-
-
-int32_t readXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalRead )
-{
-  UINT nread ;
-  UINT total = 0 ;
-	uint32_t i ;
-	uint32_t j ;
-	FRESULT result ;
-	uint8_t stream[4] ;
-  uint8_t bytes[104] ;
-
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	if ( strncmp( (const char *)&bytes[10], "ERSKY9X_", 8 ) )
-	{
-		return -1 ;		// Invalid file
-	}
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	// Search for "CDATA[" starting at offset 30
-	for ( i = 30 ; i < 50 ; i += 1 )
-	{
-		if ( !strncmp( (const char *)&bytes[i], "CDATA[", 6 ) )
-		{
-			break ;
-		}
-	}
-	if ( i >= 50 )
-	{
-		return -1 ;		// Invalid file
-	}
-	i += 6 ;	// Index of base64 data
-	j = 0 ;
-	while ( size )
-	{
-		if ( i >= nread )
-		{
-			result = f_read( archiveFile,  bytes, 100, &nread ) ;
-			total += nread ;
-			i = 0 ;
-		}
-		if ( i < nread )
-		{
-			uint8_t value = bytes[i] ;
-			if ( value == ']' )		// End of input data
-			{
-				stream[j++] = 0 ;
-			}
-			else
-			{
-				i += 1 ;
-				stream[j++] = xmlDecode( value ) ;
-			}
-		}
-		else
-		{
-			break ;
-		}
-		if ( j >= 4 )
-		{
-		  *data++ = ( stream[0] << 2) | (stream[1] >> 4) ;
-			size -= 1 ;
-			if ( size == 0 )
-			{
-				break ;
-			}
-			if ( stream[2] != 255 )
-			{
-		  	*data++ = ((stream[1] << 4) & 0xf0) | (stream[2] >> 2);
-				size -= 1 ;
-				if ( size == 0 )
-				{
-					break ;
-				}
-			}
-			if ( stream[3] != 255 )
-			{
-  			*data++ = ((stream[2] << 6) & 0xc0) | stream[3] ;
-				size -= 1 ;
-			}
-			j = 0 ;
-		}
-	}
-	while ( size )
-	{
-		*data++ = 0 ;
-		size -= 1 ;
-	}
-	*totalRead = total ;
-	return result ; 
-}
-
-
-const char *ee32BackupModel( uint8_t modelIndex )
-{
-//	uint8_t filename[50] ;
-  uint16_t size ;
-	FRESULT result ;
-  DIR archiveFolder ;
-  FIL archiveFile ;
-  UINT written ;
-	uint8_t filename[50] ;
+  DIR archiveFolder ;
+  FIL archiveFile ;
+  UINT written ;
+	uint8_t filename[50] ;
 
 
 	// Check for SD avaliable
@@ -1591,8 +2326,13 @@ const char *ee32BackupModel( uint8_t modelIndex )
 //#endif
 //	}
 
+	Ee32_shadow_model = 0 ;
+	if ( size > sizeof(g_model) )
+	{
+		size = sizeof(g_model) ;
+	}
 	memset(( uint8_t *)&Eeprom_buffer.data.sky_model_data, 0, sizeof(g_model));
-  read32_eeprom_data( (File_system[modelIndex].block_no << 12) + sizeof( struct t_eeprom_header), ( uint8_t *)&Eeprom_buffer.data.sky_model_data, size, 0 ) ;
+  ee32ReadBlockData( File_system[modelIndex].block_no, File_system[modelIndex].size, ( uint8_t *)&Eeprom_buffer.data.sky_model_data, size ) ;
 
 	// Build filename
 	setModelFilename( filename, modelIndex, FILE_TYPE_MODEL ) ;
@@ -1617,7 +2357,7 @@ const char *ee32BackupModel( uint8_t modelIndex )
    	return "CREATE ERROR" ;
   }
 
-	result = writeXMLfile( &archiveFile, (uint8_t *)&Eeprom_buffer.data.sky_model_data, size, &written) ;
+	result = writeXMLfile( &archiveFile, (uint8_t *)&Eeprom_buffer.data.sky_model_data, size, &written, (uint8_t *)Eeprom_buffer.data.sky_model_data.name ) ;
   
 	f_close(&archiveFile) ;
   if (result != FR_OK ) //	|| written != size)
@@ -1662,6 +2402,7 @@ const char *ee32RestoreModel( uint8_t modelIndex, char *filename )
    	return "OPEN ERROR" ;
   }
 
+	Ee32_shadow_model = 0 ;
 	memset(( uint8_t *)&Eeprom_buffer.data.sky_model_data, 0, sizeof(g_model));
 	
 	answer = readXMLfile( &archiveFile,  ( uint8_t *)&Eeprom_buffer.data.sky_model_data, sizeof(Eeprom_buffer.data.sky_model_data), &nread ) ;
@@ -1690,6 +2431,410 @@ const char *ee32RestoreModel( uint8_t modelIndex, char *filename )
 
 #define EEPROM_PATH           "/EEPROM"   // no trailing slash = important
 
+// Model archive, written and read a sector at a time through ArchiveBuffer
+uint32_t ArchiveCount ;
+uint32_t ArchiveIndex ;
+FRESULT ArchiveResult ;
+
+static void archiveFlush()
+{
+	UINT written ;
+
+	if ( ArchiveCount && ( ArchiveResult == FR_OK ) )
+	{
+		ArchiveResult = f_write( &SharedMemory.g_eebackupFile, SharedMemory.ArchiveBuffer, ArchiveCount, &written ) ;
+		if ( ( ArchiveResult == FR_OK ) && ( written != ArchiveCount ) )
+		{
+			ArchiveResult = FR_DISK_ERR ;		// Card full
+		}
+		wdt_reset() ;
+	}
+	ArchiveCount = 0 ;
+}
+
+static void archivePutByte( uint8_t byte )
+{
+	SharedMemory.ArchiveBuffer[ArchiveCount++] = byte ;
+	if ( ArchiveCount >= sizeof(SharedMemory.ArchiveBuffer) )
+	{
+		archiveFlush() ;
+	}
+}
+
+static void archivePut( uint8_t *data, uint32_t size )
+{
+	while ( size-- )
+	{
+		archivePutByte( *data++ ) ;
+	}
+}
+
+// Returns the next byte, or 0x100 at end of file or error
+static uint32_t archiveGetByte()
+{
+	UINT nread ;
+
+	if ( ArchiveIndex >= ArchiveCount )
+	{
+		ArchiveIndex = 0 ;
+		ArchiveCount = 0 ;
+		if ( ArchiveResult == FR_OK )
+		{
+			ArchiveResult = f_read( &SharedMemory.g_eebackupFile, SharedMemory.ArchiveBuffer, sizeof(SharedMemory.ArchiveBuffer), &nread ) ;
+			ArchiveCount = nread ;
+			wdt_reset() ;
+		}
+		if ( ArchiveCount == 0 )
+		{
+			return 0x100 ;
+		}
+	}
+	return SharedMemory.ArchiveBuffer[ArchiveIndex++] ;
+}
+
+static uint16_t archiveCheck( uint8_t *data, uint32_t size )
+{
+	uint32_t sum1 = 0 ;
+	uint32_t sum2 = 0 ;
+
+	while ( size-- )
+	{
+		sum1 = ( sum1 + *data++ ) % 255 ;
+		sum2 = ( sum2 + sum1 ) % 255 ;
+	}
+	return ( sum2 << 8 ) | sum1 ;
+}
+
+// RLE pack data, returns the packed size, output only if write is set
+static uint32_t archivePack( uint8_t *data, uint32_t size, uint32_t write )
+{
+	uint32_t i = 0 ;
+	uint32_t literals = 0 ;
+	uint32_t total = 0 ;
+	uint32_t run ;
+
+	while ( i <= size )
+	{
+		run = 0 ;
+		if ( i < size )
+		{
+			run = 1 ;
+			while ( ( i + run < size ) && ( data[i+run] == data[i] ) && ( run < 130 ) )
+			{
+				run += 1 ;
+			}
+		}
+		if ( literals && ( ( run >= 3 ) || ( literals == 128 ) || ( i == size ) ) )
+		{
+			total += literals + 1 ;
+			if ( write )
+			{
+				archivePutByte( literals - 1 ) ;
+				archivePut( &data[i-literals], literals ) ;
+			}
+			literals = 0 ;
+		}
+		if ( i == size )
+		{
+			break ;
+		}
+		if ( run >= 3 )
+		{
+			total += 2 ;
+			if ( write )
+			{
+				archivePutByte( 0x80 + run - 3 ) ;
+				archivePutByte( data[i] ) ;
+			}
+			i += run ;
+		}
+		else
+		{
+			literals += 1 ;
+			i += 1 ;
+		}
+	}
+	return total ;
+}
+
+// Read size bytes, unpacking if required, returns 0 on error
+static uint32_t archiveUnpack( uint8_t *dest, uint32_t size, uint32_t imageSize, uint32_t flags )
+{
+	uint32_t i = 0 ;
+	uint32_t c ;
+	uint32_t count ;
+	uint32_t value ;
+
+	while ( size )
+	{
+		if ( ( c = archiveGetByte() ) > 0xFF )
+		{
+			return 0 ;
+		}
+		size -= 1 ;
+		if ( ( flags & MODEL_ARCHIVE_RLE ) == 0 )
+		{
+			count = 1 ;
+			value = c ;
+		}
+		else if ( c >= 0x80 )
+		{
+			count = c - 0x80 + 3 ;
+			if ( ( size == 0 ) || ( ( value = archiveGetByte() ) > 0xFF ) )
+			{
+				return 0 ;
+			}
+			size -= 1 ;
+		}
+		else
+		{
+			count = c + 1 ;
+			if ( count > size )
+			{
+				return 0 ;
+			}
+			size -= count ;
+			value = 0x100 ;		// Literals
+		}
+		if ( i + count > imageSize )
+		{
+			return 0 ;
+		}
+		while ( count-- )
+		{
+			dest[i++] = ( value == 0x100 ) ? archiveGetByte() : value ;
+		}
+	}
+	return i == imageSize ;
+}
+
+// Read model into Eeprom_buffer, returns the size
+static uint32_t archiveLoadModel( uint32_t modelIndex )
+{
+	uint32_t size ;
+
+	size = File_system[modelIndex].size ;
+	if ( size > sizeof(g_model) )
+	{
+		size = sizeof(g_model) ;
+	}
+	memset(( uint8_t *)&Eeprom_buffer.data.sky_model_data, 0, sizeof(g_model));
+  ee32ReadBlockData( File_system[modelIndex].block_no, File_system[modelIndex].size, ( uint8_t *)&Eeprom_buffer.data.sky_model_data, size ) ;
+	return size ;
+}
+
+// Write all the models to one file in /EEPROM
+const char *ee32BackupAllModels()
+{
+	struct t_model_archive_header header ;
+	struct t_model_archive_entry entry ;
+	uint16_t sizes[MAX_MODELS] ;
+	uint16_t checks[MAX_MODELS] ;
+	uint8_t flags[MAX_MODELS] ;
+	uint32_t offset ;
+	uint32_t size ;
+	uint32_t i ;
+  DIR folder ;
+	FRESULT result ;
+  char filename[34] ; // /EEPROM/models-2013-01-01.mbk
+
+	waitForEepromFinished() ;
+	Ee32_shadow_model = 0 ;
+
+	// Sizes and checks for the index
+	for ( i = 0 ; i < MAX_MODELS ; i += 1 )
+	{
+		WatchdogTimeout = 300 ;		// 3 seconds
+		sizes[i] = 0 ;
+		if ( File_system[i+1].size > sizeof(g_model.name) )
+		{
+			size = archiveLoadModel( i + 1 ) ;
+			checks[i] = archiveCheck( (uint8_t *)&Eeprom_buffer.data.sky_model_data, size ) ;
+			sizes[i] = archivePack( (uint8_t *)&Eeprom_buffer.data.sky_model_data, size, 0 ) ;
+			flags[i] = MODEL_ARCHIVE_RLE ;
+			if ( sizes[i] >= size )
+			{
+				sizes[i] = size ;
+				flags[i] = 0 ;
+			}
+		}
+	}
+
+  cpystr( (uint8_t *)filename, (uint8_t *)EEPROM_PATH ) ;
+  result = f_opendir( &folder, filename) ;
+  if (result != FR_OK)
+	{
+    if (result == FR_NO_PATH)
+      result = f_mkdir(filename) ;
+    if (result != FR_OK)
+      return "SDCARD ERROR" ;
+  }
+  cpystr( (uint8_t *)&filename[7], (uint8_t *)"/models" ) ;
+	setFilenameDateTime( &filename[14], 0 ) ;
+  cpystr((uint8_t *)&filename[14+11], (uint8_t *)".mbk" ) ;
+
+  result = f_open( &SharedMemory.g_eebackupFile, filename, FA_OPEN_ALWAYS | FA_CREATE_ALWAYS | FA_WRITE) ;
+  if (result != FR_OK)
+	{
+   	return "CREATE ERROR" ;
+  }
+	ArchiveCount = 0 ;
+	ArchiveResult = FR_OK ;
+
+	memcpy( header.id, "MBK1", 4 ) ;
+	header.version = MDSKYVERS ;
+	header.count = MAX_MODELS ;
+	header.modelSize = sizeof(g_model) ;
+	archivePut( (uint8_t *)&header, sizeof(header) ) ;
+
+	offset = sizeof(header) + MAX_MODELS * sizeof(entry) ;
+	for ( i = 0 ; i < MAX_MODELS ; i += 1 )
+	{
+		memset( &entry, 0, sizeof(entry) ) ;
+		if ( sizes[i] )
+		{
+			entry.offset = offset ;
+			entry.size = sizes[i] ;
+			entry.imageSize = File_system[i+1].size > sizeof(g_model) ? sizeof(g_model) : File_system[i+1].size ;
+			entry.check = checks[i] ;
+			entry.flags = flags[i] ;
+			memcpy( entry.name, ModelNames[i+1], sizeof(entry.name) ) ;
+			offset += sizes[i] ;
+		}
+		archivePut( (uint8_t *)&entry, sizeof(entry) ) ;
+	}
+
+	for ( i = 0 ; i < MAX_MODELS ; i += 1 )
+	{
+		WatchdogTimeout = 300 ;		// 3 seconds
+		if ( sizes[i] )
+		{
+			size = archiveLoadModel( i + 1 ) ;
+			if ( flags[i] & MODEL_ARCHIVE_RLE )
+			{
+				archivePack( (uint8_t *)&Eeprom_buffer.data.sky_model_data, size, 1 ) ;
+			}
+			else
+			{
+				archivePut( (uint8_t *)&Eeprom_buffer.data.sky_model_data, size ) ;
+			}
+		}
+	}
+	archiveFlush() ;
+	result = ArchiveResult ;
+	f_close( &SharedMemory.g_eebackupFile ) ;
+  if ( result != FR_OK )
+	{
+    return "WRITE ERROR" ;
+  }
+  return "MODELS SAVED" ;
+}
+
+// Read the index entry for model i, then its data to Eeprom_buffer
+static const char *archiveReadModel( uint32_t i, struct t_model_archive_entry *entry )
+{
+	UINT nread ;
+
+	ArchiveCount = 0 ;
+	ArchiveIndex = 0 ;
+	ArchiveResult = f_lseek( &SharedMemory.g_eebackupFile, sizeof(struct t_model_archive_header) + i * sizeof(*entry) ) ;
+	if ( ArchiveResult == FR_OK )
+	{
+		ArchiveResult = f_read( &SharedMemory.g_eebackupFile, (BYTE *)entry, sizeof(*entry), &nread ) ;
+		if ( nread != sizeof(*entry) )
+		{
+			return "BAD FILE" ;
+		}
+	}
+	if ( ArchiveResult != FR_OK )
+	{
+		return "READ ERROR" ;
+	}
+	if ( entry->offset == 0 )
+	{
+		return NULL ;
+	}
+	if ( entry->imageSize > sizeof(g_model) )
+	{
+		return "BAD FILE" ;
+	}
+	ArchiveResult = f_lseek( &SharedMemory.g_eebackupFile, entry->offset ) ;
+	memset(( uint8_t *)&Eeprom_buffer.data.sky_model_data, 0, sizeof(g_model));
+	if ( archiveUnpack( (uint8_t *)&Eeprom_buffer.data.sky_model_data, entry->size, entry->imageSize, entry->flags ) == 0 )
+	{
+		return ( ArchiveResult != FR_OK ) ? "READ ERROR" : "BAD FILE" ;
+	}
+	if ( archiveCheck( (uint8_t *)&Eeprom_buffer.data.sky_model_data, entry->imageSize ) != entry->check )
+	{
+		return "BAD FILE" ;
+	}
+	return NULL ;
+}
+
+// Replace all the models with those in an archive file
+const char *ee32RestoreAllModels( char *filename )
+{
+	struct t_model_archive_header header ;
+	struct t_model_archive_entry entry ;
+	const char *error ;
+	uint32_t pass ;
+	uint32_t i ;
+	UINT nread ;
+	FRESULT result ;
+
+	waitForEepromFinished() ;
+	Ee32_shadow_model = 0 ;
+
+	result = f_open( &SharedMemory.g_eebackupFile, (TCHAR *)filename, FA_READ) ;
+  if (result != FR_OK)
+	{
+   	return "OPEN ERROR" ;
+  }
+	result = f_read( &SharedMemory.g_eebackupFile, (BYTE *)&header, sizeof(header), &nread ) ;
+	if ( ( result != FR_OK ) || ( nread != sizeof(header) ) || memcmp( header.id, "MBK1", 4 )
+			 || ( header.count > MAX_MODELS ) || ( header.modelSize != sizeof(g_model) ) )
+	{
+		f_close( &SharedMemory.g_eebackupFile ) ;
+		return "BAD FILE" ;
+	}
+
+	// Check every model before changing any
+	for ( pass = 0 ; pass < 2 ; pass += 1 )
+	{
+		for ( i = 0 ; i < MAX_MODELS ; i += 1 )
+		{
+			WatchdogTimeout = 300 ;		// 3 seconds
+			entry.offset = 0 ;
+			if ( i < header.count )
+			{
+				if ( ( error = archiveReadModel( i, &entry ) ) )
+				{
+					f_close( &SharedMemory.g_eebackupFile ) ;
+					return error ;
+				}
+			}
+			if ( pass == 0 )
+			{
+				continue ;
+			}
+			if ( entry.offset )
+			{
+			  Eeprom32_source_address = (uint8_t *)&Eeprom_buffer.data.sky_model_data ;		// Get data from here
+			  Eeprom32_data_size = entry.imageSize ;																		// This much
+			  Eeprom32_file_index = i + 1 ;																							// This file system entry
+			  Eeprom32_process_state = E32_BLANKCHECK ;
+			  ee32WaitFinished() ;
+			}
+			else if ( File_system[i+1].size )
+			{
+				ee32_delete_model( i ) ;
+			}
+		}
+	}
+	f_close( &SharedMemory.g_eebackupFile ) ;
+  return "MODELS RESTORED" ;
+}
+
 uint16_t AmountEeBackedUp ;
 //FIL g_eebackupFile = {0};
 
@@ -1770,6 +2915,7 @@ const char *processBackupEeprom( uint16_t blockNo )
 	{
 		return "Sync Error" ;
 	}
+	Ee32_shadow_model = 0 ;
   read32_eeprom_data( (blockNo << 11), ( uint8_t *)&Eeprom_buffer.data.buffer2K, 2048, 0 ) ;
 	result = f_write( &SharedMemory.g_eebackupFile, ( BYTE *)&Eeprom_buffer.data.buffer2K, 2048, &written ) ;
 	wdt_reset() ;
@@ -1790,7 +2936,18 @@ const char *processRestoreEeprom( uint16_t blockNo )
 	{
 		return "Sync Error" ;
 	}
+	Ee32_shadow_model = 0 ;
+#ifndef SMALL
+	Ee32_shadow_general = 0 ;
+	ModelPrefetch.index = 0 ;			// Blocks rewritten under the file system
+	ModelPrefetch.state = PREFETCH_IDLE ;
+#endif
 	result = f_read( &SharedMemory.g_eebackupFile, ( BYTE *)&Eeprom_buffer.data.buffer2K, 2048, &nread ) ;
+	if ( ( blockNo >> 1 ) == DIR_BLOCK || ( blockNo >> 1 ) == DIR_BLOCK + 1 )
+	{
+		// The directory may not match the files, it is rebuilt after the restore
+		memset( ( uint8_t *)&Eeprom_buffer.data.buffer2K, 0xFF, 2048 ) ;
+	}
 	CoTickDelay(1) ;					// 2mS
 // Write eeprom here
 	write32_eeprom_2K( (uint32_t)blockNo << 11, Eeprom_buffer.data.buffer2K ) ;
@@ -30,6 +30,14 @@ extern void ee32StoreModel( uint8_t modelNumber, uint8_t trim ) ;
 extern bool ee32LoadGeneral( void ) ;
 extern void ee32LoadModel(uint8_t id) ;
 extern void ee32WaitLoadModel(uint8_t id) ;
+#ifndef SMALL
+extern void ee32PrefetchModel( uint8_t id ) ;
+#endif
+#define EE32_BLOCKS			( ( MAX_MODELS + 1 ) * 2 + 2 )		// File pairs then the directory pair
+#define EE32_ENDURANCE	100000		// Erase cycles of a block, from the flash data sheet
+extern uint32_t ee32BlockErases( uint32_t block ) ;
+extern uint32_t ee32WearHours( uint32_t *pblock ) ;
+extern uint16_t Ee32_block_erases[] ;
 extern void ee32_delete_model( uint8_t id ) ;
 extern bool eeModelExists(uint8_t id) ;
 extern void ee32_process( void ) ;
@@ -47,15 +55,45 @@ extern void closeBackupEeprom( void ) ;
 extern const char *openRestoreEeprom( char *filename ) ;
 extern const char *processRestoreEeprom( uint16_t blockNo ) ;
 
+extern const char *ee32BackupAllModels( void ) ;
+extern const char *ee32RestoreAllModels( char *filename ) ;
+
 extern void setFilenameDateTime( char *filename, uint32_t includeTime ) ;
 extern uint32_t loadModelImage( void ) ;
 
+// Model archive, all models in one file
+// A t_model_archive_header, then an index of count t_model_archive_entry,
+// then the model images in index order, each stored as is or RLE packed.
+// RLE: a control byte c < 0x80 is followed by c+1 literal bytes,
+// c >= 0x80 is followed by one byte to be repeated c-0x80+3 times.
+#define MODEL_ARCHIVE_RLE		0x01
+
+struct t_model_archive_header
+{
+	uint8_t id[4] ;				// "MBK1"
+	uint8_t version ;			// MDSKYVERS
+	uint8_t count ;				// Entries in index
+	uint16_t modelSize ;	// sizeof(SKYModelData)
+} ;
+
+struct t_model_archive_entry
+{
+	uint32_t offset ;			// From start of file, 0 no model
+	uint16_t size ;				// Bytes in file
+	uint16_t imageSize ;	// Bytes when unpacked
+	uint16_t check ;			// Fletcher 16 of unpacked image
+	uint8_t flags ;
+	uint8_t spare ;
+	uint8_t name[10] ;
+} ;
+
 struct t_file_entry
 {
 	uint32_t block_no ;
 	uint32_t sequence_no ;
 	uint16_t size ;
 	uint8_t flags ;
+	uint16_t journal ;		// Offset in block for next journal record, 0 none
 } ;
 
 extern struct t_file_entry File_system[] ;
@@ -384,7 +384,7 @@ void store_indexed_hub_data( uint8_t index, uint16_t value )
 }
 
 
-const uint8_t DestIndex[] = { FR_BASEMODE, FR_CURRENT, FR_AMP_MAH, FR_VOLTS, FR_FUEL, FR_RBOX_STATE, FR_CUST1, 
+const uint8_t DestIndex[NUM_SCALER_DESTS] = { FR_BASEMODE, FR_CURRENT, FR_AMP_MAH, FR_VOLTS, FR_FUEL, FR_RBOX_STATE, FR_CUST1, 
 FR_CUST2, FR_CUST3, FR_CUST4, FR_CUST5, FR_CUST6, FR_AIRSPEED	 } ;
 
 void store_telemetry_scaler( uint8_t index, int16_t value )
@@ -1594,11 +1594,7 @@ static void postSportToScript( uint8_t *packet )
 {
 	if ( fifo128Space( &Script_fifo ) >= 8 )
 	{
-		uint32_t i ;
-		for ( i = 0 ; i < 8 ; i += 1 )
-		{
-			put_fifo128( &Script_fifo, *packet++ ) ;
-		}
+		write_fifo128( &Script_fifo, packet, 8 ) ;
 	}
 }
 #endif
@@ -3366,6 +3362,7 @@ void resetTelemetry( uint32_t item )
 
 			maxMinPtr->hubMax[FR_GPS_SPEED] = 0 ;
 			maxMinPtr->hubMax[TELEM_GPS_ALT] = 0 ;
+			gpsClearHome() ;
 		}
 		break ;
 
@@ -3378,6 +3375,7 @@ void resetTelemetry( uint32_t item )
   		memset( &FrskyHubMaxMin, 0, sizeof(FrskyHubMaxMin));
 			FrskyHubMaxMin.hubMax[FR_ALT_BARO] = 0 ;
 			PixHawkCapacity = 0 ;
+			gpsClearHome() ;
 		break ;
 	}
 
@@ -4158,7 +4156,14 @@ bool getCrossfireTelemetryValue(uint8_t index, uint32_t &value)
   return result ;
 }
 
-uint32_t crossfireGpsConvert( uint32_t value )
+// GPS position handling, in fixed point throughout. Positions are held in
+// 1e-7 degrees, as MAVLink and Crossfire send them.
+struct t_gpsData GpsData ;
+
+extern uint16_t isqrt32( uint32_t n ) ;
+
+// 1e-7 degrees to the hub format, ddmm in the top 16 bits, .mmmm in the bottom 16
+static uint32_t gpsDegreesToHub( uint32_t value )
 {
 	uint16_t degrees ;
 	uint16_t minutes ;
@@ -4174,6 +4179,152 @@ uint32_t crossfireGpsConvert( uint32_t value )
 	return result | value ;
 }
 
+// cos() of a latitude in 1e-7 degrees, 16384 = 1.0
+static uint16_t gpsCos( int32_t lat )
+{
+	int32_t x ;
+	int32_t x2 ;
+	int32_t term ;
+	int32_t result ;
+
+	if ( lat < 0 )
+	{
+		lat = -lat ;
+	}
+	x = (uint32_t)( lat / 10000 ) * 28596 / 100000 ;		// Radians, 2.14 fixed point
+	x2 = ( x * x ) >> 14 ;
+	// 1 - x^2/2! + x^4/4! - x^6/6! + x^8/8!
+	term = x2 / 2 ;
+	result = 16384 - term ;
+	term = ( ( term * x2 ) >> 14 ) / 12 ;
+	result += term ;
+	term = ( ( term * x2 ) >> 14 ) / 30 ;
+	result -= term ;
+	term = ( ( term * x2 ) >> 14 ) / 56 ;
+	result += term ;
+	return ( result < 0 ) ? 0 : result ;
+}
+
+// Length of (dx,dy), scaled down first so the squares fit in 32 bits
+static uint32_t gpsHypot( uint32_t dx, uint32_t dy )
+{
+	uint32_t shift = 0 ;
+	while ( ( dx | dy ) >= 32768 )
+	{
+		dx >>= 1 ;
+		dy >>= 1 ;
+		shift += 1 ;
+	}
+	return (uint32_t)isqrt32( dx * dx + dy * dy ) << shift ;
+}
+
+// Direction of (dx east, dy north) in degrees from north, 0 to 359
+static uint16_t gpsBearing( int32_t dx, int32_t dy )
+{
+	uint32_t ax = ( dx < 0 ) ? -dx : dx ;
+	uint32_t ay = ( dy < 0 ) ? -dy : dy ;
+	uint32_t z ;
+	uint32_t angle ;
+
+	if ( ( ax | ay ) == 0 )
+	{
+		return 0 ;
+	}
+	while ( ( ax | ay ) >= 32768 )
+	{
+		ax >>= 1 ;
+		ay >>= 1 ;
+	}
+	// atan(z) = 45z + 15.64z(1-z) degrees for z 0 to 1, in 1/100 degree
+	z = ( ay >= ax ) ? ( ax << 15 ) / ay : ( ay << 15 ) / ax ;
+	angle = ( 4500 * z + ( ( 1564 * z ) >> 15 ) * ( 32768 - z ) ) >> 15 ;
+	if ( ax > ay )
+	{
+		angle = 9000 - angle ;
+	}
+	if ( dy < 0 )
+	{
+		angle = 18000 - angle ;
+	}
+	if ( dx < 0 )
+	{
+		angle = 36000 - angle ;
+	}
+	angle = ( angle + 50 ) / 100 ;
+	return ( angle >= 360 ) ? angle - 360 : angle ;
+}
+
+void gpsClearHome()
+{
+	GpsData.homeSet = 0 ;
+}
+
+// Store a position, and with a fix work out the distance and direction
+// to home. Home is the first fix after a GPS reset, and its cos() is kept
+// so each update is just a few multiplies.
+void gpsStorePosition( int32_t lat, int32_t lon, uint32_t fix )
+{
+	uint32_t value ;
+	uint8_t code ;
+	int32_t dx ;
+	int32_t dy ;
+
+	code = 'N' ;
+	value = lat ;
+	if ( lat < 0 )
+	{
+		code = 'S' ;
+		value = -lat ;
+	}
+	value = gpsDegreesToHub( value ) ;
+	storeTelemetryData( FR_GPS_LAT, value >> 16 ) ;
+	storeTelemetryData( FR_GPS_LATd, value ) ;
+	storeTelemetryData( FR_LAT_N_S, code ) ;
+
+	code = 'E' ;
+	value = lon ;
+	if ( lon < 0 )
+	{
+		code = 'W' ;
+		value = -lon ;
+	}
+	value = gpsDegreesToHub( value ) ;
+	storeTelemetryData( FR_GPS_LONG, value >> 16 ) ;
+	storeTelemetryData( FR_GPS_LONGd, value ) ;
+	storeTelemetryData( FR_LONG_E_W, code ) ;
+
+	GpsData.lat = lat ;
+	GpsData.lon = lon ;
+	if ( fix == 0 )
+	{
+		return ;
+	}
+	if ( GpsData.homeSet == 0 )
+	{
+		GpsData.homeLat = lat ;
+		GpsData.homeLon = lon ;
+		GpsData.homeCos = gpsCos( lat ) ;
+		GpsData.homeSet = 1 ;
+	}
+	// Differences in 1e-6 degrees so they fit, then to decimetres,
+	// 1e-6 degrees of latitude is 0.111195m (72873/65536 dm)
+	dy = lat / 10 - GpsData.homeLat / 10 ;
+	dx = lon / 10 - GpsData.homeLon / 10 ;
+	if ( dx > 180000000 )
+	{
+		dx -= 360000000 ;
+	}
+	else if ( dx < -180000000 )
+	{
+		dx += 360000000 ;
+	}
+	dy = ( (int64_t)dy * 72873 ) >> 16 ;
+	dx = ( (int64_t)dx * 72873 * GpsData.homeCos ) >> 30 ;
+	GpsData.distance = gpsHypot( ( dx < 0 ) ? -dx : dx, ( dy < 0 ) ? -dy : dy ) / 10 ;
+	GpsData.bearing = gpsBearing( -dx, -dy ) ;
+	storeTelemetryData( FR_HOME_DIST, ( GpsData.distance > 32767 ) ? 32767 : GpsData.distance ) ;
+}
+
 void processCrossfireTelemetryFrame()
 {
 //	XFDebug1 += 1 ;
@@ -4189,38 +4340,15 @@ void processCrossfireTelemetryFrame()
 	{
     case CRSF_GPS_ID:
       frskyUsrStreaming = FRSKY_USR_TIMEOUT10ms ; // reset counter only if valid frsky packets are being detected
-      if (getCrossfireTelemetryValue<4>(3, value))
 			{
-				uint8_t code = 'N' ;
-				int32_t ivalue = value ;
-				if ( ivalue < 0 )
+				uint32_t lat ;
+				uint32_t lon ;
+				if ( getCrossfireTelemetryValue<4>(3, lat) && getCrossfireTelemetryValue<4>(7, lon) )
 				{
-					code = 'S' ;
-					ivalue = -ivalue ;
+					getCrossfireTelemetryValue<1>(17, value) ;		// Satellites
+					gpsStorePosition( lat, lon, value >= 4 ) ;
 				}
-				value = ivalue ;
-//        processCrossfireTelemetryValue(GPS_LATITUDE_INDEX, value/10);
-				value = crossfireGpsConvert( value ) ;
-				storeTelemetryData( FR_GPS_LAT, value >> 16 ) ;
-				storeTelemetryData( FR_GPS_LATd, value ) ;
-				storeTelemetryData( FR_LAT_N_S, code ) ;
 			}
-      if (getCrossfireTelemetryValue<4>(7, value))
-			{
-				uint8_t code = 'E' ;
-				int32_t ivalue = value ;
-				if ( ivalue < 0 )
-				{
-					code = 'W' ;
-					ivalue = -ivalue ;
-				}
-				value = ivalue ;
-//        processCrossfireTelemetryValue(GPS_LONGITUDE_INDEX, value/10);
-				value = crossfireGpsConvert( value ) ;
-				storeTelemetryData( FR_GPS_LONG, value >> 16 ) ;
-				storeTelemetryData( FR_GPS_LONGd, value ) ;
-				storeTelemetryData( FR_LONG_E_W, code ) ;
-			}	
 //      if (getCrossfireTelemetryValue<2>(11, value))
 //        processCrossfireTelemetryValue(GPS_GROUND_SPEED_INDEX, value);
       if (getCrossfireTelemetryValue<2>(13, value))
@@ -4329,11 +4457,7 @@ void processCrossfireTelemetryFrame()
 
 			if ( fifo128Space( &Script_fifo ) >= len )
 			{
-				uint32_t i ;
-				for ( i = 0 ; i < len ; i += 1 )
-				{
-					put_fifo128( &Script_fifo, *packet++ ) ;
-				}
+				write_fifo128( &Script_fifo, packet, len ) ;
 			}
 		}
     break;
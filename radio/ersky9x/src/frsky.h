@@ -577,6 +577,25 @@ extern struct t_hub_max_min FrskyHubMaxMin ;
 extern uint16_t A1A2toScaledValue( uint8_t channel, uint8_t *dplaces ) ;
 extern uint16_t logAxScale( uint8_t channel, uint8_t *dps ) ;
 extern void store_telemetry_scaler( uint8_t index, int16_t value ) ;
+#define NUM_SCALER_DESTS	13
+extern const uint8_t DestIndex[NUM_SCALER_DESTS] ;
+
+// GPS position from MAVLink and Crossfire, in 1e-7 degrees
+struct t_gpsData
+{
+	int32_t lat ;
+	int32_t lon ;
+	int32_t homeLat ;
+	int32_t homeLon ;
+	uint16_t homeCos ;		// cos(homeLat), 16384 = 1.0
+	uint16_t bearing ;		// Degrees from north, model to home
+	uint32_t distance ;		// Metres from home
+	uint8_t homeSet ;
+} ;
+
+extern struct t_gpsData GpsData ;
+extern void gpsStorePosition( int32_t lat, int32_t lon, uint32_t fix ) ;
+extern void gpsClearHome( void ) ;
 
 // Crossfire telemetry
 #define XFIRE_BAUD_RATE 400000
@@ -83,6 +83,7 @@ uint8_t *cpystr( uint8_t *dest, uint8_t *source )
 #include "ff.h"
 #include "sound.h"
 #include "frsky.h"
+#include "pulses.h"
 
 #define MKEY_RIGHT  KEY_RIGHT
 #define MKEY_LEFT   KEY_LEFT
@@ -201,6 +202,18 @@ uint8_t *ExtraFileData = (uint8_t *) &VoiceBuffer[0] ;	// Share with voice task
 uint32_t FileSize[8] ;
 
 uint32_t BytesFlashed ;
+uint16_t FlashCrc ;						// Of the data given to program()
+uint32_t FlashCrcSize ;
+uint8_t FlashVerifyFailed ;
+
+static uint16_t updateCrc( uint16_t crc, uint8_t *data, uint32_t size )
+{
+	while ( size-- )
+	{
+		crc = (crc<<8) ^ CRCTable( (crc>>8) ^ *data++ ) ;
+	}
+	return crc ;
+}
 uint32_t ByteEnd ;
 uint32_t BlockOffset ;
 uint16_t MultiPageSize ;
@@ -2376,6 +2389,9 @@ void menuUp1(uint8_t event)
 				BytesFlashed = 0 ;
 				BlockOffset = 0 ;
 				ByteEnd = 1024 ;
+				FlashCrc = 0 ;
+				FlashCrcSize = 0 ;
+				FlashVerifyFailed = 0 ;
 				state = UPDATE_ACTION ;
 			}
 #if defined(PCBX9LITE)
@@ -2415,25 +2431,24 @@ void menuUp1(uint8_t event)
 #else
 				width = ByteEnd >> 9 ;
 #endif
-				if ( BytesFlashed < ByteEnd )
+				// All of the buffer is flashed, and the next one read, in one pass
+				while ( BytesFlashed < ByteEnd )
 				{
-					program( (uint32_t *)firmwareAddress, &((uint32_t *)FileData)[BlockOffset] ) ;	// size is 256 bytes
+					uint32_t size = 256 ;
 #ifdef PCBSKY
 					if ( ChipId & 0x0080 )
 					{
-						BlockOffset += 128 ;		// 32-bit words (256 bytes)
-						firmwareAddress += 512 ;
-						BytesFlashed += 512;
+						size = 512 ;
 					}
-					else
 #endif
-					{
-						BlockOffset += 64 ;		// 32-bit words (256 bytes)
-						firmwareAddress += 256 ;
-						BytesFlashed += 256 ;
-					}	 
+					program( (uint32_t *)firmwareAddress, &((uint32_t *)FileData)[BlockOffset] ) ;	// size is 256 bytes
+					FlashCrc = updateCrc( FlashCrc, (uint8_t *)&((uint32_t *)FileData)[BlockOffset], size ) ;
+					FlashCrcSize += size ;
+					BlockOffset += size / 4 ;		// 32-bit words
+					firmwareAddress += size ;
+					BytesFlashed += size ;
+					wdt_reset() ;
 				}
-				else
 				{
 #if defined(PCBX12D) || defined(PCBX10)
 					if ( ByteEnd >= 32768 * 4 )
@@ -2445,6 +2460,8 @@ void menuUp1(uint8_t event)
 #endif
 #endif
 					{
+						// Check what is now in the flash against the file
+						FlashVerifyFailed = updateCrc( 0, (uint8_t *)( firmwareAddress - BytesFlashed ), FlashCrcSize ) != FlashCrc ;
 						state = UPDATE_COMPLETE ;
 					}
 					else
@@ -2627,6 +2644,10 @@ void menuUp1(uint8_t event)
 		
 		case UPDATE_COMPLETE :
 			lcd_puts_Pleft( 3*FH, "Flashing Complete" ) ;
+			if ( FlashVerifyFailed && (mdata->UpdateItem == UPDATE_TYPE_BOOTLOADER ) )
+			{
+				lcd_puts_Pleft( 5*FH, "VERIFY FAILED" ) ;
+			}
  			if ( (mdata->UpdateItem != UPDATE_TYPE_BOOTLOADER ) )
  			{
 #if defined(PCBX9D) || defined(PCB9XT)
@@ -3580,18 +3601,43 @@ uint32_t hexFileNextByte()
 	return ExtraFileData[SharedMemory.Mdata.HexFileIndex++] ;
 }
 
-uint32_t fromHex( uint32_t data )
+// Values of the characters '0' to 'f' as hex digits, 0xFF if not a digit
+static const uint8_t HexDigitValues[] =
 {
-	if ( data > 0x60 )
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,																			// '0' - '9'
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,													// ':' - '@'
+	10, 11, 12, 13, 14, 15,																						// 'A' - 'F'
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,	// 'G' - '`'
+	10, 11, 12, 13, 14, 15																						// 'a' - 'f'
+} ;
+
+static inline uint32_t hexDigit( uint32_t data )
+{
+	data -= '0' ;
+	return ( data < sizeof(HexDigitValues) ) ? HexDigitValues[data] : 0xFF ;
+}
+
+// Next two characters as a byte, 0x100 or more if they are not hex digits
+static uint32_t hexFileNextPair()
+{
+	uint32_t index = SharedMemory.Mdata.HexFileIndex ;
+	uint32_t high ;
+	uint32_t low ;
+
+	if ( index + 2 <= SharedMemory.Mdata.XblockCount )
 	{
-		data -= 0x20 ;
+		// Both in the buffer
+		high = hexDigit( ExtraFileData[index] ) ;
+		low = hexDigit( ExtraFileData[index+1] ) ;
+		SharedMemory.Mdata.HexFileIndex = index + 2 ;
 	}
-	data -= '0' ;
-	if ( data > 9 )
+	else
 	{
-		data -= 7 ;
+		high = hexDigit( hexFileNextByte() ) ;
+		low = hexDigit( hexFileNextByte() ) ;
 	}
-	return data ;
+	return ( high << 4 ) | low ;
 }
 
 uint8_t recordSize ;
@@ -3599,99 +3645,77 @@ uint8_t inRecord ;
 uint8_t recordOffset ;
 uint16_t recordAddress ;
 uint8_t recordData[32] ;
+uint8_t HexFileError ;
 
-#define RECORD_START			0
-#define RECORD_LENGTH1	  1
-#define RECORD_LENGTH2	  2
-#define RECORD_ADD1			  3
-#define RECORD_ADD2	  		4
-#define RECORD_ADD3	  		5
-#define RECORD_ADD4	  		6
-#define RECORD_DATA1	  	7
-#define RECORD_DATA2	  	8
-#define RECORD_DONE		  	9
+#define HEX_RECORD_DATA		0
+#define HEX_RECORD_EOF		1
 
+// Read the next data record to recordData. recordSize is 0 at the end of the
+// file, and HexFileError is set if a record is not valid. Extended address
+// and start address records are skipped, the data is taken as contiguous.
 void hexFileReadRecord()
 {
 	uint32_t data ;
-	uint32_t state = RECORD_START ;
-	uint32_t length = 0 ;
-	uint32_t byte = 0 ;
+	uint32_t length ;
+	uint32_t type ;
+	uint32_t sum ;
+	uint32_t check ;
+	uint32_t i ;
+
 	recordOffset = 0 ;
 	recordSize = 0 ;
-
-	while ( state != RECORD_DONE )
+	for (;;)
 	{
-		data = hexFileNextByte() ;
-		if ( data == 0 )
+		do
+		{
+			data = hexFileNextByte() ;
+			if ( data == 0 )
+			{
+				return ;		// End of File
+			}
+		} while ( data != ':' ) ;
+
+		length = hexFileNextPair() ;
+		check = length ;
+		sum = length ;
+		recordAddress = data = hexFileNextPair() ;
+		check |= data ;
+		sum += data ;
+		data = hexFileNextPair() ;
+		recordAddress = ( recordAddress << 8 ) | data ;
+		check |= data ;
+		sum += data ;
+		type = hexFileNextPair() ;
+		check |= type ;
+		sum += type ;
+		if ( ( check > 0xFF ) || ( length > sizeof(recordData) ) )
 		{
-			// End of File
+			HexFileError = 1 ;
 			return ;
 		}
-		else
+		for ( i = 0 ; i < length ; i += 1 )
 		{
-			switch ( state )
-			{
-				case RECORD_START :
-					if ( data == ':' )
-					{
-						state = RECORD_LENGTH1 ;
-					}
-				break ;
-			
-				case RECORD_LENGTH1 :
-					length = fromHex( data ) ;
-					state = RECORD_LENGTH2 ;
-				break ;
-				case RECORD_LENGTH2 :
-					length = (length << 4) + fromHex( data ) ;
-					if ( length == 0 )
-					{
-						return ;
-					}
-//					state = RECORD_ADD1 ;
-//				break ;
-//				case RECORD_ADD1 :
-////					length = (length << 4) + fromHex( data ) ;
-//					state = RECORD_ADD2 ;
-//				break ;
-//				case RECORD_ADD2 :
-////					length = (length << 4) + fromHex( data ) ;
-//					state = RECORD_ADD3 ;
-//				break ;
-//				case RECORD_ADD3 :
-////					length = (length << 4) + fromHex( data ) ;
-//					state = RECORD_ADD4 ;
-//				break ;
-//				case RECORD_ADD4 :
-////					length = (length << 4) + fromHex( data ) ;
-					hexFileNextByte() ;	// skip four characters
-					hexFileNextByte() ;	// address
-					hexFileNextByte() ;	// address
-					hexFileNextByte() ;	// address
-					hexFileNextByte() ;	// skip two characters
-					hexFileNextByte() ;	// (record type)
-					state = RECORD_DATA1 ;
-				break ;
-				case RECORD_DATA1 :
-					byte = fromHex( data ) ;
-					state = RECORD_DATA2 ;
-				break ;
-				case RECORD_DATA2 :
-					byte = (byte << 4) + fromHex( data ) ;
-					recordData[recordSize++] = byte ;
-					length -= 1 ;
-					if ( length == 0 )
-					{
-						return ;
-					}
-					if ( recordSize >= 32 )
-					{
-						return ;
-					}
-					state = RECORD_DATA1 ;
-				break ;
-			}
+			data = hexFileNextPair() ;
+			check |= data ;
+			sum += data ;
+			recordData[i] = data ;
+		}
+		data = hexFileNextPair() ;
+		check |= data ;
+		sum += data ;
+		if ( ( check > 0xFF ) || ( sum & 0xFF ) )
+		{
+			HexFileError = 1 ;
+			return ;
+		}
+		if ( type == HEX_RECORD_EOF )
+		{
+			return ;
+		}
+		if ( ( type == HEX_RECORD_DATA ) && length )
+		{
+			recordSize = length ;
+			return ;
 		}
 	}
 }
@@ -3701,6 +3725,7 @@ void hexFileStart()
 	
 	recordSize = 0 ;
 	inRecord = 0 ;
+	HexFileError = 0 ;
 	SharedMemory.Mdata.HexFileIndex = 0 ;
 	memmove(ExtraFileData, FileData, 1024 ) ;	// Hex data to here
 	SharedMemory.Mdata.XblockCount = 1024 ;
@@ -3760,6 +3785,11 @@ uint32_t multiUpdate()
 				hexFileRead1024( 0, &SharedMemory.Mdata.BlockCount ) ;
 			}
 			MultiState = MULTI_WAIT1 ;
+			if ( HexFileError )
+			{
+				MultiResult = 1 ;		// Don't flash a damaged file
+				MultiState = MULTI_DONE ;
+			}
 		break ;
 
 		case MULTI_WAIT1 :
@@ -3922,6 +3952,12 @@ uint32_t multiUpdate()
 				if ( FileType )	// Hex file
 				{
 					hexFileRead1024( BytesFlashed, &SharedMemory.Mdata.BlockCount ) ;
+					if ( HexFileError )
+					{
+						MultiResult = 1 ;
+						MultiState = MULTI_DONE ;
+						break ;
+					}
 				}
 				else
 				{
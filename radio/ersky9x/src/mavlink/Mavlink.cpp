@@ -113,24 +113,27 @@ static inline void mavlink_msg_request_data_stream_send(mavlink_channel_t chan,
 #endif
 
 
+#define MAVLINK_FRAME_PAYLOAD_LEN	32	///< Largest payload we decode (SYS_STATUS is 31)
+#define MAVLINK_NO_HANDLER				0xFF
+
+// The only receive buffer, the decoder state is kept alongside the payload
 typedef struct __mavlink_message
 {
-	uint16_t checksum; /// sent at end of packet
-	uint8_t magic;   ///< protocol magic marker
+	uint16_t checksum; ///< running X.25 checksum
 	uint8_t len;     ///< Length of payload
-	uint8_t seq;     ///< Sequence of packet
-	uint8_t sysid;   ///< ID of message sender system/aircraft
-	uint8_t compid;  ///< ID of the message sender component
 	uint8_t msgid;   ///< ID of message in payload
-	uint64_t payload64[(MAVLINK_MAX_PAYLOAD_LEN+MAVLINK_NUM_CHECKSUM_BYTES+7)/8];
+	uint8_t packet_idx ;	///< Index in payload
+	uint8_t parse_state ;	///< mavlink_parse_state_t
+	uint8_t handler ;	///< Index in MavlinkHandlers, or MAVLINK_NO_HANDLER
+	uint8_t crcExtra ;	///< CRC_EXTRA seed for msgid
+	uint64_t payload64[(MAVLINK_FRAME_PAYLOAD_LEN+7)/8];
 } mavlink_message_t ;
 
 typedef enum {
-    MAVLINK_PARSE_STATE_UNINIT=0,
-    MAVLINK_PARSE_STATE_IDLE,
+    MAVLINK_PARSE_STATE_IDLE=0,
     MAVLINK_PARSE_STATE_GOT_STX,
-    MAVLINK_PARSE_STATE_GOT_SEQ,
     MAVLINK_PARSE_STATE_GOT_LENGTH,
+    MAVLINK_PARSE_STATE_GOT_SEQ,
     MAVLINK_PARSE_STATE_GOT_SYSID,
     MAVLINK_PARSE_STATE_GOT_COMPID,
     MAVLINK_PARSE_STATE_GOT_MSGID,
@@ -138,19 +141,6 @@ typedef enum {
     MAVLINK_PARSE_STATE_GOT_CRC1
 } mavlink_parse_state_t; ///< The state machine for the comm parser
 
-typedef struct __mavlink_status
-{
-    uint8_t msg_received;               ///< Number of received messages
-    uint8_t buffer_overrun;             ///< Number of buffer overruns
-    uint8_t parse_error;                ///< Number of parse errors
-    mavlink_parse_state_t parse_state;  ///< Parsing state machine
-    uint8_t packet_idx;                 ///< Index in current packet
-    uint8_t current_rx_seq;             ///< Sequence number of last packet received
-    uint8_t current_tx_seq;             ///< Sequence number of last packet sent
-    uint16_t packet_rx_success_count;   ///< Received packets
-    uint16_t packet_rx_drop_count;      ///< Number of packet drops
-} mavlink_status_t ;
-
 enum MAV_DATA_STREAM
 {
 	MAV_DATA_STREAM_ALL=0, /* Enable all data streams | */
@@ -165,8 +155,7 @@ enum MAV_DATA_STREAM
 	MAV_DATA_STREAM_ENUM_END=13, /*  | */
 };
 
-mavlink_message_t MavlinkBuffer ;
-mavlink_status_t MavlinkStatus ;
+mavlink_message_t MavlinkFrame ;
 
 //bool Motor_armed ;
 uint8_t HeartCounter ;
@@ -174,6 +163,7 @@ uint8_t HeartCounter ;
 
 extern void storeTelemetryData( uint8_t index, uint16_t value ) ;
 extern void storeRSSI( uint8_t value ) ;
+extern const uint16_t PxxCrcTable[] ;
 
 //extern "C" uint32_t millis( void ) ;
 
@@ -222,12 +212,8 @@ extern void storeRSSI( uint8_t value ) ;
  **/
 static inline void crc_accumulate(uint8_t data, uint16_t *crcAccum)
 {
-	/*Accumulate one byte of data into the CRC*/
-	uint8_t tmp;
-
-	tmp = data ^ (uint8_t)(*crcAccum &0xff);
-	tmp ^= (tmp<<4);
-	*crcAccum = (*crcAccum>>8) ^ (tmp<<8) ^ (tmp <<3) ^ (tmp>>4);
+	// PxxCrcTable is the reflected 0x1021 (0x8408) table, as X.25 uses
+	*crcAccum = (*crcAccum >> 8) ^ PxxCrcTable[(uint8_t)(*crcAccum ^ data)] ;
 }
 
 /**
@@ -572,17 +558,6 @@ const int Mavlink::getDate()
 //   return cell;
 //}
 
-// We receive the GPS coordinates in ddd.dddd format
-// FrSky wants the dd mm.mmm format so convert.
-float gpsDdToDmsFormat(float ddm)
-{
-   int deg = (int)ddm;
-   float min_dec = (ddm - deg) * 60.0f;
-   float sec = (min_dec - (int)min_dec) * 60.0f;
-
-   return (float)deg * 100.0f + (int)min_dec + sec / 100.0f;
-}
-
 //void makeRateRequest()
 //{
 //  const int  maxStreams = 7;
@@ -605,173 +580,7 @@ float gpsDdToDmsFormat(float ddm)
 //  }
 //}
 
-uint8_t mavlink_parse_char( uint8_t c, mavlink_message_t* r_message, mavlink_status_t* r_mavlink_status)
-{
-//	  default message crc function. You can override this per-system to
-//	  put this data in a different memory segment
-
-//#if MAVLINK_CRC_EXTRA
-#ifndef MAVLINK_MESSAGE_CRC
-	static const uint8_t mavlink_message_crcs[256] = MAVLINK_MESSAGE_CRCS ;
-#define MAVLINK_MESSAGE_CRC(msgid) mavlink_message_crcs[msgid]
-#endif
-//#endif
-
-	mavlink_message_t* rxmsg = &MavlinkBuffer ; ///< The currently decoded message
-	mavlink_status_t* status = &MavlinkStatus ; ///< The current decode status
-	int bufferIndex = 0;
-
-	status->msg_received = 0;
-
-	switch (status->parse_state)
-	{
-		case MAVLINK_PARSE_STATE_UNINIT:
-		case MAVLINK_PARSE_STATE_IDLE:
-			if (c == MAVLINK_STX)
-			{
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
-				rxmsg->len = 0;
-				rxmsg->magic = c;
-				mavlink_start_checksum(rxmsg);
-			}
-		break ;
-
-		case MAVLINK_PARSE_STATE_GOT_STX:
-			if (status->msg_received 
-/* Support shorter buffers than the
-   default maximum packet size */
-#if (MAVLINK_MAX_PAYLOAD_LEN < 255)
-				|| c > MAVLINK_MAX_PAYLOAD_LEN
-#endif
-				)
-			{
-				status->buffer_overrun++;
-				status->parse_error++;
-				status->msg_received = 0;
-				status->parse_state = MAVLINK_PARSE_STATE_IDLE;
-			}
-			else
-			{
-				// NOT counting STX, LENGTH, SEQ, SYSID, COMPID, MSGID, CRC1 and CRC2
-				rxmsg->len = c;
-				status->packet_idx = 0;
-				mavlink_update_checksum(rxmsg, c);
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_LENGTH;
-			}
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_LENGTH:
-			rxmsg->seq = c;
-			mavlink_update_checksum(rxmsg, c);
-			status->parse_state = MAVLINK_PARSE_STATE_GOT_SEQ;
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_SEQ:
-			rxmsg->sysid = c;
-			mavlink_update_checksum(rxmsg, c);
-			status->parse_state = MAVLINK_PARSE_STATE_GOT_SYSID;
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_SYSID:
-			rxmsg->compid = c;
-			mavlink_update_checksum(rxmsg, c);
-			status->parse_state = MAVLINK_PARSE_STATE_GOT_COMPID;
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_COMPID:
-			rxmsg->msgid = c;
-			mavlink_update_checksum(rxmsg, c);
-			if (rxmsg->len == 0)
-			{
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD;
-			}
-			else
-			{
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_MSGID;
-			}
-		break;
 
-		case MAVLINK_PARSE_STATE_GOT_MSGID:
-			
-			_MAV_PAYLOAD_NON_CONST(rxmsg)[status->packet_idx++] = (char)c;
-			mavlink_update_checksum(rxmsg, c);
-			if (status->packet_idx == rxmsg->len)
-			{
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD;
-			}
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_PAYLOAD:
-			mavlink_update_checksum(rxmsg, MAVLINK_MESSAGE_CRC(rxmsg->msgid));
-			if (c != (rxmsg->checksum & 0xFF))
-			{
-				status->parse_error++;
-				status->msg_received = 0;
-				status->parse_state = MAVLINK_PARSE_STATE_IDLE;
-				if (c == MAVLINK_STX)
-				{
-					status->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
-					rxmsg->len = 0;
-					mavlink_start_checksum(rxmsg);
-				}
-			}
-			else
-			{
-				status->parse_state = MAVLINK_PARSE_STATE_GOT_CRC1;
-				_MAV_PAYLOAD_NON_CONST(rxmsg)[status->packet_idx] = (char)c;
-			}
-		break;
-
-		case MAVLINK_PARSE_STATE_GOT_CRC1:
-			if (c != (rxmsg->checksum >> 8))
-			{
-				status->parse_error++;
-				status->msg_received = 0;
-				status->parse_state = MAVLINK_PARSE_STATE_IDLE;
-				if (c == MAVLINK_STX)
-				{
-					status->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
-					rxmsg->len = 0;
-					mavlink_start_checksum(rxmsg);
-				}
-			}
-			else
-			{
-				status->msg_received = 1;
-				status->parse_state = MAVLINK_PARSE_STATE_IDLE;
-				_MAV_PAYLOAD_NON_CONST(rxmsg)[status->packet_idx+1] = (char)c;
-				memcpy(r_message, rxmsg, sizeof(mavlink_message_t));
-			}
-		break;
-	}
-
-	bufferIndex++;
-	// If a message has been sucessfully decoded, check index
-	if (status->msg_received == 1)
-	{
-		//while(status->current_seq != rxmsg->seq)
-		//{
-		//	status->packet_rx_drop_count++;
-		//               status->current_seq++;
-		//}
-		status->current_rx_seq = rxmsg->seq;
-		// Initial condition: If no packet has been received so far, drop count is undefined
-		if (status->packet_rx_success_count == 0) status->packet_rx_drop_count = 0;
-		// Count this packet as received
-		status->packet_rx_success_count++;
-	}
-
-	r_mavlink_status->current_rx_seq = status->current_rx_seq+1;
-	r_mavlink_status->packet_rx_success_count = status->packet_rx_success_count;
-	r_mavlink_status->packet_rx_drop_count = status->parse_error;
-	status->parse_error = 0;
-	
-	
-	return status->msg_received;
-}
-
-mavlink_message_t Msg ;
-mavlink_status_t Mstatus ;
 
 static inline uint8_t mavlink_msg_heartbeat_get_type(const mavlink_message_t* msg)
 {
@@ -989,38 +798,25 @@ static inline uint8_t mavlink_msg_rc_channels_raw_get_rssi(const mavlink_message
 
 //extern uint8_t frskyUsrStreaming; // >0 (true) == user data is streaming in. 0 = no user data detected for some time
 
-void mavlinkReceive( uint8_t data )
+static void mavlinkHeartbeat( const mavlink_message_t *msg )
 {
-//  unsigned long sensors_enabled;
-//  unsigned long health;
-
-    //trying to grab msg  
-	if(mavlink_parse_char( data, &Msg, &Mstatus)) 
+	uint16_t value1 ;
+	uint16_t value2 ;
+	if ( HeartCounter < 5 )
 	{
- //		msgCounter += 1 ;
-		frskyUsrStreaming = FRSKY_USR_TIMEOUT10ms ;
-		
-    switch(Msg.msgid)
-		{
-      case MAVLINK_MSG_ID_HEARTBEAT:
-      {
-				uint16_t value1 ;
-				uint16_t value2 ;
-				if ( HeartCounter < 5 )
-				{
-					HeartCounter += 1 ;
-				}
-        
+		HeartCounter += 1 ;
+	}
+
 //				apm_mav_system    = Msg.sysid;
 //        apm_mav_component = Msg.compid;
-        
-				value1 = mavlink_msg_heartbeat_get_type(&Msg) ; // apm_mav_type
-        value2 = (unsigned int)mavlink_msg_heartbeat_get_custom_mode(&Msg) ; // apmMode
-				storeTelemetryData( FR_TEMP1, value2 | ( value1 << 8 ) ) ;
-
-				value1 = mavlink_msg_heartbeat_get_base_mode(&Msg);
-//				apmBaseMode       = mavlink_msg_heartbeat_get_base_mode(&Msg);
-				storeTelemetryData( FR_BASEMODE, value1 ) ;
+
+	value1 = mavlink_msg_heartbeat_get_type(msg) ; // apm_mav_type
+	value2 = (unsigned int)mavlink_msg_heartbeat_get_custom_mode(msg) ; // apmMode
+	storeTelemetryData( FR_TEMP1, value2 | ( value1 << 8 ) ) ;
+
+	value1 = mavlink_msg_heartbeat_get_base_mode(msg);
+//				apmBaseMode       = mavlink_msg_heartbeat_get_base_mode(msg);
+	storeTelemetryData( FR_BASEMODE, value1 ) ;
 //        if (getBit( value1, MOTORS_ARMED))
 //				{
 //          Motor_armed = 1 ;
@@ -1030,33 +826,32 @@ void mavlinkReceive( uint8_t data )
 //          Motor_armed = 0 ;
 //        }
 //        return MAVLINK_MSG_ID_HEARTBEAT;
-      }
-      break ;
-
-			case MAVLINK_MSG_ID_SYS_STATUS:
-      {
-//				float batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(&Msg) / 100.0f) * 0.5238f ;
-				float batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(&Msg) / 100.0f) ;
-				storeTelemetryData( FR_VOLTS, batteryVoltage ) ;
-        
-//				batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(&Msg) / 1000.0f); // Volts, Battery voltage, in millivolts (1 = 1 millivolt)
+}
+
+static void mavlinkSysStatus( const mavlink_message_t *msg )
+{
+//				float batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(msg) / 100.0f) * 0.5238f ;
+	float batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(msg) / 100.0f) ;
+	storeTelemetryData( FR_VOLTS, batteryVoltage ) ;
+
+//				batteryVoltage = (mavlink_msg_sys_status_get_voltage_battery(msg) / 1000.0f); // Volts, Battery voltage, in millivolts (1 = 1 millivolt)
 //        ncell = batteryVoltage / 43f ;
 //        ncell++ ;
-				
+
 //				if (ncell > 5) ncell = 5;
 //        cell = 50 * (batteryVoltage / float(ncell));
 //				if (cell < 1000) cell = 0;
 
-////				current          = mavlink_msg_sys_status_get_current_battery(&Msg) / 10; //0.1A Battery current, in 10*milliamperes (1 = 10 milliampere)         
-				storeTelemetryData( FR_CURRENT, mavlink_msg_sys_status_get_current_battery(&Msg) / 10 ) ;
-////				batteryRemaining = mavlink_msg_sys_status_get_battery_remaining(&Msg); //Remaining battery energy: (0%: 0, 100%: 100)
-				storeTelemetryData( FR_FUEL, mavlink_msg_sys_status_get_battery_remaining(&Msg) ) ;
-        
-//				sensors_enabled  = mavlink_msg_sys_status_get_onboard_control_sensors_enabled(&Msg);
-//        health           = mavlink_msg_sys_status_get_onboard_control_sensors_health(&Msg); // Bitmask showing which onboard controllers and sensors are operational or have an error:  Value of 0: not enabled. Value of 1: enabled. Indices defined by ENUM MAV_SYS_STATUS_SENSOR
-        
-//				cpu_load         = mavlink_msg_sys_status_get_load(&Msg) / 10; // Maximum usage in percent of the mainloop time, (0%: 0, 100%: 1000) should be always below 1000
-				storeTelemetryData( FR_CPU_LOAD, mavlink_msg_sys_status_get_load(&Msg) / 10 ) ;
+////				current          = mavlink_msg_sys_status_get_current_battery(msg) / 10; //0.1A Battery current, in 10*milliamperes (1 = 10 milliampere)         
+	storeTelemetryData( FR_CURRENT, mavlink_msg_sys_status_get_current_battery(msg) / 10 ) ;
+////				batteryRemaining = mavlink_msg_sys_status_get_battery_remaining(msg); //Remaining battery energy: (0%: 0, 100%: 100)
+	storeTelemetryData( FR_FUEL, mavlink_msg_sys_status_get_battery_remaining(msg) ) ;
+
+//				sensors_enabled  = mavlink_msg_sys_status_get_onboard_control_sensors_enabled(msg);
+//        health           = mavlink_msg_sys_status_get_onboard_control_sensors_health(msg); // Bitmask showing which onboard controllers and sensors are operational or have an error:  Value of 0: not enabled. Value of 1: enabled. Indices defined by ENUM MAV_SYS_STATUS_SENSOR
+
+//				cpu_load         = mavlink_msg_sys_status_get_load(msg) / 10; // Maximum usage in percent of the mainloop time, (0%: 0, 100%: 1000) should be always below 1000
+	storeTelemetryData( FR_CPU_LOAD, mavlink_msg_sys_status_get_load(msg) / 10 ) ;
 
 //				sensors_health   = 0; // Default - All sensors status: ok
 //        if ( sensors_enabled & MAV_SYS_STATUS_SENSOR_3D_GYRO )
@@ -1078,87 +873,49 @@ void mavlinkReceive( uint8_t data )
 //        if ( sensors_enabled & MAV_SYS_STATUS_AHRS )
 //        if (!( health & MAV_SYS_STATUS_AHRS ))                              sensors_health |= MAV_SYS_STATUS_AHRS;
 ////        return MAVLINK_MSG_ID_SYS_STATUS ;
-	    }
-  	  break ;
-
-    	case MAVLINK_MSG_ID_GPS_RAW_INT:
-      {
-				uint16_t value1 ;
-				uint16_t value2 ;
-				int32_t gps ;
-  			uint32_t value ;
-				uint32_t temp ;
-		
-				gps = mavlink_msg_gps_raw_int_get_lat(&Msg) ;
-				value = 0 ;
-				if (gps < 0)
-				{
-					value = 1 ;
-					gps = -gps ;
-				}
-				storeTelemetryData( FR_LAT_N_S, ( value & 1 ) ? 'S' : 'N' ) ;
-				value = gps * 6 ;
-				value /= 100 ;
-				value &= 0x3FFFFFFF ;
-				uint16_t bp ;
-				temp = value / 10000 ;
-				bp = (temp/ 60 * 100) + (temp % 60) ;
-				storeTelemetryData( FR_GPS_LAT, bp ) ;
-				storeTelemetryData( FR_GPS_LATd, value % 10000 ) ;
-
-        gps = mavlink_msg_gps_raw_int_get_lon(&Msg);
-				value = 0 ;
-				if (gps < 0)
-				{
-					value = 1 ;
-					gps = - gps ;
-				}
-				storeTelemetryData( FR_LONG_E_W, ( value & 1 ) ? 'W' : 'E' ) ;
-				value = gps * 6 ;
-				value /= 100 ;
-				value &= 0x3FFFFFFF ;
-				temp = value / 10000 ;
-				bp = (temp/ 60 * 100) + (temp % 60) ;
-				storeTelemetryData( FR_GPS_LONG, bp ) ;
-				storeTelemetryData( FR_GPS_LONGd, value % 10000 ) ;
-
-        value2 = mavlink_msg_gps_raw_int_get_fix_type(&Msg);
-        value1 = mavlink_msg_gps_raw_int_get_satellites_visible(&Msg);
-				storeTelemetryData( FR_TEMP2, value1 * 10 + value2 ) ;
-				
-//				gpsHdop           = mavlink_msg_gps_raw_int_get_eph(&Msg);
-				storeTelemetryData( FR_GPS_HDOP, mavlink_msg_gps_raw_int_get_eph(&Msg) ) ;
-
-//        gpsAltitude       = mavlink_msg_gps_raw_int_get_alt(&Msg); // meters * 1000
-				storeTelemetryData( FR_SPORT_GALT, mavlink_msg_gps_raw_int_get_alt(&Msg) / 100 ) ;
-//        gpsCourse         = mavlink_msg_gps_raw_int_get_cog(&Msg);
-        
+}
+
+static void mavlinkGpsRawInt( const mavlink_message_t *msg )
+{
+	uint16_t value1 ;
+	uint16_t value2 ;
+
+	value2 = mavlink_msg_gps_raw_int_get_fix_type(msg);
+	value1 = mavlink_msg_gps_raw_int_get_satellites_visible(msg);
+	gpsStorePosition( mavlink_msg_gps_raw_int_get_lat(msg), mavlink_msg_gps_raw_int_get_lon(msg), value2 >= 3 ) ;
+	storeTelemetryData( FR_TEMP2, value1 * 10 + value2 ) ;
+
+//				gpsHdop           = mavlink_msg_gps_raw_int_get_eph(msg);
+	storeTelemetryData( FR_GPS_HDOP, mavlink_msg_gps_raw_int_get_eph(msg) ) ;
+
+//        gpsAltitude       = mavlink_msg_gps_raw_int_get_alt(msg); // meters * 1000
+	storeTelemetryData( FR_SPORT_GALT, mavlink_msg_gps_raw_int_get_alt(msg) / 100 ) ;
+//        gpsCourse         = mavlink_msg_gps_raw_int_get_cog(msg);
+
 ////				return MAVLINK_MSG_ID_GPS_RAW_INT;
-      }
-      break ;
+}
 
-      case MAVLINK_MSG_ID_VFR_HUD:
-      {
-				float fvalue ;
-				int16_t course ;
+static void mavlinkVfrHud( const mavlink_message_t *msg )
+{
+	float fvalue ;
+	int16_t course ;
 //        lastMAVBeat = millis(); // we waiting only HUD packet
-//        airspeed = mavlink_msg_vfr_hud_get_airspeed(&Msg);
-//        gpsGroundSpeed = mavlink_msg_vfr_hud_get_groundspeed(&Msg); // Current ground speed in m/s
-        course = mavlink_msg_vfr_hud_get_heading(&Msg); // 0..360 deg, 0=north
-				if ( course < 0 )
-				{
-					course += 360 ;
-				}
-				storeTelemetryData( FR_COURSE, course ) ;
-//        throttle = mavlink_msg_vfr_hud_get_throttle(&Msg);
-        fvalue = mavlink_msg_vfr_hud_get_alt(&Msg)  * 100.0f ; // meters
-				storeTelemetryData( FR_SPORT_ALT, fvalue ) ;
-				fvalue = mavlink_msg_vfr_hud_get_climb(&Msg) ;
-				storeTelemetryData( FR_VSPD, fvalue ) ;
+//        airspeed = mavlink_msg_vfr_hud_get_airspeed(msg);
+//        gpsGroundSpeed = mavlink_msg_vfr_hud_get_groundspeed(msg); // Current ground speed in m/s
+	course = mavlink_msg_vfr_hud_get_heading(msg); // 0..360 deg, 0=north
+	if ( course < 0 )
+	{
+		course += 360 ;
+	}
+	storeTelemetryData( FR_COURSE, course ) ;
+//        throttle = mavlink_msg_vfr_hud_get_throttle(msg);
+	fvalue = mavlink_msg_vfr_hud_get_alt(msg)  * 100.0f ; // meters
+	storeTelemetryData( FR_SPORT_ALT, fvalue ) ;
+	fvalue = mavlink_msg_vfr_hud_get_climb(msg) ;
+	storeTelemetryData( FR_VSPD, fvalue ) ;
 ////        return MAVLINK_MSG_ID_VFR_HUD;
-      }
-      break ;
-            
+}
+
 //			case MAVLINK_MSG_ID_ATTITUDE:
 //      {
 ////                accX = ToDeg(mavlink_msg_attitude_get_pitch(&Msg));
@@ -1189,36 +946,33 @@ void mavlinkReceive( uint8_t data )
 //      }
 //      break ;
 
+static void mavlinkRadio( const mavlink_message_t *msg )
+{
+	uint8_t value ;
+	value = mavlink_msg_radio_get_rssi(msg) ;
+	if ( value )
+	{
+		storeRSSI( value ) ;
+	}
+}
 
-      case MAVLINK_MSG_ID_RADIO :
-			{
-				uint8_t value ;
-				value = mavlink_msg_radio_get_rssi(&Msg) ;
-				if ( value )
-				{
-					storeRSSI( value ) ;
-				}
-			}
-      break ;
+static void mavlinkRcChannelsRaw( const mavlink_message_t *msg )
+{
+	uint8_t value ;
+	value = mavlink_msg_rc_channels_raw_get_rssi(msg) ;
+	if ( value )
+	{
+		storeRSSI( value ) ;
+	}
+}
 
-			case MAVLINK_MSG_ID_RC_CHANNELS_RAW :
-			{
-				uint8_t value ;
-				value = mavlink_msg_rc_channels_raw_get_rssi(&Msg) ;
-				if ( value )
-				{
-					storeRSSI( value ) ;
-				}
-			}
-      break ;
-      case MAVLINK_MSG_ID_HWSTATUS:  
-      {
-				storeTelemetryData( FR_VCC, mavlink_msg_hwstatus_get_Vcc(&Msg) / 100 ) ;
+static void mavlinkHwstatus( const mavlink_message_t *msg )
+{
+	storeTelemetryData( FR_VCC, mavlink_msg_hwstatus_get_Vcc(msg) / 100 ) ;
 
 ////				return MAVLINK_MSG_ID_HWSTATUS;
-      }
-      break;
-        
+}
+
 //			case MAVLINK_MSG_ID_STATUSTEXT:
 //      {   
 //        last_message_severity = mavlink_msg_statustext_get_severity(&Msg);
@@ -1231,16 +985,137 @@ void mavlinkReceive( uint8_t data )
 ////        return MAVLINK_MSG_ID_STATUSTEXT;
 //      }
 //      break ;
-         
-//			default:
-////        return Msg.msgid;
-//      break;
-    }
-  }
-   // Update global packet drops counter
-//    packet_drops += status.packet_rx_drop_count;
-//    parse_error += status.parse_error;
-//   return -1;
+
+// Messages we decode, with their v1 payload length and CRC_EXTRA seed.
+// HWSTATUS has no seed in MAVLINK_MESSAGE_CRCS, so the seeds are held here.
+struct t_mavlinkHandler
+{
+	uint8_t msgid ;
+	uint8_t length ;
+	uint8_t crcExtra ;
+	void (*handler)( const mavlink_message_t *msg ) ;
+} ;
+
+static const struct t_mavlinkHandler MavlinkHandlers[] =
+{
+	{ MAVLINK_MSG_ID_HEARTBEAT, 9, 50, mavlinkHeartbeat },
+	{ MAVLINK_MSG_ID_SYS_STATUS, 31, 124, mavlinkSysStatus },
+	{ MAVLINK_MSG_ID_GPS_RAW_INT, 30, 24, mavlinkGpsRawInt },
+	{ MAVLINK_MSG_ID_VFR_HUD, 20, 20, mavlinkVfrHud },
+	{ MAVLINK_MSG_ID_RC_CHANNELS_RAW, 22, 244, mavlinkRcChannelsRaw },
+	{ MAVLINK_MSG_ID_HWSTATUS, 3, 21, mavlinkHwstatus },
+	{ MAVLINK_MSG_ID_RADIO, 9, 21, mavlinkRadio }
+} ;
+
+#define MAVLINK_NUM_HANDLERS	(sizeof(MavlinkHandlers)/sizeof(struct t_mavlinkHandler))
+
+static const uint8_t MavlinkCrcExtra[256] = MAVLINK_MESSAGE_CRCS ;
+
+static void mavlinkStartFrame( mavlink_message_t *msg, uint8_t c )
+{
+	msg->parse_state = MAVLINK_PARSE_STATE_IDLE ;
+	if ( c == MAVLINK_STX )
+	{
+		msg->parse_state = MAVLINK_PARSE_STATE_GOT_STX ;
+		mavlink_start_checksum( msg ) ;
+	}
+}
+
+// Decode one byte of the stream. Only the payload of a message in
+// MavlinkHandlers is kept, and only up to MAVLINK_FRAME_PAYLOAD_LEN bytes,
+// every other frame is just checksummed on the way past.
+void mavlinkReceive( uint8_t data )
+{
+	mavlink_message_t *msg = &MavlinkFrame ;
+
+	switch ( msg->parse_state )
+	{
+		case MAVLINK_PARSE_STATE_IDLE :
+			mavlinkStartFrame( msg, data ) ;
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_STX :
+			msg->len = data ;
+			msg->packet_idx = 0 ;
+			mavlink_update_checksum( msg, data ) ;
+			msg->parse_state = MAVLINK_PARSE_STATE_GOT_LENGTH ;
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_LENGTH :
+		case MAVLINK_PARSE_STATE_GOT_SEQ :
+		case MAVLINK_PARSE_STATE_GOT_SYSID :
+			// Sequence, system and component IDs are not used
+			mavlink_update_checksum( msg, data ) ;
+			msg->parse_state += 1 ;
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_COMPID :
+		{
+			uint32_t i ;
+			msg->msgid = data ;
+			mavlink_update_checksum( msg, data ) ;
+			msg->handler = MAVLINK_NO_HANDLER ;
+			msg->crcExtra = MavlinkCrcExtra[data] ;
+			for ( i = 0 ; i < MAVLINK_NUM_HANDLERS ; i += 1 )
+			{
+				if ( MavlinkHandlers[i].msgid == data )
+				{
+					msg->crcExtra = MavlinkHandlers[i].crcExtra ;
+					if ( msg->len >= MavlinkHandlers[i].length )
+					{
+						msg->handler = i ;
+					}
+					break ;
+				}
+			}
+			msg->parse_state = msg->len ? MAVLINK_PARSE_STATE_GOT_MSGID : MAVLINK_PARSE_STATE_GOT_PAYLOAD ;
+		}
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_MSGID :
+			if ( ( msg->handler != MAVLINK_NO_HANDLER ) && ( msg->packet_idx < MAVLINK_FRAME_PAYLOAD_LEN ) )
+			{
+				_MAV_PAYLOAD_NON_CONST(msg)[msg->packet_idx] = data ;
+			}
+			mavlink_update_checksum( msg, data ) ;
+			if ( ++msg->packet_idx == msg->len )
+			{
+				msg->parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD ;
+			}
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_PAYLOAD :
+			mavlink_update_checksum( msg, msg->crcExtra ) ;
+			if ( data != (msg->checksum & 0xFF) )
+			{
+				mavlinkStartFrame( msg, data ) ;
+			}
+			else
+			{
+				msg->parse_state = MAVLINK_PARSE_STATE_GOT_CRC1 ;
+			}
+		break ;
+
+		case MAVLINK_PARSE_STATE_GOT_CRC1 :
+			if ( data != (msg->checksum >> 8) )
+			{
+				mavlinkStartFrame( msg, data ) ;
+			}
+			else
+			{
+				msg->parse_state = MAVLINK_PARSE_STATE_IDLE ;
+				frskyUsrStreaming = FRSKY_USR_TIMEOUT10ms ;
+				if ( msg->handler != MAVLINK_NO_HANDLER )
+				{
+					MavlinkHandlers[msg->handler].handler( msg ) ;
+				}
+			}
+		break ;
+
+		default :
+			msg->parse_state = MAVLINK_PARSE_STATE_IDLE ;
+		break ;
+	}
 }
 //void Mavlink::printMessage(SoftwareSerial* serialPort, IFrSkyDataProvider* dataProvider, int msg)
 //{
@@ -39,6 +39,7 @@
 #include "pulses.h"
 #include "mixer.h"
 #include "frsky.h"
+#include "sbus.h"
 //#include <ctype.h>
 #ifndef SIMU
 #include "CoOS.h"
@@ -190,7 +191,6 @@ uint8_t JetiBufferReady ;
 struct t_timer s_timer[2] ;
 
 uint8_t RotaryState ;		// Defaults to ROTARY_MENU_LR
-uint8_t CalcScaleNest = 0 ;
 
 struct t_popupData PopupData ;
 
@@ -1027,26 +1027,128 @@ int16_t c_to_f( int16_t degrees )
   return degrees ;
 }
 
-int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals)
+// Scalers are evaluated once per mixer frame, in dependency order, into
+// ScalerValues[], everything else reads the cached result.
+int16_t ScalerValues[NUM_SCALERS] ;
+uint8_t ScalerOrder[NUM_SCALERS] ;
+uint8_t ScalerLinks[NUM_SCALERS][3] ;		// source, exSource, dest the order was built from
+uint8_t ScalersSorted ;
+
+// The TelemIndex[] item a scaler source reads, follows getValue()
+static int8_t scalerSourceItem( uint8_t source )
+{
+	uint32_t i ;
+
+	if ( source == 0 )
+	{
+		return -128 ;
+	}
+	i = source - 1 ;
+	if ( i >= EXTRA_POTS_START-1 )
+	{
+		if ( i < EXTRA_POTS_START-1+8 )
+		{
+			return -128 ;
+		}
+	}
+	else if ( ( i < CHOUT_BASE+NUM_SKYCHNOUT ) || ( i >= CHOUT_BASE+NUM_SKYCHNOUT+NUM_TELEM_ITEMS ) )
+	{
+		return -128 ;
+	}
+	i -= CHOUT_BASE+NUM_SKYCHNOUT ;
+	if ( i >= TELEM_GAP_START + 8 )
+	{
+		i -= 8 ;
+	}
+	if ( i >= sizeof(TelemIndex) )
+	{
+		return -128 ;
+	}
+	return TelemIndex[i] ;
+}
+
+// Bit mask of the scalers a source depends on, either directly or
+// through a telemetry item written by a scaler destination
+static uint8_t scalerDepends( uint8_t source )
+{
+	int8_t item ;
+	uint32_t i ;
+	uint8_t mask = 0 ;
+
+	item = scalerSourceItem( source ) ;
+	if ( ( item >= V_SC1 ) && ( item <= V_SC8 ) )
+	{
+		return 1 << ( item - V_SC1 ) ;
+	}
+	for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
+	{
+		uint8_t dest = g_model.eScalers[i].dest ;
+		if ( dest && ( dest <= NUM_SCALER_DESTS ) )
+		{
+			int8_t destItem = DestIndex[dest-1] ;
+			if ( ( destItem == item ) || ( ( item == FR_WATT ) && ( ( destItem == FR_VOLTS ) || ( destItem == FR_CURRENT ) ) ) )
+			{
+				mask |= 1 << i ;
+			}
+		}
+	}
+	return mask ;
+}
+
+// Called when the scaler sources change, including a model load
+static void sortScalers()
+{
+	uint8_t depends[NUM_SCALERS] ;
+	uint32_t i ;
+	uint32_t count = 0 ;
+	uint8_t done = 0 ;
+	uint8_t progress ;
+
+	for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
+	{
+		depends[i] = scalerDepends( g_model.Scalers[i].source ) | scalerDepends( g_model.eScalers[i].exSource ) ;
+		ScalerLinks[i][0] = g_model.Scalers[i].source ;
+		ScalerLinks[i][1] = g_model.eScalers[i].exSource ;
+		ScalerLinks[i][2] = g_model.eScalers[i].dest ;
+	}
+	do
+	{
+		progress = 0 ;
+		for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
+		{
+			uint8_t bit = 1 << i ;
+			if ( ( ( done & bit ) == 0 ) && ( ( depends[i] & ~done ) == 0 ) )
+			{
+				ScalerOrder[count++] = i ;
+				done |= bit ;
+				progress = 1 ;
+			}
+		}
+	} while ( progress ) ;
+	// Any left are in, or depend on, a loop. They go last and see the
+	// previous frame's value of the scalers in the loop.
+	for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
+	{
+		if ( ( done & ( 1 << i ) ) == 0 )
+		{
+			ScalerOrder[count++] = i ;
+		}
+	}
+	ScalersSorted = 1 ;
+}
+
+static int16_t evalScaler( uint8_t index )
 {
 	int32_t value ;
 	int32_t exValue ;
-	uint8_t lnest ;
 	ScaleData *pscaler ;
 	ExtScaleData *epscaler ;
 	
-	lnest = CalcScaleNest ;
-	if ( lnest > 5 )
-	{
-		return 0 ;
-	}
-	CalcScaleNest = lnest + 1 ;
-	// process
 	pscaler = &g_model.Scalers[index] ;
 	epscaler = &g_model.eScalers[index] ;
 	if ( pscaler->source )
 	{
-		value = getValue( pscaler->source - 1 ) ;
+		value = getLiveValue( pscaler->source - 1 ) ;
 		if ( ( pscaler->source == NUM_SKYXCHNRAW+1 ) || ( pscaler->source == NUM_SKYXCHNRAW+2 ) )
 		{
 			value = scale_telem_value( value, pscaler->source - NUM_SKYXCHNRAW-1, NULL ) ;
@@ -1071,7 +1173,7 @@ int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals)
 	}
 	if ( epscaler->exSource )
 	{
-		exValue = getValue( epscaler->exSource - 1 ) ;
+		exValue = getLiveValue( epscaler->exSource - 1 ) ;
 		if ( ( epscaler->exSource == NUM_SKYXCHNRAW+1 ) || ( epscaler->exSource == NUM_SKYXCHNRAW+2 ) )
 		{
 			exValue = scale_telem_value( exValue, epscaler->exSource - NUM_SKYXCHNRAW-1, NULL ) ;
@@ -1113,7 +1215,6 @@ int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals)
 			}
 		}
 	}
-	CalcScaleNest = lnest ;
 	if ( pscaler->offsetLast )
 	{
 		value += pscaler->offset ;
@@ -1131,20 +1232,48 @@ int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals)
 	{
 		value = -32768 ;
 	}
-	if ( unit )
+	if ( epscaler->dest )
 	{
-		*unit = pscaler->unit ;
+		store_telemetry_scaler( epscaler->dest, value ) ;
 	}
-	if ( num_decimals )
+
+	return value ;
+}
+
+void evalScalers()
+{
+	uint32_t i ;
+
+	for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
 	{
-		*num_decimals = pscaler->precision ;
+		if ( ( ScalerLinks[i][0] != g_model.Scalers[i].source ) || ( ScalerLinks[i][1] != g_model.eScalers[i].exSource )
+				 || ( ScalerLinks[i][2] != g_model.eScalers[i].dest ) )
+		{
+			ScalersSorted = 0 ;
+		}
 	}
-	if ( epscaler->dest )
+	if ( ScalersSorted == 0 )
 	{
-		store_telemetry_scaler( epscaler->dest, value ) ;
+		sortScalers() ;
+	}
+	for ( i = 0 ; i < NUM_SCALERS ; i += 1 )
+	{
+		uint8_t index = ScalerOrder[i] ;
+		ScalerValues[index] = evalScaler( index ) ;
 	}
+}
 
-	return value ;
+int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals)
+{
+	if ( unit )
+	{
+		*unit = g_model.Scalers[index].unit ;
+	}
+	if ( num_decimals )
+	{
+		*num_decimals = g_model.Scalers[index].precision ;
+	}
+	return ScalerValues[index] ;
 }
 									 
 uint8_t telemItemValid( uint8_t index )
@@ -2432,6 +2561,12 @@ void menuProcDiagKeys(uint8_t event) ;
 void menuProcDiagCalib(uint8_t event) ;
 void menuProcSDstat(uint8_t event) ;
 void menuProcBoot(uint8_t event) ;
+#if !defined(SIMU) && !defined(SMALL) && CFG_TASK_PROFILE_EN > 0
+void menuProcTasks(uint8_t event) ;
+#endif
+#if ( defined(PCBSKY) || defined(PCB9XT) ) && !defined(SMALL)
+void menuProcFlashWear(uint8_t event) ;
+#endif
 #ifdef PCB9XT
 void menuProcSlave(uint8_t event) ;
 #endif
@@ -2577,6 +2712,12 @@ enum EnumTabStat
 #endif
 #ifndef SMALL
 	e_s6r,
+#endif
+#if !defined(SIMU) && !defined(SMALL) && CFG_TASK_PROFILE_EN > 0
+	e_tasks,
+#endif
+#if ( defined(PCBSKY) || defined(PCB9XT) ) && !defined(SMALL)
+	e_flashWear,
 #endif
   e_Boot
 } ;
@@ -2616,6 +2757,12 @@ MenuFuncP menuTabStat[] =
 #endif
 #ifndef SMALL
 	menuProcS6R,
+#endif
+#if !defined(SIMU) && !defined(SMALL) && CFG_TASK_PROFILE_EN > 0
+	menuProcTasks,
+#endif
+#if ( defined(PCBSKY) || defined(PCB9XT) ) && !defined(SMALL)
+	menuProcFlashWear,
 #endif
 	menuProcBoot
 } ;
@@ -14863,6 +15010,11 @@ void menuProcModelSelect(uint8_t event)
 
   int8_t  sub    = mstate2.m_posVert;
   static uint8_t sel_editMode;
+#if defined(PCBSKY) || defined(PCB9XT)
+#ifndef SMALL
+	ee32PrefetchModel( sub ) ;		// Read it now so selecting it is quick
+#endif
+#endif
   if ( DupIfNonzero == 2 )
   {
       sel_editMode = false ;
@@ -17789,6 +17941,40 @@ void menuProcTrainDdiag(uint8_t event)
 	lcd_putsAttIdx(16*FW, 2*FH, XPSTR("\003NegPos"), TrainerPolarity, (sub == 2) ? INVERS : 0 ) ;
 #endif
 
+	// Input frame timing in uS, MENU LONG clears
+	lcd_puts_Pleft( 3*FH, XPSTR("Frame(uS)") ) ;
+	lcd_outdez( 21*FW, 3*FH, TrainerStats.interval >> 1 ) ;
+	lcd_puts_Pleft( 4*FH, XPSTR("Min") ) ;
+	lcd_outdez( 9*FW, 4*FH, TrainerStats.minInterval >> 1 ) ;
+	lcd_puts_P( 11*FW, 4*FH, XPSTR("Max") ) ;
+	lcd_outdez( 21*FW, 4*FH, TrainerStats.maxInterval >> 1 ) ;
+	lcd_puts_Pleft( 5*FH, XPSTR("Jitter") ) ;
+	lcd_puts_Pleft( 6*FH, XPSTR("Lost") ) ;
+	lcd_outdez( 9*FW, 6*FH, TrainerStats.lost ) ;
+	lcd_puts_P( 11*FW, 6*FH, XPSTR("Fs") ) ;
+	lcd_outdez( 21*FW, 6*FH, TrainerStats.failsafe ) ;
+	lcd_puts_Pleft( 7*FH, XPSTR("Frames") ) ;
+#ifdef BLUETOOTH
+	// BT trainer master, round trip to the slave's reply in uS
+	lcd_outdezAtt( 12*FW, 5*FH, (uint32_t)TrainerStats.jitter * 5 / 16, PREC1 ) ;
+	lcd_puts_P( 13*FW, 5*FH, XPSTR("RtJ") ) ;
+	lcd_outdez( 21*FW, 5*FH, BtLinkStats.rttJitter >> 5 ) ;
+	lcd_outdez( 12*FW, 7*FH, TrainerStats.frames ) ;
+	lcd_puts_P( 13*FW, 7*FH, XPSTR("Rtt") ) ;
+	lcd_outdez( 21*FW, 7*FH, BtLinkStats.rttAverage >> 5 ) ;
+#else
+	lcd_outdezAtt( 21*FW, 5*FH, (uint32_t)TrainerStats.jitter * 5 / 16, PREC1 ) ;
+	lcd_outdez( 21*FW, 7*FH, TrainerStats.frames ) ;
+#endif
+	if ( event == EVT_KEY_LONG(KEY_MENU) )
+	{
+		clearTrainerStats() ;
+#ifdef BLUETOOTH
+		clearBtLinkStats() ;
+#endif
+		killEvents( event ) ;
+	}
+
 #ifndef SMALL
 //uint32_t size = (uint32_t)&_estack - (uint32_t)&_ebss ;
 
@@ -21271,6 +21457,10 @@ extern uint8_t LogsRunning ;
 								{
 									hdg = FrskyHubData[FR_HOME_DIR] ;
 								}
+								else if ( GpsData.homeSet && GpsData.distance )
+								{
+									hdg = GpsData.bearing + 270 ;		// Direction to home, north up
+								}
 								for (int32_t i = -3 ; i < r ; i += 1 )
 								{
 									x = x0 + ( i * rxcos100 ( hdg ) ) / 100; 
@@ -21920,6 +22110,70 @@ void menuRestoreEeprom( uint8_t event )
 
 
 
+#if defined(PCBSKY) || defined(PCB9XT)
+void menuRestoreModels( uint8_t event )
+{
+	static uint8_t state ;
+	struct fileControl *fc = &FileControl ;
+	TITLE(XPSTR("Restore Models"));
+
+	if ( event == EVT_ENTRY )
+	{
+		state = ERESTORE_START ;
+	}
+
+	switch ( state )
+	{
+		case ERESTORE_START :
+			lcd_puts_Pleft( 4*FH, XPSTR("\006Preparing") ) ;
+			if ( ee32_check_finished() )
+			{
+				setupFileNames( (TCHAR *)"/EEPROM", fc, (char *)"MBK" ) ;
+				state = ERESTORE_SELECT ;
+			}
+		break ;
+
+		case ERESTORE_SELECT :
+		{
+			uint32_t i ;
+			i = fileList( event, &FileControl ) ;
+			if ( i == 1 )	// Select
+			{
+				state = ERESTORE_CONFIRM ;
+			}
+			else if ( i == 2 )	// EXIT
+			{
+  		  killEvents(event) ;
+  		  popMenu() ;
+			}
+		}
+		break ;
+
+		case ERESTORE_CONFIRM :
+			lcd_puts_Pleft( 2*FH, "Replace models from" ) ;
+			lcd_putsnAtt( 0, 4*FH, SharedMemory.FileList.Filenames[fc->vpos], 21, 0 ) ;
+			if ( event == EVT_KEY_LONG(KEY_MENU) )
+			{
+				TCHAR filename[60] ;
+				cpystr( cpystr( (uint8_t *)filename, (uint8_t *)"/EEPROM/" ), (uint8_t *) SharedMemory.FileList.Filenames[fc->vpos] ) ;
+				WatchdogTimeout = 300 ;		// 3 seconds
+				AlertType = MESS_TYPE ;
+				AlertMessage = ee32RestoreAllModels( filename ) ;
+				eeReadAll() ;
+				createSwitchMapping() ;
+				create6posTable() ;
+  		  killEvents(event) ;
+				popMenu() ;
+			}
+			if ( event == EVT_KEY_LONG(KEY_EXIT) )
+			{
+				state = ERESTORE_SELECT ;		// Canceled
+			}
+		break ;
+	}
+}
+#endif
+
 #if defined(PCBX12D) || defined(PCBX10)
 void menuColour( uint8_t event, uint8_t mode )
 {
@@ -24363,6 +24617,15 @@ void I2C_set_volume( register uint8_t volume ) ;
 			y += FH ;
 			subN += 1 ;
       lcd_putsAtt( 0, y,XPSTR("Restore EEPROM"), (sub==subN) ? INVERS : 0 ) ;
+#if defined(PCBSKY) || defined(PCB9XT)
+			IlinesCount = 4 ;
+			y += FH ;
+			subN += 1 ;
+      lcd_putsAtt( 0, y, XPSTR("Backup Models"), (sub==subN) ? INVERS : 0 ) ;
+			y += FH ;
+			subN += 1 ;
+      lcd_putsAtt( 0, y, XPSTR("Restore Models"), (sub==subN) ? INVERS : 0 ) ;
+#endif
 
 			if ( Tevent==EVT_KEY_BREAK(KEY_MENU) ) // || Tevent == EVT_KEY_BREAK(BTN_RE)  )
 			{
@@ -24375,6 +24638,18 @@ void I2C_set_volume( register uint8_t volume ) ;
 				{
 					pushMenu(menuRestoreEeprom) ;
 				}
+#if defined(PCBSKY) || defined(PCB9XT)
+				if ( sub == 2 )
+				{
+					WatchdogTimeout = 300 ;		// 3 seconds
+					AlertType = MESS_TYPE ;
+					AlertMessage = ee32BackupAllModels() ;
+				}
+				if ( sub == 3 )
+				{
+					pushMenu(menuRestoreModels) ;
+				}
+#endif
 			}
 		}			 
 		break ;
@@ -26275,6 +26550,90 @@ extern uint16_t M64UsedBackup ;
 }
 #endif // PCB9XT
 
+#if !defined(SIMU) && !defined(SMALL) && CFG_TASK_PROFILE_EN > 0
+extern const char *taskName( OS_TID id ) ;
+extern int32_t taskStackFree( OS_TID id ) ;
+
+// CPU use over the last second (0.01%) and stack words never used, per task
+void menuProcTasks(uint8_t event)
+{
+	uint32_t i ;
+	uint32_t y = 2*FH ;
+  MENU(XPSTR("Tasks"), menuTabStat, e_tasks, 1, {0} ) ;
+
+	lcd_puts_Pleft( FH, XPSTR("Task    CPU%  Free/Stk") ) ;
+	for ( i = 0 ; i < CO_TASK_SLOTS ; i += 1 )
+	{
+		uint32_t size = CoGetStackSize( i ) ;
+		if ( size == 0 )
+		{
+			continue ;
+		}
+		lcd_puts_Pleft( y, taskName( i ) ) ;
+		lcd_outdezAtt( 12*FW, y, CoGetTaskCpu( i ), PREC2 ) ;
+		if ( taskStackFree( i ) >= 0 )
+		{
+			lcd_outdez( 17*FW, y, taskStackFree( i ) ) ;
+		}
+		lcd_putc( 17*FW, y, '/' ) ;
+		lcd_outdez( 21*FW, y, size ) ;
+		y += FH ;
+	}
+}
+#endif
+
+#if ( defined(PCBSKY) || defined(PCB9XT) ) && !defined(SMALL)
+void menuProcFlashWear(uint8_t event)
+{
+	uint32_t i ;
+	uint32_t erases ;
+	uint32_t worst = 0 ;
+	uint32_t worstBlock = 0 ;
+	uint32_t general = 0 ;
+	uint32_t session = 0 ;
+	uint32_t hours ;
+  MENU(XPSTR("Flash Wear"), menuTabStat, e_flashWear, 1, {0} ) ;
+
+	for ( i = 0 ; i < EE32_BLOCKS ; i += 1 )
+	{
+		erases = ee32BlockErases( i ) ;
+		if ( erases > worst )
+		{
+			worst = erases ;
+			worstBlock = i ;
+		}
+		if ( ( i < 2 ) && ( erases > general ) )
+		{
+			general = erases ;
+		}
+		session += Ee32_block_erases[i] ;
+	}
+
+	lcd_puts_Pleft( 1*FH, XPSTR("Most worn block") ) ;
+	lcd_outdez( 21*FW, 1*FH, worstBlock ) ;
+	lcd_puts_Pleft( 2*FH, XPSTR("Erases") ) ;
+	lcd_outdezNAtt( 21*FW, 2*FH, worst, 0, 7 ) ;
+	lcd_puts_Pleft( 3*FH, XPSTR("Wear\016%") ) ;
+	lcd_outdezAtt( 14*FW-1, 3*FH, worst * 10000 / EE32_ENDURANCE, PREC2 ) ;
+	lcd_puts_Pleft( 4*FH, XPSTR("General erases") ) ;
+	lcd_outdezNAtt( 21*FW, 4*FH, general, 0, 7 ) ;
+	lcd_puts_Pleft( 5*FH, XPSTR("Erases this run") ) ;
+	lcd_outdezNAtt( 21*FW, 5*FH, session, 0, 7 ) ;
+	lcd_puts_Pleft( 6*FH, XPSTR("Life (hours)") ) ;
+	hours = ee32WearHours( &i ) ;
+	if ( hours == 0xFFFFFFFF )
+	{
+		lcd_puts_P( 18*FW, 6*FH, XPSTR("---") ) ;
+	}
+	else
+	{
+		lcd_outdezNAtt( 21*FW, 6*FH, hours, 0, 9 ) ;
+		lcd_puts_Pleft( 7*FH, XPSTR("Limited by block") ) ;
+		lcd_outdez( 21*FW, 7*FH, i ) ;
+	}
+}
+#endif
+
 extern uint32_t ChipId ;
 void menuProcBoot(uint8_t event)
 {
@@ -185,8 +185,7 @@ const char *get_curve_string() ;
 extern uint8_t unmapPots( uint8_t value ) ;
 
 extern int16_t calc_scaler( uint8_t index, uint16_t *unit, uint8_t *num_decimals) ;
-
-extern uint8_t CalcScaleNest ;
+extern void evalScalers( void ) ;
 
 #define MAXTRACE 120
 extern uint8_t s_traceBuf[] ;
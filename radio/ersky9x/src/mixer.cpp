@@ -27,6 +27,7 @@
 #include "audio.h"
 #include "logicio.h"
 #include "sound.h"
+#include "pulses.h"
 
 #if defined(PCBX9D) || defined(PCBX12D) || defined(PCBX10) || defined(PCBLEM1)
 #ifdef REV9E
@@ -180,6 +181,7 @@ void perOutPhase( int16_t *chanOut, uint8_t att )
 // #endif	
 //#endif
 
+	evalScalers() ;
 	thisPhase = getFlightPhase() ;
 	if ( thisPhase != lastPhase )
 	{
@@ -493,6 +495,12 @@ void perOut(int16_t *chanOut, uint8_t att )
         			}
     				}
         }
+#ifndef SMALL
+				if ( att & FADE_FIRST )
+				{
+					snapshotValues() ;		// Sticks are now current
+				}
+#endif
 				//    if throttle trim -> trim low end
         if(g_model.thrTrim)
 				{
@@ -1306,6 +1314,10 @@ void perOut(int16_t *chanOut, uint8_t att )
 				}
         chanOut[i] = q; //copy consistent word to int-level
 		}
+		if ( ( ( att & FADE_LAST ) || ( Fade.fadePhases == 0 ) ) && ( chanOut == g_chans512 ) )
+		{
+			updateOutputChannels() ;		// Module outputs from this complete pass
+		}
 }
 
 
@@ -64,6 +64,45 @@
 extern uint8_t BindRangeFlag[] ;
 //extern uint8_t PxxExtra[] ;
 
+// Module output stage. After each complete mixer pass the channels are
+// copied, and converted once to the PXX and Multi formats, into the bank not
+// in use. Frame builders read OutputBank once per frame, so both modules send
+// the same mixer pass and the scaling isn't repeated per module and frame.
+int16_t OutputChans[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+uint16_t OutputPxx[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+uint16_t OutputMulti[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+volatile uint8_t OutputBank ;
+
+// Multi 11 bit channel value, 0x400 is centre
+uint16_t scaleForMulti( int16_t value )
+{
+	int32_t x = value ;
+	x *= 4 ;
+	x += x > 0 ? 4 : -4 ;
+	x /= 5 ;
+	x += 0x400 ;
+	return limit( (int32_t)0, x, (int32_t)2047 ) ;
+}
+
+// Called by the mixer when g_chans512 holds a complete pass
+void updateOutputChannels()
+{
+	uint32_t i ;
+	uint32_t bank = OutputBank ^ 1 ;
+	int16_t *chans = OutputChans[bank] ;
+	uint16_t *pxx = OutputPxx[bank] ;
+	uint16_t *multi = OutputMulti[bank] ;
+
+	for ( i = 0 ; i < NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ; i += 1 )
+	{
+		int16_t value = g_chans512[i] ;
+		*chans++ = value ;
+		*pxx++ = limit( (int16_t)1, (int16_t)(value *3 / 4 + 1024), (int16_t)2046 ) ;
+		*multi++ = scaleForMulti( value ) ;
+	}
+	OutputBank = bank ;
+}
+
 void dsmBindResponse( uint8_t mode, int8_t channels )
 {
 	// Process mode here
@@ -111,6 +150,33 @@ void setMultiSerialArray( uint8_t *data, uint32_t module )
 	
 //	SetMultiArrayCount += 1 ;
 	
+	uint32_t sendFailsafe = 0 ;
+	struct t_module *pmodule = &g_model.Module[module] ;
+  if (pmodule->failsafeMode != FAILSAFE_NOT_SET && pmodule->failsafeMode != FAILSAFE_RX )
+	{
+    if ( FailsafeCounter[module] )
+		{
+	    if ( FailsafeCounter[module]-- == 1 )
+			{
+				sendFailsafe = 1 ;
+			}
+		}
+	  if ( FailsafeCounter[module] == 0 )
+		{
+//			if ( pmodule->failsafeRepeat == 0 )
+//			{
+				FailsafeCounter[module] = 1000 ;
+//			}
+		}
+	}
+	multiSerialFrame( data, pmodule, OutputMulti[OutputBank], sendFailsafe, BindRangeFlag[module] ) ;
+}
+
+// Builds the Multi serial frame from the module settings and channels passed,
+// without touching any other state, so it may be run from the encoder self test
+// chans are already in Multi format, see scaleForMulti()
+void multiSerialFrame( uint8_t *data, struct t_module *pmodule, uint16_t *chans, uint32_t sendFailsafe, uint8_t bindRange )
+{
 	uint32_t i ;
 	uint8_t packetType ;
 	uint8_t protoByte ;
@@ -118,7 +184,6 @@ void setMultiSerialArray( uint8_t *data, uint32_t module )
 	uint8_t subProtocol ;
 	uint32_t outputbitsavailable = 0 ;
 	uint32_t outputbits = 0 ;
-	struct t_module *pmodule = &g_model.Module[module] ;
 	uint8_t startChan = pmodule->startChannel ;
 	subProtocol = pmodule->sub_protocol+1 ;
 #if defined(PCBT12) || defined(PCBT16) // || defined(PCBX9D) || defined(PCBX12D) || defined(PCBX10)
@@ -134,27 +199,14 @@ void setMultiSerialArray( uint8_t *data, uint32_t module )
 	}
 #endif
 	packetType = ( ( subProtocol & 0x3F) > 31 ) ? 0x54 : 0x55 ;
-  if (pmodule->failsafeMode != FAILSAFE_NOT_SET && pmodule->failsafeMode != FAILSAFE_RX )
+	if ( sendFailsafe )
 	{
-    if ( FailsafeCounter[module] )
-		{
-	    if ( FailsafeCounter[module]-- == 1 )
-			{
-				packetType += 2 ;	// Failsafe packet
-			}
-		}
-	  if ( FailsafeCounter[module] == 0 )
-		{
-//			if ( pmodule->failsafeRepeat == 0 )
-//			{
-				FailsafeCounter[module] = 1000 ;
-//			}
-		}
+		packetType += 2 ;	// Failsafe packet
 	}
 	*data++ = packetType ;
 	protoByte = subProtocol & 0x5F;		// load sub_protocol and clear Bind & Range flags
-	if (BindRangeFlag[module] & PXX_BIND)	protoByte |=BindBit ;		//set bind bit if bind menu is pressed
-	if (BindRangeFlag[module] & PXX_RANGE_CHECK) protoByte |=RangeCheckBit ;		//set bind bit if bind menu is pressed
+	if (bindRange & PXX_BIND)	protoByte |=BindBit ;		//set bind bit if bind menu is pressed
+	if (bindRange & PXX_RANGE_CHECK) protoByte |=RangeCheckBit ;		//set bind bit if bind menu is pressed
 	*data++ = protoByte ;
 	
 	protoByte = pmodule->channels ;
@@ -170,7 +222,7 @@ void setMultiSerialArray( uint8_t *data, uint32_t module )
 	{
 		int16_t x ;
 		uint32_t y = startChan + i ;
-		x = y >= ( NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ) ? 0 : g_chans512[y] ;
+		x = y >= ( NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ) ? 0x400 : chans[y] ;
 		if ( packetType & 2 )
 		{
 			if ( pmodule->failsafeMode == FAILSAFE_HOLD )
@@ -192,21 +244,6 @@ void setMultiSerialArray( uint8_t *data, uint32_t module )
 				startChan += 1 ;
 			}
 		}
-		else
-		{
-			x *= 4 ;
-			x += x > 0 ? 4 : -4 ;
-			x /= 5 ;
-			x += 0x400 ;
-		}
-		if ( x < 0 )
-		{
-			x = 0 ;
-		}
-		if ( x > 2047 )
-		{
-			x = 2047 ;
-		}
 		outputbits |= (uint32_t)x << outputbitsavailable ;
 		outputbitsavailable += 11 ;
 		while ( outputbitsavailable >= 8 )
@@ -248,6 +285,19 @@ void setDsmHeader( uint8_t *dsmDat, uint32_t module )
   else dsmDat[0]&=~RangeCheckBit;
 }
 
+// DSM2 channel words, 2 bits of channel number and 10 bits of value, from
+// chans[0] on. Shared by the SKY and X9D builders and the encoder self test.
+void dsmChannelBytes( uint8_t *data, int16_t *chans, uint32_t channels )
+{
+	uint32_t i ;
+	for ( i = 0 ; i < channels ; i += 1 )
+	{
+		uint16_t pulse = limit(0, ((chans[i]*13)>>5)+512, 1023) ;
+		*data++ = (i<<2) | ((pulse>>8)&0x03) ;
+		*data++ = pulse & 0xff ;
+	}
+}
+
 
 ///* CRC16 implementation according to CCITT standards */
 ////static const unsigned short crc16tab[256]= {
@@ -367,24 +417,146 @@ void setDsmHeader( uint8_t *dsmDat, uint32_t module )
 ////  PcmCrc =(PcmCrc<<8) ^(CRCTable[((PcmCrc>>8)^data)&0xFF]);
 ////}
 
-const uint16_t CRC_Short[]=
+// PXX CRC16 table, one lookup per byte (was 16 entries plus a multiply)
+const uint16_t PxxCrcTable[256]=
 {
-   0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
-   0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7 };
+	0x0000,0x1189,0x2312,0x329B,0x4624,0x57AD,0x6536,0x74BF,
+	0x8C48,0x9DC1,0xAF5A,0xBED3,0xCA6C,0xDBE5,0xE97E,0xF8F7,
+	0x1081,0x0108,0x3393,0x221A,0x56A5,0x472C,0x75B7,0x643E,
+	0x9CC9,0x8D40,0xBFDB,0xAE52,0xDAED,0xCB64,0xF9FF,0xE876,
+	0x2102,0x308B,0x0210,0x1399,0x6726,0x76AF,0x4434,0x55BD,
+	0xAD4A,0xBCC3,0x8E58,0x9FD1,0xEB6E,0xFAE7,0xC87C,0xD9F5,
+	0x3183,0x200A,0x1291,0x0318,0x77A7,0x662E,0x54B5,0x453C,
+	0xBDCB,0xAC42,0x9ED9,0x8F50,0xFBEF,0xEA66,0xD8FD,0xC974,
+	0x4204,0x538D,0x6116,0x709F,0x0420,0x15A9,0x2732,0x36BB,
+	0xCE4C,0xDFC5,0xED5E,0xFCD7,0x8868,0x99E1,0xAB7A,0xBAF3,
+	0x5285,0x430C,0x7197,0x601E,0x14A1,0x0528,0x37B3,0x263A,
+	0xDECD,0xCF44,0xFDDF,0xEC56,0x98E9,0x8960,0xBBFB,0xAA72,
+	0x6306,0x728F,0x4014,0x519D,0x2522,0x34AB,0x0630,0x17B9,
+	0xEF4E,0xFEC7,0xCC5C,0xDDD5,0xA96A,0xB8E3,0x8A78,0x9BF1,
+	0x7387,0x620E,0x5095,0x411C,0x35A3,0x242A,0x16B1,0x0738,
+	0xFFCF,0xEE46,0xDCDD,0xCD54,0xB9EB,0xA862,0x9AF9,0x8B70,
+	0x8408,0x9581,0xA71A,0xB693,0xC22C,0xD3A5,0xE13E,0xF0B7,
+	0x0840,0x19C9,0x2B52,0x3ADB,0x4E64,0x5FED,0x6D76,0x7CFF,
+	0x9489,0x8500,0xB79B,0xA612,0xD2AD,0xC324,0xF1BF,0xE036,
+	0x18C1,0x0948,0x3BD3,0x2A5A,0x5EE5,0x4F6C,0x7DF7,0x6C7E,
+	0xA50A,0xB483,0x8618,0x9791,0xE32E,0xF2A7,0xC03C,0xD1B5,
+	0x2942,0x38CB,0x0A50,0x1BD9,0x6F66,0x7EEF,0x4C74,0x5DFD,
+	0xB58B,0xA402,0x9699,0x8710,0xF3AF,0xE226,0xD0BD,0xC134,
+	0x39C3,0x284A,0x1AD1,0x0B58,0x7FE7,0x6E6E,0x5CF5,0x4D7C,
+	0xC60C,0xD785,0xE51E,0xF497,0x8028,0x91A1,0xA33A,0xB2B3,
+	0x4A44,0x5BCD,0x6956,0x78DF,0x0C60,0x1DE9,0x2F72,0x3EFB,
+	0xD68D,0xC704,0xF59F,0xE416,0x90A9,0x8120,0xB3BB,0xA232,
+	0x5AC5,0x4B4C,0x79D7,0x685E,0x1CE1,0x0D68,0x3FF3,0x2E7A,
+	0xE70E,0xF687,0xC41C,0xD595,0xA12A,0xB0A3,0x8238,0x93B1,
+	0x6B46,0x7ACF,0x4854,0x59DD,0x2D62,0x3CEB,0x0E70,0x1FF9,
+	0xF78F,0xE606,0xD49D,0xC514,0xB1AB,0xA022,0x92B9,0x8330,
+	0x7BC7,0x6A4E,0x58D5,0x495C,0x3DE3,0x2C6A,0x1EF1,0x0F78
+} ;
 
 uint16_t CRCTable(uint8_t val)
 {
-	return CRC_Short[val&0x0F] ^ (0x1081 * (val>>4));
+	return PxxCrcTable[val] ;
 }
 
 
 
-uint16_t scaleForPXX( uint8_t i )
+// chans is the OutputPxx bank taken at the start of the frame
+uint16_t scaleForPXX( uint16_t *chans, uint8_t i )
 {
-	int16_t value ;
+	return ( i < NUM_SKYCHNOUT+EXTRA_SKYCHANNELS ) ? chans[i] : 1 ;
+}
+
+// PXX frame body, rx number to extra flags, as it goes to the CRC and the bit
+// stuffing. The caller decides flag1 (bind, range, failsafe), an odd lpass
+// sends the upper 8 channels. Returns PXX_FRAME_BYTES.
+uint32_t pxxFrameBytes( uint8_t *data, struct t_module *pmodule, uint16_t *pxxChans, uint8_t flag1, uint32_t lpass )
+{
+	uint32_t i ;
+	uint16_t chan ;
+	uint16_t chan_1 ;
+	uint8_t extra_flags = 0 ;
+	uint8_t *p = data ;
+	uint8_t startChan = pmodule->startChannel ;
 
-	value = ( i < 32 ) ? g_chans512[i] *3 / 4 + 1024 : 0 ;
-	return limit( (int16_t)1, value, (int16_t)2046 ) ;
+	*p++ = pmodule->pxxRxNum ;
+	*p++ = flag1 ;		// First byte of flags
+	*p++ = 0 ;				// Second byte of flags
+
+	if ( lpass & 1 )
+	{
+		startChan += 8 ;
+	}
+	chan = 0 ;
+	for ( i = 0 ; i < 8 ; i += 1 )		// First 8 channels only
+	{																	// Next 8 channels would have 2048 added
+		if (flag1 & PXX_SEND_FAILSAFE)
+		{
+			if ( pmodule->failsafeMode == FAILSAFE_HOLD )
+			{
+				chan_1 = 2047 ;
+			}
+			else if ( pmodule->failsafeMode == FAILSAFE_NO_PULSES )
+			{
+				chan_1 = 0 ;
+			}
+			else
+			{
+				// Send failsafe value
+				int32_t value ;
+				value = ( startChan < 16 ) ? pmodule->failsafe[startChan] : 0 ;
+				value = ( value *3933 ) >> 9 ;
+				value += 1024 ;
+				chan_1 = limit( (int16_t)1, (int16_t)value, (int16_t)2046 ) ;
+			}
+		}
+		else
+		{
+			chan_1 = scaleForPXX( pxxChans, startChan ) ;
+		}
+		if ( lpass & 1 )
+		{
+			chan_1 += 2048 ;
+		}
+		startChan += 1 ;
+
+		if ( i & 1 )
+		{
+			*p++ = chan ; // Low byte of channel
+			*p++ = ( ( chan >> 8 ) & 0x0F ) | ( chan_1 << 4) ;  // 4 bits each from 2 channels
+			*p++ = chan_1 >> 4 ;  // High byte of channel
+		}
+		else
+		{
+			chan = chan_1 ;
+		}
+	}
+
+// Bit 0: 0 internal, 1 external antenna
+// Bit 1: 0 Telemetry ON, 1 Telemetry OFF
+// Bit 2: 0 PPM 1-8, 1 PPM 9-16
+// Bit 4:3: R9M power nonEU 10, 100, 500, 1000
+// Bit 4:3: R9M power EU 25, 500
+// Bit 5: 0 Sport enabled, 1 Sport disabled
+// Bits 7:6 unused
+	if ( pmodule->highChannels )
+	{
+		extra_flags = (1 << 2 ) ;
+	}
+	if ( pmodule->disableTelemetry )
+	{
+		extra_flags |= (1 << 1 ) ;
+	}
+	if ( pmodule->sub_protocol == 3 )	// R9M
+	{
+		extra_flags |= pmodule->r9mPower << 3 ;
+		if ( pmodule->r9MflexMode == 2 )
+		{
+			extra_flags |= 1 << 6 ;
+		}
+	}
+	*p++ = extra_flags ;
+	return p - data ;
 }
 
 
@@ -562,28 +734,36 @@ uint8_t setupPulsesXfire()
 	else
 	{
 		startChan = g_model.Module[1].startChannel ;
-  	*buf++ = 24 ; // 1(ID) + 22 + 1(CRC)
-  	uint8_t *crc_start = buf ;
-  	*buf++ = CHANNELS_ID ;
-  	uint32_t bits = 0 ;
-  	uint32_t bitsavailable = 0 ;
-  	for (uint32_t i=0 ; i < CROSSFIRE_CHANNELS_COUNT ; i += 1 )
-		{
-  	  uint32_t val = limit(0, CROSSFIRE_CH_CENTER + (((g_chans512[startChan+i]) * 4) / 5), 2*CROSSFIRE_CH_CENTER) ;
-  	  bits |= val << bitsavailable ;
-  	  bitsavailable += CROSSFIRE_CH_BITS ;
-  	  while (bitsavailable >= 8)
-			{
-  	    *buf++ = bits ;
-  	    bits >>= 8 ;
-  	    bitsavailable -= 8 ;
-  	  }
-  	}
-  	*buf++ = crc8( crc_start, 23) ;
+		buf += xfireChannelFrame( buf, &OutputChans[OutputBank][startChan] ) ;
 	}
   return (XfireLength = (buf - Bit_pulses)) ;
 }
 
+// Channels frame after the address byte, returns the number of bytes added
+uint32_t xfireChannelFrame( uint8_t *buf, int16_t *chans )
+{
+	uint8_t *start = buf ;
+ 	*buf++ = 24 ; // 1(ID) + 22 + 1(CRC)
+ 	uint8_t *crc_start = buf ;
+ 	*buf++ = CHANNELS_ID ;
+ 	uint32_t bits = 0 ;
+ 	uint32_t bitsavailable = 0 ;
+ 	for (uint32_t i=0 ; i < CROSSFIRE_CHANNELS_COUNT ; i += 1 )
+	{
+ 	  uint32_t val = limit(0, CROSSFIRE_CH_CENTER + (((chans[i]) * 4) / 5), 2*CROSSFIRE_CH_CENTER) ;
+ 	  bits |= val << bitsavailable ;
+ 	  bitsavailable += CROSSFIRE_CH_BITS ;
+ 	  while (bitsavailable >= 8)
+		{
+ 	    *buf++ = bits ;
+ 	    bits >>= 8 ;
+ 	    bitsavailable -= 8 ;
+ 	  }
+ 	}
+ 	*buf++ = crc8( crc_start, 23) ;
+	return buf - start ;
+}
+
 
 #endif
 
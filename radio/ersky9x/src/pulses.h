@@ -83,11 +83,27 @@ extern void pausePulses( void ) ;
 extern void resumePulses( void ) ;
 #ifdef ACCESS
 extern void setupPulsesAccess( uint32_t module ) ;
+extern void accessChannelBytes( uint8_t *data, struct t_module *pmodule, int8_t *accessFailsafe, uint16_t *pxxChans, uint8_t firstChannel, uint8_t sendFailsafe ) ;
 #endif
 
 extern void setMultiSerialArray( uint8_t *data, uint32_t module ) ;
+extern void multiSerialFrame( uint8_t *data, struct t_module *pmodule, uint16_t *chans, uint32_t sendFailsafe, uint8_t bindRange ) ;
+extern uint16_t scaleForMulti( int16_t value ) ;
+extern void updateOutputChannels( void ) ;
+extern int16_t OutputChans[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+extern uint16_t OutputPxx[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+extern uint16_t OutputMulti[2][NUM_SKYCHNOUT+EXTRA_SKYCHANNELS] ;
+extern volatile uint8_t OutputBank ;
+#ifdef XFIRE
+extern uint8_t crc8(const uint8_t * ptr, uint32_t len) ;
+extern uint32_t xfireChannelFrame( uint8_t *buf, int16_t *chans ) ;
+#endif
 extern uint16_t CRCTable(uint8_t val) ;
-extern uint16_t scaleForPXX( uint8_t i ) ;
+extern const uint16_t PxxCrcTable[] ;
+extern uint16_t scaleForPXX( uint16_t *chans, uint8_t i ) ;
+#define PXX_FRAME_BYTES		16
+extern uint32_t pxxFrameBytes( uint8_t *data, struct t_module *pmodule, uint16_t *pxxChans, uint8_t flag1, uint32_t lpass ) ;
+extern void dsmChannelBytes( uint8_t *data, int16_t *chans, uint32_t channels ) ;
 extern void dsmBindResponse( uint8_t mode, int8_t channels ) ;
 extern void setDsmHeader( uint8_t *dsmDat, uint32_t module ) ;
 
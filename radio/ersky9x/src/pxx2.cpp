@@ -26,6 +26,7 @@
 #include "myeeprom.h"
 #include "frsky.h"
 #include "drivers.h"
+#include "pulses.h"
 //#include "string.h"
 
 #ifdef ACCESS
@@ -82,7 +83,9 @@ uint32_t  pxx2AddFlag0( uint32_t module )
 }
 
 
-void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel )
+// Packs 8 channels, 12 bits per pair, into 12 bytes from the module settings
+// and channels passed, so the encoder self test may run it as well
+void accessChannelBytes( uint8_t *data, struct t_module *pmodule, int8_t *accessFailsafe, uint16_t *pxxChans, uint8_t firstChannel, uint8_t sendFailsafe )
 {
   uint16_t pulseValue = 0 ;
   uint16_t pulseValueLow = 0 ;
@@ -92,11 +95,11 @@ void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel )
     uint8_t channel = firstChannel + i ;
     if (sendFailsafe)
 		{
-      if (g_model.Module[module].failsafeMode == FAILSAFE_HOLD)
+      if (pmodule->failsafeMode == FAILSAFE_HOLD)
 			{
         pulseValue = 2047;
       }
-      else if (g_model.Module[module].failsafeMode == FAILSAFE_NO_PULSES)
+      else if (pmodule->failsafeMode == FAILSAFE_NO_PULSES)
 			{
         pulseValue = 0;
       }
@@ -105,12 +108,12 @@ void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel )
         int32_t failsafeValue ;
 				if ( channel < 16 )
 				{
-					failsafeValue = g_model.Module[module].failsafe[channel] ;
+					failsafeValue = pmodule->failsafe[channel] ;
 				}
 				else
 				{
 //					uint32_t index = module * 8 + channel - 16 ;
-					failsafeValue = g_model.accessFailsafe[module][channel - 16] ;
+					failsafeValue = accessFailsafe[channel - 16] ;
 				}
 				 
 //				if (failsafeValue == FAILSAFE_CHANNEL_HOLD)
@@ -131,15 +134,14 @@ void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel )
     }
     else
 		{
-      int value = g_chans512[channel] ; // + 2*PPM_CH_CENTER(channel) - 2*PPM_CENTER;
-      pulseValue = limit(1, (value * 3 / 4) + 1024, 2046);
+      pulseValue = scaleForPXX( pxxChans, channel ) ;
     }
 
     if (i & 1)
 		{
-      pxx2AddByte(pulseValueLow, module); // Low byte of channel
-      pxx2AddByte(((pulseValueLow >> 8) & 0x0F) | (pulseValue << 4), module);  // 4 bits each from 2 channels
-      pxx2AddByte(pulseValue >> 4, module);  // High byte of channel
+      *data++ = pulseValueLow ; // Low byte of channel
+      *data++ = ((pulseValueLow >> 8) & 0x0F) | (pulseValue << 4) ;  // 4 bits each from 2 channels
+      *data++ = pulseValue >> 4 ;  // High byte of channel
     }
     else
 		{
@@ -148,11 +150,24 @@ void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel )
   }
 }
 
+void addChannels( uint8_t module, uint8_t sendFailsafe, uint8_t firstChannel, uint16_t *pxxChans )
+{
+	uint32_t i ;
+	uint8_t data[12] ;
+
+	accessChannelBytes( data, &g_model.Module[module], g_model.accessFailsafe[module], pxxChans, firstChannel, sendFailsafe ) ;
+	for ( i = 0 ; i < 12 ; i += 1 )
+	{
+		pxx2AddByte( data[i], module ) ;
+	}
+}
+
 
 
 void setupChannelsAccess( uint32_t module )
 {
 	uint32_t flag0 ;
+	uint16_t *pxxChans = OutputPxx[OutputBank] ;		// Same mixer pass for all blocks
 
 	// For channels
 	pxx2AddByte( PXX2_TYPE_C_MODULE, module ) ;
@@ -168,25 +183,25 @@ void setupChannelsAccess( uint32_t module )
 
 	pxx2AddByte( flag1, module ) ;
 
-	addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel ) ;
+	addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel, pxxChans ) ;
 	
 
 	if ( g_model.Access[module].type )
 	{
 		if ( g_model.Module[module].channels == 0 )
 		{
-			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+8 ) ;
+			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+8, pxxChans ) ;
 		}
 	}
 	else
 	{
 		if ( g_model.Access[module].numChannels > 0 )
 		{
-			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+8 ) ;
+			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+8, pxxChans ) ;
 		}
 		if ( g_model.Access[module].numChannels > 1 )
 		{
-			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+16 ) ;
+			addChannels( module, flag0 & PXX2_CHANNELS_FLAG0_FAILSAFE, g_model.Module[module].startChannel+16, pxxChans ) ;
 		}
 	}
 //	if (size > 0)
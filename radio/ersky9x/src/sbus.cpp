@@ -42,13 +42,136 @@ uint8_t SbusFrame[28] ;
 uint8_t SbusIndex = 0 ;
 uint16_t SbusTimer = 0 ;
 
+struct t_trainerStats TrainerStats ;
+static uint32_t TrainerAverage ;		// Mean frame interval * 16, 0.5uS units
+
+void clearTrainerStats()
+{
+	TrainerStats.interval = 0 ;
+	TrainerStats.minInterval = 0 ;
+	TrainerStats.maxInterval = 0 ;
+	TrainerStats.jitter = 0 ;
+	TrainerStats.frames = 0 ;
+	TrainerStats.lost = 0 ;
+	TrainerStats.failsafe = 0 ;
+	TrainerAverage = 0 ;
+}
+
+// Called once per trainer frame received, SBUS or CPPM, may be from an ISR
+// flags holds TRAINER_FRAME_LOST and/or TRAINER_FRAME_FAILSAFE
+void trainerFrameStats( uint32_t flags )
+{
+	uint16_t now = getTmr2MHz() ;
+	uint16_t now10ms = get_tmr10ms() ;
+	uint32_t interval ;
+	uint32_t average ;
+	uint32_t ticks10ms ;
+
+	interval = (uint16_t)( now - TrainerStats.lastTime ) ;
+	ticks10ms = (uint16_t)( now10ms - TrainerStats.last10ms ) ;
+	TrainerStats.lastTime = now ;
+	TrainerStats.last10ms = now10ms ;
+	if ( ticks10ms > 100 )
+	{
+		// No input for over a second, start again
+		TrainerAverage = 0 ;
+		TrainerStats.frames = 0 ;
+	}
+	else if ( ticks10ms * 20000 > interval + 20000 )
+	{
+		// The 2MHz timer has wrapped, over 32.7mS, add the wraps that bring
+		// it within a tick of the 10mS timer
+		interval += ( ticks10ms * 20000 - 20000 - interval + 65535 ) & 0xFFFF0000 ;
+	}
+	TrainerStats.frames += 1 ;
+	if ( flags & TRAINER_FRAME_LOST )
+	{
+		TrainerStats.lost += 1 ;
+	}
+	if ( flags & TRAINER_FRAME_FAILSAFE )
+	{
+		TrainerStats.failsafe += 1 ;
+	}
+	if ( TrainerStats.frames == 1 )
+	{
+		return ;		// No interval yet
+	}
+	average = TrainerAverage >> 4 ;
+	if ( average && ( interval > average + average / 2 ) )
+	{
+		// Gap, count the missing frames, don't let it distort the timing
+		TrainerStats.lost += ( interval + average / 2 ) / average - 1 ;
+		return ;
+	}
+	if ( interval > 0xFFFF )
+	{
+		return ;
+	}
+	TrainerStats.interval = interval ;
+	if ( ( TrainerStats.minInterval == 0 ) || ( interval < TrainerStats.minInterval ) )
+	{
+		TrainerStats.minInterval = interval ;
+	}
+	if ( interval > TrainerStats.maxInterval )
+	{
+		TrainerStats.maxInterval = interval ;
+	}
+	if ( average == 0 )
+	{
+		TrainerAverage = interval << 4 ;
+		return ;
+	}
+	TrainerAverage += interval - average ;
+	// Jitter is the mean absolute deviation from the mean interval, *16
+	interval = ( interval > average ) ? interval - average : average - interval ;
+	if ( interval > 0x0FFF )
+	{
+		interval = 0x0FFF ;
+	}
+	TrainerStats.jitter += interval - ( TrainerStats.jitter >> 4 ) ;
+}
+
+// One CPPM pulse width (uS) from the trainer capture
+void processPpmInPulse( uint16_t val )
+{
+	// We process g_ppmIns right here to make servo movement as smooth as possible
+	//    while under trainee control
+	if ( (val>4000) && (val < 19000) ) // G: Prioritize reset pulse. (Needed when less than 8 incoming pulses)
+	{
+		if ( ppmInState > 1 )
+		{
+			trainerFrameStats( 0 ) ;
+		}
+		ppmInState = 1 ; // triggered
+	}
+	else
+	{
+		if ( ppmInState && (ppmInState<=16) )
+		{
+			if ( (val>800) && (val<2200) )
+			{
+				ppmInValid = 100 ;
+				g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500) ; //+-500 != 512, but close enough.
+			}
+			else
+			{
+				ppmInState = 0 ; // not triggered
+			}
+		}
+	}
+}
+
+// The 16 channels are 11 bits each, packed LSB first in 22 bytes, so
+// channel n starts at bit 11n and always lies within the 3 bytes from
+// byte 11n/8. Each channel is extracted from that 24 bit window directly.
 uint32_t processSBUSframe( uint8_t *sbus, int16_t *pulses, uint32_t size )
 {
-	uint32_t inputbitsavailable = 0 ;
 	uint32_t i ;
-	uint32_t inputbits = 0 ;
+	uint32_t bit ;
+	uint32_t value ;
+	uint8_t *p ;
 	uint8_t sum ;
-	sum = 0 ;
+	uint8_t flags ;
 	if ( *sbus++ != 0x0F )
 	{
 		return 0 ;		// Not a valid SBUS frame
@@ -57,29 +180,20 @@ uint32_t processSBUSframe( uint8_t *sbus, int16_t *pulses, uint32_t size )
 	{
 		return 0 ;
 	}
-	for ( i = 0 ; i < 16 ; i += 1 )
+	if ( pulses )
 	{
-		while ( inputbitsavailable < 11 )
+		bit = 0 ;
+		for ( i = 0 ; i < 16 ; i += 1 )
 		{
-			uint8_t temp ;
-			temp = *sbus++ ;
-			if ( i < 4 )
-			{
-				sum |= temp ;
-			}
-			inputbits |= temp << inputbitsavailable ;
-			inputbitsavailable += 8 ;
-		}
-		if ( pulses )
-		{
-			*pulses++ = ( (int32_t)( inputbits & 0x7FF ) - 0x3E0 ) * 5 / 8 ;
+			p = &sbus[bit >> 3] ;
+			value = ( p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) ) >> ( bit & 7 ) ;
+			*pulses++ = ( (int32_t)( value & 0x7FF ) - 0x3E0 ) * 5 / 8 ;
+			bit += 11 ;
 		}
-		inputbitsavailable -= 11 ;
-		inputbits >>= 11 ;
-	}
-	if ( pulses )
-	{
-		if ( ( *sbus & 0x08 ) || ( sum == 0 ) )
+		// Bytes holding the first 4 channels, all zero is not a real frame
+		sum = sbus[0] | sbus[1] | sbus[2] | sbus[3] | sbus[4] | sbus[5] ;
+		flags = sbus[22] ;
+		if ( ( flags & 0x08 ) || ( sum == 0 ) )
 		{
 			if ( ppmInValid )
 			{
@@ -88,11 +202,12 @@ uint32_t processSBUSframe( uint8_t *sbus, int16_t *pulses, uint32_t size )
 		}
 		else
 		{
-			if ( ( (*sbus & 0x04) == 0 ) && sum )
+			if ( ( (flags & 0x04) == 0 ) && sum )
 			{
 				ppmInValid = 100 ;
 			}
 		}
+		trainerFrameStats( flags & ( TRAINER_FRAME_LOST | TRAINER_FRAME_FAILSAFE ) ) ;
 	}
 	SbusTimer = 1000 ;
 	return 1 ;
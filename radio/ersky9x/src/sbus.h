@@ -35,8 +35,31 @@
 #ifndef sbus_h
 #define sbus_h
 
+// Trainer input frame statistics, all times in 0.5uS units
+struct t_trainerStats
+{
+	uint16_t interval ;			// Last frame interval
+	uint16_t minInterval ;
+	uint16_t maxInterval ;
+	uint16_t jitter ;				// Mean deviation from mean interval * 16
+	uint16_t frames ;
+	uint16_t lost ;					// Missing frames, or SBUS frame lost flag
+	uint16_t failsafe ;			// SBUS failsafe flag set
+	uint16_t lastTime ;
+	uint16_t last10ms ;
+} ;
+
+// Same bits as the SBUS flags byte
+#define TRAINER_FRAME_LOST			0x04
+#define TRAINER_FRAME_FAILSAFE	0x08
+
+extern struct t_trainerStats TrainerStats ;
+
 extern uint32_t processSBUSframe( uint8_t *sbus, int16_t *pulses, uint32_t size ) ;
 extern void processSbusInput( void ) ;
+extern void processPpmInPulse( uint16_t val ) ;
+extern void trainerFrameStats( uint32_t flags ) ;
+extern void clearTrainerStats( void ) ;
 
 #endif
 
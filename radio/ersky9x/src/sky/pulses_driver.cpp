@@ -643,6 +643,7 @@ void setupPulsesDsm2(uint8_t chns)
 #ifdef PCBSKY
 	uint8_t counter ;
 #endif // PCBSKY
+	int16_t *chans = OutputChans[OutputBank] ;
 
 
 	required_baudrate = SCC_BAUD_125000 ;
@@ -737,7 +738,7 @@ void setupPulsesDsm2(uint8_t chns)
 			for(uint8_t i=0 ; i<7 ; i += 1 )
 			{
 				uint16_t pulse ;
-				int16_t value = g_chans512[startChan] ;
+				int16_t value = chans[startChan] ;
 				if ( ( flags & ORTX_USE_11bit ) == 0 )
 				{
 					pulse = limit(0, ((value*13)>>5)+512,1023) | (startChan << 10) ;
@@ -804,12 +805,7 @@ void setupPulsesDsm2(uint8_t chns)
 		else// not MULTI
 		{
   		dsmDat[1]=g_model.Module[1].pxxRxNum ;  //DSM2 Header second byte for model match
-  		for(uint8_t i=0; i<chns; i++)
-  		{
-				uint16_t pulse = limit(0, ((g_chans512[g_model.Module[1].startChannel+i]*13)>>5)+512,1023);
- 			  dsmDat[2+2*i] = (i<<2) | ((pulse>>8)&0x03);
-  		 	dsmDat[3+2*i] = pulse & 0xff;
-  		}
+			dsmChannelBytes( &dsmDat[2], &chans[g_model.Module[1].startChannel], chns ) ;
 
   		for ( counter = 0 ; counter < 14 ; counter += 1 )
   		{
@@ -953,10 +949,11 @@ void setPpmPulses( uint16_t *dest, uint32_t start, uint32_t end, uint32_t total
 {
   uint32_t i ;
 	int16_t PPM_range = g_model.extendedLimits ? 640*2 : 512*2;   //range of 0.7..1.7msec
+	int16_t *chans = OutputChans[OutputBank] ;
 
 	for(i= start ; i < end ; i += 1 )
 	{
-  	int16_t v = max( (int)min(g_chans512[i],PPM_range),-PPM_range) + PPM_CENTER;
+  	int16_t v = max( (int)min(chans[i],PPM_range),-PPM_range) + PPM_CENTER;
    	total -= v ;
     *dest++ = v ; /* as Pat MacKenzie suggests */
  	}
@@ -1064,6 +1061,7 @@ void setupPulsesPPM2()
 	uint32_t byteCount ;
 	uint32_t bitTime ;
 	uint16_t rest ;
+	int16_t *chans = OutputChans[OutputBank] ;
 
 	pwmptr = PWM ;
 	// Now set up pulses
@@ -1178,7 +1176,7 @@ void setupPulsesPPM2()
   		for(uint8_t i=p; i < q ; i++)
   		{
 //				uint16_t pulse = limit(0, ((g_chans512[/*q+*/i]*13)>>5)+512,1023);
-				uint16_t pulse = limit(0, ((g_chans512[i]*13)>>5)+512,1023);
+				uint16_t pulse = limit(0, ((chans[i]*13)>>5)+512,1023);
  			  dsmDat[2+2*i] = (i<<2) | ((pulse>>8)&0x03);
   		 	dsmDat[3+2*i] = pulse & 0xff;
   		}
@@ -1482,8 +1480,9 @@ void setupPulsesPXX()
 {
     uint8_t i ;
     uint16_t chan ;
-    uint16_t chan_1 ;
+		uint32_t j ;
 		uint8_t lpass = Pass ;
+		uint8_t pxxData[PXX_FRAME_BYTES] ;
 
 #ifdef PXX_DELAYS
 	uint16_t ptime ;
@@ -1508,7 +1507,6 @@ void setupPulsesPXX()
     putPcmPart( 0 ) ;
     putPcmPart( 0 ) ;
     putPcmHead(  ) ;  // sync byte
-    putPcmByte( g_model.Module[1].pxxRxNum ) ;
     
   	uint8_t flag1;
   	if (BindRangeFlag[1] & PXX_BIND)
@@ -1545,113 +1543,11 @@ void setupPulsesPXX()
 			}
 		}
 
-		putPcmByte( flag1 ) ;     // First byte of flags
-    putPcmByte( 0 ) ;     // Second byte of flags
-		
-		uint8_t startChan = g_model.Module[1].startChannel ;
-		if ( lpass & 1 )
+		j = pxxFrameBytes( pxxData, &g_model.Module[1], OutputPxx[OutputBank], flag1, lpass ) ;
+		for ( i = 0 ; i < j ; i += 1 )
 		{
-			startChan += 8 ;			
-		}
-		chan = 0 ;
-    for ( i = 0 ; i < 8 ; i += 1 )		// First 8 channels only
-    {																	// Next 8 channels would have 2048 added
-    	if (flag1 & PXX_SEND_FAILSAFE)
-			{
-				if ( g_model.Module[1].failsafeMode == FAILSAFE_HOLD )
-				{
-					chan_1 = 2047 ;
-				}
-				else if ( g_model.Module[1].failsafeMode == FAILSAFE_NO_PULSES )
-				{
-					chan_1 = 0 ;
-				}
-				else
-				{
-					// Send failsafe value
-					int32_t value ;
-					value = ( startChan < 16 ) ? g_model.Module[1].failsafe[startChan] : 0 ;
-					value = ( value *3933 ) >> 9 ;
-					value += 1024 ;					
-					chan_1 = limit( (int16_t)1, (int16_t)value, (int16_t)2046 ) ;
-				}
-			}
-			else
-			{
-      	chan_1 = scaleForPXX( startChan ) ;
-			}
-			if ( lpass & 1 )
-			{
-				chan_1 += 2048 ;
-			}
-//			TempChannels[i] = chan_1 ;
-			startChan += 1 ;
-//      chan_1 = scaleForPXX( startChan ) ;
-//			if ( lpass & 1 )
-//			{
-//				chan_1 += 2048 ;
-//			}
-//			startChan += 1 ;
-      
-			if ( i & 1 )
-			{
-				putPcmByte( chan ) ; // Low byte of channel
-				putPcmByte( ( ( chan >> 8 ) & 0x0F ) | ( chan_1 << 4) ) ;  // 4 bits each from 2 channels
-      	putPcmByte( chan_1 >> 4 ) ;  // High byte of channel
-			}
-			else
-			{
-				chan = chan_1 ;
-			}
-    }
-		
-	  uint8_t extra_flags = 0 ;
-		
-//		/* Ext. flag (holds antenna selection on Horus internal module, 0x00 otherwise) */
-//#if defined(PCBHORUS)
-//  if (port == INTERNAL_MODULE) {
-//    extra_flags |= g_model.moduleData[port].pxx.external_antenna;
-//  }
-//#endif
-//#if defined(BINDING_OPTIONS)
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_telem_off << 1;
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_channel_9_16 << 2;
-//#endif
-//  if (IS_MODULE_R9M(port)) {
-//    extra_flags |= g_model.moduleData[port].pxx.power << 3;
-//    // Disable s.port if internal module is active
-//    if (IS_TELEMETRY_INTERNAL_MODULE || !g_model.moduleData[port].pxx.sport_out)
-//      extra_flags |=  (1<< 5);
-//  }
-		
-// Bit 0: 0 internal, 1 external antenna
-// Bit 1: 0 Telemetry ON, 1 Telemetry OFF
-// Bit 2: 0 PPM 1-8, 1 PPM 9-16
-// Bit 4:3: R9M power nonEU 10, 100, 500, 1000
-// Bit 4:3: R9M power EU 25, 500
-// Bit 5: 0 Sport enabled, 1 Sport disabled
-// Bits 7:6 unused
-
-		 
-		if ( g_model.Module[1].highChannels )
-//		if ( PxxExtra[1] & 1 )
-		{
-			extra_flags = (1 << 2 ) ;
-		}
-		if ( g_model.Module[1].disableTelemetry )
-//		if ( PxxExtra[1] & 2 )
-		{
-			extra_flags |= (1 << 1 ) ;
-		}
-		if ( g_model.Module[1].sub_protocol == 3 )	// R9M
-		{
-			extra_flags |= g_model.Module[1].r9mPower << 3 ;
-			if ( g_model.Module[1].r9MflexMode == 2 )
-			{
-				extra_flags |= 1 << 6 ;
-			}
+			putPcmByte( pxxData[i] ) ;
 		}
-		putPcmByte( extra_flags ) ;
 
     chan = PcmCrc ;		        // get the crc
     putPcmByte( chan >> 8 ) ; // Checksum hi
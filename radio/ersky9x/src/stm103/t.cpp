@@ -47,6 +47,7 @@
 #include "audio.h"
 #include "timers.h"
 #include "file.h"
+#include "base64.h"
 #include "mixer.h"
 #ifndef SIMU
 #include "CoOS.h"
@@ -872,196 +873,6 @@ void ee32SwapModels(uint8_t id1, uint8_t id2)
 //	}
 }
 
-static const uint8_t base64digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" ;
-
-uint8_t xmlDecode( uint8_t value )
-{
-	if ( value >= 'A' )
-	{
-		if ( value <= 'Z' )
-		{
-			return value - 'A' ;
-		}
-		return value - ( 'a' - 26 ) ;		// 'a'-'z'		
-	}
-	else
-	{
-		if ( value >= '0' )
-		{
-			return value + 4 ;
-		}
-		if ( value == '+' )
-		{
-			return 62 ;
-		}
-		else if ( value == '/' )
-		{
-			return 63 ;
-		}
-		else
-		{
-			return 255 ;		// '='
-		}
-	}
-}
-
-
-int32_t readXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalRead )
-{
-  UINT nread ;
-  UINT total = 0 ;
-	uint32_t i ;
-	uint32_t j ;
-	FRESULT result ;
-	uint8_t stream[4] ;
-  uint8_t bytes[104] ;
-
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	if ( strncmp( (const char *)&bytes[10], "ERSKY9X_", 8 ) )
-	{
-		return -1 ;		// Invalid file
-	}
-	result = f_read( archiveFile,  bytes, 100, &nread ) ;
-	total += nread ;
-	// Search for "CDATA[" starting at offset 30
-	for ( i = 30 ; i < 50 ; i += 1 )
-	{
-		if ( !strncmp( (const char *)&bytes[i], "CDATA[", 6 ) )
-		{
-			break ;
-		}
-	}
-	if ( i >= 50 )
-	{
-		return -1 ;		// Invalid file
-	}
-	i += 6 ;	// Index of base64 data
-	j = 0 ;
-	while ( size )
-	{
-		if ( i >= nread )
-		{
-			result = f_read( archiveFile,  bytes, 100, &nread ) ;
-			total += nread ;
-			i = 0 ;
-		}
-		if ( i < nread )
-		{
-			uint8_t value = bytes[i] ;
-			if ( value == ']' )		// End of input data
-			{
-				stream[j++] = 0 ;
-			}
-			else
-			{
-				i += 1 ;
-				stream[j++] = xmlDecode( value ) ;
-			}
-		}
-		else
-		{
-			break ;
-		}
-		if ( j >= 4 )
-		{
-		  *data++ = ( stream[0] << 2) | (stream[1] >> 4) ;
-			size -= 1 ;
-			if ( size == 0 )
-			{
-				break ;
-			}
-			if ( stream[2] != 255 )
-			{
-		  	*data++ = ((stream[1] << 4) & 0xf0) | (stream[2] >> 2);
-				size -= 1 ;
-				if ( size == 0 )
-				{
-					break ;
-				}
-			}
-			if ( stream[3] != 255 )
-			{
-  			*data++ = ((stream[2] << 6) & 0xc0) | stream[3] ;
-				size -= 1 ;
-			}
-			j = 0 ;
-		}
-	}
-	while ( size )
-	{
-		*data++ = 0 ;
-		size -= 1 ;
-	}
-	*totalRead = total ;
-	return result ; 
-}
-
-
-// write XML file
-FRESULT writeXMLfile( FIL *archiveFile, uint8_t *data, uint32_t size, UINT *totalWritten, uint8_t *name )
-{
-  UINT written ;
-  UINT total = 0 ;
-	uint32_t i ;
-	FRESULT result ;
-  uint8_t bytes[104] ;
-
-  result = f_write( archiveFile, (BYTE *)"<!DOCTYPE ERSKY9X_EEPROM_FILE>\n<ERSKY9X_EEPROM_FILE>\n <MODEL_DATA number=\0420\042>\n  <Version>", 89, &written ) ;
-	total += written ;
-  bytes[0] = MDSKYVERS + '0' ;
-  bytes[1] = 0 ;
-  result = f_write( archiveFile, bytes, 1, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Version>\n  <Name>", 19, &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)name, sizeof(g_model.name), &written) ;
-	total += written ;
-  result = f_write( archiveFile, (BYTE *)"</Name>\n  <Data><![CDATA[", 25, &written) ;
-	total += written ;
-
-// Send base 64 here
-	i = 0 ;
-	while ( size > 2 )
-	{
-		bytes[i++] = base64digits[data[0] >> 2];
- 		bytes[i++] = base64digits[((data[0] << 4) & 0x30) | (data[1] >> 4)];
-		bytes[i++] = base64digits[((data[1] << 2) & 0x3c) | (data[2] >> 6)];
-		bytes[i++] = base64digits[data[2] & 0x3f];
-		data += 3 ;
-		size -= 3 ;
-		if ( i >= 100 )
-		{
-		  result = f_write( archiveFile, bytes, 100, &written) ;
-			total += written ;
-			i = 0 ;
-		}
-	}
-
-	uint8_t fragment ;
-	if ( size )
-	{
-		bytes[i++] = base64digits[data[0] >> 2] ;
-		fragment = (data[0] << 4) & 0x30 ;
-		if ( --size )
-		{
- 			fragment |= data[1] >> 4 ;
-		}
-		bytes[i++] = base64digits[fragment];
-		bytes[i++] = ( size == 1 ) ? base64digits[(data[1] << 2) & 0x3c] : '=' ;
-		bytes[i++] = '=' ;
-	}
-	if ( i )
-	{
-		result = f_write( archiveFile, bytes, i, &written) ;
-		total += written ;
-	}
-  result = f_write( archiveFile, (BYTE *)"]]></Data>\n </MODEL_DATA>\n</ERSKY9X_EEPROM_FILE>\n", 49, &written) ;
-	total += written ;
-	*totalWritten = total ;
- return result ;
-}
-
 uint8_t Xfilename[50] ;
 
 const char *ee32RestoreModel( uint8_t modelIndex, char *filename )
@@ -57,6 +57,7 @@
 #include "myeeprom.h"
 #include "drivers.h"
 #include "pulses.h"
+#include "sbus.h"
 
 extern int16_t g_chans512[] ;
 
@@ -1254,27 +1255,7 @@ extern "C" void TIM2_IRQHandler()
   	val = (uint16_t)(capture - lastCapt) / 2 ;
   	lastCapt = capture;
 
-  	// We prcoess g_ppmInsright here to make servo movement as smooth as possible
-  	//    while under trainee control
-  	if ((val>4000) && (val < 19000)) // G: Prioritize reset pulse. (Needed when less than 8 incoming pulses)
-		{
-  	  ppmInState = 1; // triggered
-		}
-  	else
-  	{
-  		if(ppmInState && (ppmInState<=16))
-			{
-  	  	if((val>800) && (val<2200))
-				{
-					ppmInValid = 100 ;
-//  		    g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500)*(g_eeGeneral.PPM_Multiplier+10)/10; //+-500 != 512, but close enough.
-  		    g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500) ; //+-500 != 512, but close enough.
-
-		    }else{
-  		    ppmInState=0; // not triggered
-  	  	}
-  	  }
-  	}
+  	processPpmInPulse( val ) ;
 	}
 }
 
@@ -1365,27 +1346,7 @@ extern "C" void TIM3_IRQHandler()
   	val = (uint16_t)(capture - lastCapt) / 2 ;
   	lastCapt = capture;
 
-  	// We prcoess g_ppmInsright here to make servo movement as smooth as possible
-  	//    while under trainee control
-  	if ((val>4000) && (val < 19000)) // G: Prioritize reset pulse. (Needed when less than 8 incoming pulses)
-		{
-  		ppmInState = 1; // triggered
-		}
-  	else
-  	{
-  		if(ppmInState && (ppmInState<=16))
-			{
-  		  if((val>800) && (val<2200))
-				{
-					ppmInValid = 100 ;
-//  		    g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500)*(g_eeGeneral.PPM_Multiplier+10)/10; //+-500 != 512, but close enough.
-  			  g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500) ; //+-500 != 512, but close enough.
-
-			  }else{
-  			  ppmInState=0; // not triggered
-  		  }
-  		}
-  	}
+  	processPpmInPulse( val ) ;
 	}
 }
 #endif // X3
@@ -1529,27 +1490,7 @@ extern "C" void TIM3_IRQHandler()
   		val = (uint16_t)(capture - lastCapt) / 2 ;
   		lastCapt = capture;
 
-  		// We prcoess g_ppmInsright here to make servo movement as smooth as possible
-  		//    while under trainee control
-  		if ((val>4000) && (val < 19000)) // G: Prioritize reset pulse. (Needed when less than 8 incoming pulses)
-			{
-  		  ppmInState = 1; // triggered
-			}
-  		else
-  		{
-  			if(ppmInState && (ppmInState<=16))
-				{
-  		  	if((val>800) && (val<2200))
-					{
-						ppmInValid = 100 ;
-	//  		    g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500)*(g_eeGeneral.PPM_Multiplier+10)/10; //+-500 != 512, but close enough.
-  			    g_ppmIns[ppmInState++ - 1] = (int16_t)(val - 1500) ; //+-500 != 512, but close enough.
-
-			    }else{
-  			    ppmInState=0; // not triggered
-  		  	}
-  		  }
-  		}
+  		processPpmInPulse( val ) ;
 		}
 
 #ifdef PCBX9LITE
@@ -1665,6 +1606,7 @@ void setupPulsesPpmAll(uint32_t module)
   uint32_t i ;
 	int32_t total ;
 	uint16_t *ptr ;
+	int16_t *chans = OutputChans[OutputBank] ;
 	uint32_t p = (g_model.Module[module].channels + 8) ;
 //	if ( p > 16 )
 //	{
@@ -1717,7 +1659,7 @@ void setupPulsesPpmAll(uint32_t module)
 
 	for ( i = g_model.Module[module].startChannel ; i < p ; i += 1 )
 	{ //NUM_SKYCHNOUT+EXTRA_SKYCHANNELS
-  	int16_t v = max( (int)min(g_chans512[i],PPM_range),-PPM_range) + PPM_CENTER;
+  	int16_t v = max( (int)min(chans[i],PPM_range),-PPM_range) + PPM_CENTER;
 		total -= v ;
     *ptr++ = v ; /* as Pat MacKenzie suggests */
 	}
@@ -1888,6 +1830,7 @@ void setupPulsesDsm2(uint8_t channels, uint32_t module )
 	
 	uint32_t protocol = g_model.Module[module].protocol ;
 	uint32_t sub_protocol = g_model.Module[module].sub_protocol ;
+	int16_t *chans = OutputChans[OutputBank] ;
   
 	required_baudrate = SCC_BAUD_125000 ;
 	
@@ -1985,7 +1928,7 @@ void setupPulsesDsm2(uint8_t channels, uint32_t module )
 			for(uint8_t i=0 ; i<7 ; i += 1 )
 			{
 				uint16_t pulse ;
-				int16_t value = g_chans512[startChan] ;
+				int16_t value = chans[startChan] ;
 				if ( ( flags & ORTX_USE_11bit ) == 0 )
 				{
 					pulse = limit(0, ((value*13)>>5)+512,1023) | (startChan << 10) ;
@@ -2167,12 +2110,7 @@ extern volatile uint8_t PxxTxCount ;
 		else
 		{
 			dsmDat[module][1] = g_model.Module[module].pxxRxNum ;  //DSM2 Header second byte for model match
-  		for( uint8_t i = 0 ; i<channels; i += 1 )
-  		{
-				uint16_t pulse = limit(0, ((g_chans512[g_model.Module[module].startChannel+i]*13)>>5)+512,1023);
- 				dsmDat[module][2+2*i] = (i<<2) | ((pulse>>8)&0x03);
-  			dsmDat[module][3+2*i] = pulse & 0xff;
-  		}
+			dsmChannelBytes( &dsmDat[module][2], &chans[g_model.Module[module].startChannel], channels ) ;
 
 	  	for (int i=0; i<14; i++)
 			{
@@ -2200,9 +2138,184 @@ uint8_t *PtrSerialPxx[2] ;
 
 static void crc( uint8_t data )
 {
-  PcmCrc=(PcmCrc<<8) ^ CRCTable((PcmCrc>>8)^data) ;
+  PcmCrc=(PcmCrc<<8) ^ PxxCrcTable[(uint8_t)((PcmCrc>>8)^data)] ;
 }
 
+#if !defined(PCBXLITE) && !defined(PCBX9LITE)
+// Bit stuffing for a whole byte, indexed by [ones count on entry][byte]
+// Bits 9-0:   output bits, msb sent first, right justified
+// Bits 11-10: number of stuffed 0 bits (output length is 8 + this)
+// Bits 14-12: ones count on exit
+const uint16_t PxxStuffTable[5*256] =
+{
+	// Entry ones count 0
+	0x0000,0x1001,0x0002,0x2003,0x0004,0x1005,0x0006,0x3007,
+	0x0008,0x1009,0x000A,0x200B,0x000C,0x100D,0x000E,0x400F,
+	0x0010,0x1011,0x0012,0x2013,0x0014,0x1015,0x0016,0x3017,
+	0x0018,0x1019,0x001A,0x201B,0x001C,0x101D,0x001E,0x043E,
+	0x0020,0x1021,0x0022,0x2023,0x0024,0x1025,0x0026,0x3027,
+	0x0028,0x1029,0x002A,0x202B,0x002C,0x102D,0x002E,0x402F,
+	0x0030,0x1031,0x0032,0x2033,0x0034,0x1035,0x0036,0x3037,
+	0x0038,0x1039,0x003A,0x203B,0x003C,0x103D,0x047C,0x147D,
+	0x0040,0x1041,0x0042,0x2043,0x0044,0x1045,0x0046,0x3047,
+	0x0048,0x1049,0x004A,0x204B,0x004C,0x104D,0x004E,0x404F,
+	0x0050,0x1051,0x0052,0x2053,0x0054,0x1055,0x0056,0x3057,
+	0x0058,0x1059,0x005A,0x205B,0x005C,0x105D,0x005E,0x04BE,
+	0x0060,0x1061,0x0062,0x2063,0x0064,0x1065,0x0066,0x3067,
+	0x0068,0x1069,0x006A,0x206B,0x006C,0x106D,0x006E,0x406F,
+	0x0070,0x1071,0x0072,0x2073,0x0074,0x1075,0x0076,0x3077,
+	0x0078,0x1079,0x007A,0x207B,0x04F8,0x14F9,0x04FA,0x24FB,
+	0x0080,0x1081,0x0082,0x2083,0x0084,0x1085,0x0086,0x3087,
+	0x0088,0x1089,0x008A,0x208B,0x008C,0x108D,0x008E,0x408F,
+	0x0090,0x1091,0x0092,0x2093,0x0094,0x1095,0x0096,0x3097,
+	0x0098,0x1099,0x009A,0x209B,0x009C,0x109D,0x009E,0x053E,
+	0x00A0,0x10A1,0x00A2,0x20A3,0x00A4,0x10A5,0x00A6,0x30A7,
+	0x00A8,0x10A9,0x00AA,0x20AB,0x00AC,0x10AD,0x00AE,0x40AF,
+	0x00B0,0x10B1,0x00B2,0x20B3,0x00B4,0x10B5,0x00B6,0x30B7,
+	0x00B8,0x10B9,0x00BA,0x20BB,0x00BC,0x10BD,0x057C,0x157D,
+	0x00C0,0x10C1,0x00C2,0x20C3,0x00C4,0x10C5,0x00C6,0x30C7,
+	0x00C8,0x10C9,0x00CA,0x20CB,0x00CC,0x10CD,0x00CE,0x40CF,
+	0x00D0,0x10D1,0x00D2,0x20D3,0x00D4,0x10D5,0x00D6,0x30D7,
+	0x00D8,0x10D9,0x00DA,0x20DB,0x00DC,0x10DD,0x00DE,0x05BE,
+	0x00E0,0x10E1,0x00E2,0x20E3,0x00E4,0x10E5,0x00E6,0x30E7,
+	0x00E8,0x10E9,0x00EA,0x20EB,0x00EC,0x10ED,0x00EE,0x40EF,
+	0x00F0,0x10F1,0x00F2,0x20F3,0x00F4,0x10F5,0x00F6,0x30F7,
+	0x05F0,0x15F1,0x05F2,0x25F3,0x05F4,0x15F5,0x05F6,0x35F7,
+	// Entry ones count 1
+	0x0000,0x1001,0x0002,0x2003,0x0004,0x1005,0x0006,0x3007,
+	0x0008,0x1009,0x000A,0x200B,0x000C,0x100D,0x000E,0x400F,
+	0x0010,0x1011,0x0012,0x2013,0x0014,0x1015,0x0016,0x3017,
+	0x0018,0x1019,0x001A,0x201B,0x001C,0x101D,0x001E,0x043E,
+	0x0020,0x1021,0x0022,0x2023,0x0024,0x1025,0x0026,0x3027,
+	0x0028,0x1029,0x002A,0x202B,0x002C,0x102D,0x002E,0x402F,
+	0x0030,0x1031,0x0032,0x2033,0x0034,0x1035,0x0036,0x3037,
+	0x0038,0x1039,0x003A,0x203B,0x003C,0x103D,0x047C,0x147D,
+	0x0040,0x1041,0x0042,0x2043,0x0044,0x1045,0x0046,0x3047,
+	0x0048,0x1049,0x004A,0x204B,0x004C,0x104D,0x004E,0x404F,
+	0x0050,0x1051,0x0052,0x2053,0x0054,0x1055,0x0056,0x3057,
+	0x0058,0x1059,0x005A,0x205B,0x005C,0x105D,0x005E,0x04BE,
+	0x0060,0x1061,0x0062,0x2063,0x0064,0x1065,0x0066,0x3067,
+	0x0068,0x1069,0x006A,0x206B,0x006C,0x106D,0x006E,0x406F,
+	0x0070,0x1071,0x0072,0x2073,0x0074,0x1075,0x0076,0x3077,
+	0x0078,0x1079,0x007A,0x207B,0x04F8,0x14F9,0x04FA,0x24FB,
+	0x0080,0x1081,0x0082,0x2083,0x0084,0x1085,0x0086,0x3087,
+	0x0088,0x1089,0x008A,0x208B,0x008C,0x108D,0x008E,0x408F,
+	0x0090,0x1091,0x0092,0x2093,0x0094,0x1095,0x0096,0x3097,
+	0x0098,0x1099,0x009A,0x209B,0x009C,0x109D,0x009E,0x053E,
+	0x00A0,0x10A1,0x00A2,0x20A3,0x00A4,0x10A5,0x00A6,0x30A7,
+	0x00A8,0x10A9,0x00AA,0x20AB,0x00AC,0x10AD,0x00AE,0x40AF,
+	0x00B0,0x10B1,0x00B2,0x20B3,0x00B4,0x10B5,0x00B6,0x30B7,
+	0x00B8,0x10B9,0x00BA,0x20BB,0x00BC,0x10BD,0x057C,0x157D,
+	0x00C0,0x10C1,0x00C2,0x20C3,0x00C4,0x10C5,0x00C6,0x30C7,
+	0x00C8,0x10C9,0x00CA,0x20CB,0x00CC,0x10CD,0x00CE,0x40CF,
+	0x00D0,0x10D1,0x00D2,0x20D3,0x00D4,0x10D5,0x00D6,0x30D7,
+	0x00D8,0x10D9,0x00DA,0x20DB,0x00DC,0x10DD,0x00DE,0x05BE,
+	0x00E0,0x10E1,0x00E2,0x20E3,0x00E4,0x10E5,0x00E6,0x30E7,
+	0x00E8,0x10E9,0x00EA,0x20EB,0x00EC,0x10ED,0x00EE,0x40EF,
+	0x05E0,0x15E1,0x05E2,0x25E3,0x05E4,0x15E5,0x05E6,0x35E7,
+	0x05E8,0x15E9,0x05EA,0x25EB,0x05EC,0x15ED,0x05EE,0x45EF,
+	// Entry ones count 2
+	0x0000,0x1001,0x0002,0x2003,0x0004,0x1005,0x0006,0x3007,
+	0x0008,0x1009,0x000A,0x200B,0x000C,0x100D,0x000E,0x400F,
+	0x0010,0x1011,0x0012,0x2013,0x0014,0x1015,0x0016,0x3017,
+	0x0018,0x1019,0x001A,0x201B,0x001C,0x101D,0x001E,0x043E,
+	0x0020,0x1021,0x0022,0x2023,0x0024,0x1025,0x0026,0x3027,
+	0x0028,0x1029,0x002A,0x202B,0x002C,0x102D,0x002E,0x402F,
+	0x0030,0x1031,0x0032,0x2033,0x0034,0x1035,0x0036,0x3037,
+	0x0038,0x1039,0x003A,0x203B,0x003C,0x103D,0x047C,0x147D,
+	0x0040,0x1041,0x0042,0x2043,0x0044,0x1045,0x0046,0x3047,
+	0x0048,0x1049,0x004A,0x204B,0x004C,0x104D,0x004E,0x404F,
+	0x0050,0x1051,0x0052,0x2053,0x0054,0x1055,0x0056,0x3057,
+	0x0058,0x1059,0x005A,0x205B,0x005C,0x105D,0x005E,0x04BE,
+	0x0060,0x1061,0x0062,0x2063,0x0064,0x1065,0x0066,0x3067,
+	0x0068,0x1069,0x006A,0x206B,0x006C,0x106D,0x006E,0x406F,
+	0x0070,0x1071,0x0072,0x2073,0x0074,0x1075,0x0076,0x3077,
+	0x0078,0x1079,0x007A,0x207B,0x04F8,0x14F9,0x04FA,0x24FB,
+	0x0080,0x1081,0x0082,0x2083,0x0084,0x1085,0x0086,0x3087,
+	0x0088,0x1089,0x008A,0x208B,0x008C,0x108D,0x008E,0x408F,
+	0x0090,0x1091,0x0092,0x2093,0x0094,0x1095,0x0096,0x3097,
+	0x0098,0x1099,0x009A,0x209B,0x009C,0x109D,0x009E,0x053E,
+	0x00A0,0x10A1,0x00A2,0x20A3,0x00A4,0x10A5,0x00A6,0x30A7,
+	0x00A8,0x10A9,0x00AA,0x20AB,0x00AC,0x10AD,0x00AE,0x40AF,
+	0x00B0,0x10B1,0x00B2,0x20B3,0x00B4,0x10B5,0x00B6,0x30B7,
+	0x00B8,0x10B9,0x00BA,0x20BB,0x00BC,0x10BD,0x057C,0x157D,
+	0x00C0,0x10C1,0x00C2,0x20C3,0x00C4,0x10C5,0x00C6,0x30C7,
+	0x00C8,0x10C9,0x00CA,0x20CB,0x00CC,0x10CD,0x00CE,0x40CF,
+	0x00D0,0x10D1,0x00D2,0x20D3,0x00D4,0x10D5,0x00D6,0x30D7,
+	0x00D8,0x10D9,0x00DA,0x20DB,0x00DC,0x10DD,0x00DE,0x05BE,
+	0x05C0,0x15C1,0x05C2,0x25C3,0x05C4,0x15C5,0x05C6,0x35C7,
+	0x05C8,0x15C9,0x05CA,0x25CB,0x05CC,0x15CD,0x05CE,0x45CF,
+	0x05D0,0x15D1,0x05D2,0x25D3,0x05D4,0x15D5,0x05D6,0x35D7,
+	0x05D8,0x15D9,0x05DA,0x25DB,0x05DC,0x15DD,0x05DE,0x0BBE,
+	// Entry ones count 3
+	0x0000,0x1001,0x0002,0x2003,0x0004,0x1005,0x0006,0x3007,
+	0x0008,0x1009,0x000A,0x200B,0x000C,0x100D,0x000E,0x400F,
+	0x0010,0x1011,0x0012,0x2013,0x0014,0x1015,0x0016,0x3017,
+	0x0018,0x1019,0x001A,0x201B,0x001C,0x101D,0x001E,0x043E,
+	0x0020,0x1021,0x0022,0x2023,0x0024,0x1025,0x0026,0x3027,
+	0x0028,0x1029,0x002A,0x202B,0x002C,0x102D,0x002E,0x402F,
+	0x0030,0x1031,0x0032,0x2033,0x0034,0x1035,0x0036,0x3037,
+	0x0038,0x1039,0x003A,0x203B,0x003C,0x103D,0x047C,0x147D,
+	0x0040,0x1041,0x0042,0x2043,0x0044,0x1045,0x0046,0x3047,
+	0x0048,0x1049,0x004A,0x204B,0x004C,0x104D,0x004E,0x404F,
+	0x0050,0x1051,0x0052,0x2053,0x0054,0x1055,0x0056,0x3057,
+	0x0058,0x1059,0x005A,0x205B,0x005C,0x105D,0x005E,0x04BE,
+	0x0060,0x1061,0x0062,0x2063,0x0064,0x1065,0x0066,0x3067,
+	0x0068,0x1069,0x006A,0x206B,0x006C,0x106D,0x006E,0x406F,
+	0x0070,0x1071,0x0072,0x2073,0x0074,0x1075,0x0076,0x3077,
+	0x0078,0x1079,0x007A,0x207B,0x04F8,0x14F9,0x04FA,0x24FB,
+	0x0080,0x1081,0x0082,0x2083,0x0084,0x1085,0x0086,0x3087,
+	0x0088,0x1089,0x008A,0x208B,0x008C,0x108D,0x008E,0x408F,
+	0x0090,0x1091,0x0092,0x2093,0x0094,0x1095,0x0096,0x3097,
+	0x0098,0x1099,0x009A,0x209B,0x009C,0x109D,0x009E,0x053E,
+	0x00A0,0x10A1,0x00A2,0x20A3,0x00A4,0x10A5,0x00A6,0x30A7,
+	0x00A8,0x10A9,0x00AA,0x20AB,0x00AC,0x10AD,0x00AE,0x40AF,
+	0x00B0,0x10B1,0x00B2,0x20B3,0x00B4,0x10B5,0x00B6,0x30B7,
+	0x00B8,0x10B9,0x00BA,0x20BB,0x00BC,0x10BD,0x057C,0x157D,
+	0x0580,0x1581,0x0582,0x2583,0x0584,0x1585,0x0586,0x3587,
+	0x0588,0x1589,0x058A,0x258B,0x058C,0x158D,0x058E,0x458F,
+	0x0590,0x1591,0x0592,0x2593,0x0594,0x1595,0x0596,0x3597,
+	0x0598,0x1599,0x059A,0x259B,0x059C,0x159D,0x059E,0x0B3E,
+	0x05A0,0x15A1,0x05A2,0x25A3,0x05A4,0x15A5,0x05A6,0x35A7,
+	0x05A8,0x15A9,0x05AA,0x25AB,0x05AC,0x15AD,0x05AE,0x45AF,
+	0x05B0,0x15B1,0x05B2,0x25B3,0x05B4,0x15B5,0x05B6,0x35B7,
+	0x05B8,0x15B9,0x05BA,0x25BB,0x05BC,0x15BD,0x0B7C,0x1B7D,
+	// Entry ones count 4
+	0x0000,0x1001,0x0002,0x2003,0x0004,0x1005,0x0006,0x3007,
+	0x0008,0x1009,0x000A,0x200B,0x000C,0x100D,0x000E,0x400F,
+	0x0010,0x1011,0x0012,0x2013,0x0014,0x1015,0x0016,0x3017,
+	0x0018,0x1019,0x001A,0x201B,0x001C,0x101D,0x001E,0x043E,
+	0x0020,0x1021,0x0022,0x2023,0x0024,0x1025,0x0026,0x3027,
+	0x0028,0x1029,0x002A,0x202B,0x002C,0x102D,0x002E,0x402F,
+	0x0030,0x1031,0x0032,0x2033,0x0034,0x1035,0x0036,0x3037,
+	0x0038,0x1039,0x003A,0x203B,0x003C,0x103D,0x047C,0x147D,
+	0x0040,0x1041,0x0042,0x2043,0x0044,0x1045,0x0046,0x3047,
+	0x0048,0x1049,0x004A,0x204B,0x004C,0x104D,0x004E,0x404F,
+	0x0050,0x1051,0x0052,0x2053,0x0054,0x1055,0x0056,0x3057,
+	0x0058,0x1059,0x005A,0x205B,0x005C,0x105D,0x005E,0x04BE,
+	0x0060,0x1061,0x0062,0x2063,0x0064,0x1065,0x0066,0x3067,
+	0x0068,0x1069,0x006A,0x206B,0x006C,0x106D,0x006E,0x406F,
+	0x0070,0x1071,0x0072,0x2073,0x0074,0x1075,0x0076,0x3077,
+	0x0078,0x1079,0x007A,0x207B,0x04F8,0x14F9,0x04FA,0x24FB,
+	0x0500,0x1501,0x0502,0x2503,0x0504,0x1505,0x0506,0x3507,
+	0x0508,0x1509,0x050A,0x250B,0x050C,0x150D,0x050E,0x450F,
+	0x0510,0x1511,0x0512,0x2513,0x0514,0x1515,0x0516,0x3517,
+	0x0518,0x1519,0x051A,0x251B,0x051C,0x151D,0x051E,0x0A3E,
+	0x0520,0x1521,0x0522,0x2523,0x0524,0x1525,0x0526,0x3527,
+	0x0528,0x1529,0x052A,0x252B,0x052C,0x152D,0x052E,0x452F,
+	0x0530,0x1531,0x0532,0x2533,0x0534,0x1535,0x0536,0x3537,
+	0x0538,0x1539,0x053A,0x253B,0x053C,0x153D,0x0A7C,0x1A7D,
+	0x0540,0x1541,0x0542,0x2543,0x0544,0x1545,0x0546,0x3547,
+	0x0548,0x1549,0x054A,0x254B,0x054C,0x154D,0x054E,0x454F,
+	0x0550,0x1551,0x0552,0x2553,0x0554,0x1555,0x0556,0x3557,
+	0x0558,0x1559,0x055A,0x255B,0x055C,0x155D,0x055E,0x0ABE,
+	0x0560,0x1561,0x0562,0x2563,0x0564,0x1565,0x0566,0x3567,
+	0x0568,0x1569,0x056A,0x256B,0x056C,0x156D,0x056E,0x456F,
+	0x0570,0x1571,0x0572,0x2573,0x0574,0x1575,0x0576,0x3577,
+	0x0578,0x1579,0x057A,0x257B,0x0AF8,0x1AF9,0x0AFA,0x2AFB
+} ;
+#endif
+
 
 inline __attribute__ ((always_inline)) void putPcmPart( uint8_t value )
 {
@@ -2224,23 +2337,6 @@ void putPcmFlush()
 }
 
 
-void putPcmBit( uint8_t bit )
-{
-    if ( bit )
-    {
-        PcmOnesCount += 1 ;
-        putPcmPart( 1 ) ;
-    }
-    else
-    {
-        PcmOnesCount = 0 ;
-        putPcmPart( 0 ) ;
-    }
-    if ( PcmOnesCount >= 5 )
-    {
-        putPcmBit( 0 ) ;				// Stuff a 0 bit in
-    }
-}
 
 void putPcmByte( uint8_t byte )
 {
@@ -2258,12 +2354,21 @@ void putPcmByte( uint8_t byte )
 	}
 	*PtrSerialPxx[INTERNAL_MODULE]++ = byte ;
 #else
-    uint8_t i ;
-    for ( i = 0 ; i < 8 ; i += 1 )
-    {
-        putPcmBit( byte & 0x80 ) ;
-        byte <<= 1 ;
-    }
+	uint32_t entry = PxxStuffTable[PcmOnesCount * 256 + byte] ;
+	uint32_t mask = 0x80 << ( ( entry >> 10 ) & 3 ) ;
+	uint16_t lpxxValue = PxxValue ;
+	uint16_t *ptr = PtrPxx ;
+	do
+	{
+		lpxxValue += 18 ;
+		*ptr++ = lpxxValue ;
+		lpxxValue += ( entry & mask ) ? 30 : 14 ;
+		*ptr++ = lpxxValue ;
+		mask >>= 1 ;
+	} while ( mask ) ;
+	PtrPxx = ptr ;
+	PxxValue = lpxxValue ;
+	PcmOnesCount = entry >> 12 ;
 #endif
 }
 
@@ -2294,7 +2399,7 @@ void crc_x( uint8_t data )
 {
     //	uint8_t i ;
 
-  PcmCrc_x =(PcmCrc_x<<8) ^ CRCTable((PcmCrc_x>>8)^data) ;
+  PcmCrc_x =(PcmCrc_x<<8) ^ PxxCrcTable[(uint8_t)((PcmCrc_x>>8)^data)] ;
 }
 
 
@@ -2318,23 +2423,6 @@ void putPcmFlush_x()
 }
 
 
-void putPcmBit_x( uint8_t bit )
-{
-    if ( bit )
-    {
-        PcmOnesCount_x += 1 ;
-        putPcmPart_x( 1 ) ;
-    }
-    else
-    {
-        PcmOnesCount_x = 0 ;
-        putPcmPart_x( 0 ) ;
-    }
-    if ( PcmOnesCount_x >= 5 )
-    {
-        putPcmBit_x( 0 ) ;				// Stuff a 0 bit in
-    }
-}
 
 
 
@@ -2368,13 +2456,21 @@ void putPcmByte_x( uint8_t byte )
 	}
 	*PtrSerialPxx[EXTERNAL_MODULE]++ = byte ;
 #else
-    uint8_t i ;
-
-    for ( i = 0 ; i < 8 ; i += 1 )
-    {
-        putPcmBit_x( byte & 0x80 ) ;
-        byte <<= 1 ;
-    }
+	uint32_t entry = PxxStuffTable[PcmOnesCount_x * 256 + byte] ;
+	uint32_t mask = 0x80 << ( ( entry >> 10 ) & 3 ) ;
+	uint16_t lpxxValue = PxxValue_x ;
+	uint16_t *ptr = PtrPxx_x ;
+	do
+	{
+		lpxxValue += 18 ;
+		*ptr++ = lpxxValue ;
+		lpxxValue += ( entry & mask ) ? 30 : 14 ;
+		*ptr++ = lpxxValue ;
+		mask >>= 1 ;
+	} while ( mask ) ;
+	PtrPxx_x = ptr ;
+	PxxValue_x = lpxxValue ;
+	PcmOnesCount_x = entry >> 12 ;
 #endif
 //#endif
 }
@@ -2423,8 +2519,9 @@ void setupPulsesPXX(uint8_t module)
 {
   uint8_t i ;
   uint16_t chan ;
-  uint16_t chan_1 ;
+	uint32_t j ;
 	uint8_t lpass ;
+	uint8_t pxxData[PXX_FRAME_BYTES] ;
 
 //#ifdef PCBX9D
 // #ifdef LATENCY
@@ -2465,7 +2562,6 @@ void setupPulsesPXX(uint8_t module)
  #endif
 #endif
   	putPcmHead(  ) ;  // sync byte
-  	putPcmByte( g_model.Module[module].pxxRxNum ) ;     // putPcmByte( g_model.rxnum ) ;  //
  		uint8_t flag1;
  		if (BindRangeFlag[module] & PXX_BIND)
 		{
@@ -2501,116 +2597,11 @@ void setupPulsesPXX(uint8_t module)
 			}
 		}
 		
-		putPcmByte( flag1 ) ;     // First byte of flags
-  	putPcmByte( 0 ) ;     // Second byte of flags
-
-		uint8_t startChan = g_model.Module[module].startChannel ;
-		if ( lpass & 1 )
-		{
-			startChan += 8 ;			
-		}
-		chan = 0 ;
-  	for ( i = 0 ; i < 8 ; i += 1 )		// First 8 channels only
-  	{																	// Next 8 channels would have 2048 added
-    	if (flag1 & PXX_SEND_FAILSAFE)
-			{
-				if ( g_model.Module[module].failsafeMode == FAILSAFE_HOLD )
-				{
-					chan_1 = 2047 ;
-				}
-				else if ( g_model.Module[module].failsafeMode == FAILSAFE_NO_PULSES )
-				{
-					chan_1 = 0 ;
-				}
-				else
-				{
-					// Send failsafe value
-					int32_t value ;
-					value = ( startChan < 16 ) ? g_model.Module[module].failsafe[startChan] : 0 ;
-					value = ( value *3933 ) >> 9 ;
-					value += 1024 ;					
-					chan_1 = limit( (int16_t)1, (int16_t)value, (int16_t)2046 ) ;
-				}
-			}
-			else
-			{
-				chan_1 = scaleForPXX( startChan ) ;
-			}
- 			if ( lpass & 1 )
-			{
-				chan_1 += 2048 ;
-			}
-			startChan += 1 ;
-			
-//			if ( ( lpass & 1 ) == 0 )
-//			{
-//				if ( startChan == 1 )
-//				{
-//					chan_1 = 1024 ;
-//					if ( ++PxxTestCounter > 10 )
-//					{
-//						chan_1 = 1024 * 3 / 4 + 1024 ;
-//  					GPIO_ResetBits(GPIOA, PIN_EXTPPM_OUT) ; // Set high
-//					}
-//					else
-//					{
-//  					GPIO_SetBits(GPIOA, PIN_EXTPPM_OUT) ; // Set high
-//					}
-//					if ( PxxTestCounter > 21 )
-//					{
-//						PxxTestCounter = 0 ;
-//					}
-//				}
-//			}
-			
-			if ( i & 1 )
-			{
-	  	  putPcmByte( chan ) ; // Low byte of channel
-				putPcmByte( ( ( chan >> 8 ) & 0x0F ) | ( chan_1 << 4) ) ;  // 4 bits each from 2 channels
-  		  putPcmByte( chan_1 >> 4 ) ;  // High byte of channel
-			}
-			else
-			{
-				chan = chan_1 ;
-			}
-  	}
-	  uint8_t extra_flags = 0 ;
-		
-//		/* Ext. flag (holds antenna selection on Horus internal module, 0x00 otherwise) */
-//#if defined(PCBHORUS)
-//  if (port == INTERNAL_MODULE) {
-//    extra_flags |= g_model.moduleData[port].pxx.external_antenna;
-//  }
-//#endif
-//#if defined(BINDING_OPTIONS)
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_telem_off << 1;
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_channel_9_16 << 2;
-//#endif
-//  if (IS_MODULE_R9M(port)) {
-//    extra_flags |= g_model.moduleData[port].pxx.power << 3;
-//    // Disable s.port if internal module is active
-//    if (IS_TELEMETRY_INTERNAL_MODULE || !g_model.moduleData[port].pxx.sport_out)
-//      extra_flags |=  (1<< 5);
-//  }
-		if ( g_model.Module[module].highChannels )
-//		if ( PxxExtra[module] & 1 )
+		j = pxxFrameBytes( pxxData, &g_model.Module[module], OutputPxx[OutputBank], flag1, lpass ) ;
+		for ( i = 0 ; i < j ; i += 1 )
 		{
-			extra_flags = (1 << 2 ) ;
+			putPcmByte( pxxData[i] ) ;
 		}
-		if ( g_model.Module[module].disableTelemetry )
-//		if ( PxxExtra[module] & 2 )
-		{
-			extra_flags |= (1 << 1 ) ;
-		}
-		if ( g_model.Module[module].sub_protocol == 3 )	// R9M
-		{
-			extra_flags |= g_model.Module[module].r9mPower << 3 ;
-			if ( g_model.Module[module].r9MflexMode == 2 )
-			{
-				extra_flags |= 1 << 6 ;
-			}
-		}
-		putPcmByte( extra_flags ) ;
   	chan = PcmCrc ;		        // get the crc
   	putPcmByte( chan >> 8 ) ; // Checksum hi
   	putPcmByte( chan ) ; 			// Checksum lo
@@ -2736,7 +2727,6 @@ extern volatile uint8_t PxxTxCount ;
 //#endif  	
 
 		putPcmHead_x(  ) ;  // sync byte
-  	putPcmByte_x( g_model.Module[module].pxxRxNum ) ;     // putPcmByte( g_model.rxnum ) ;  //
  		uint8_t flag1;
  		if (BindRangeFlag[module] & PXX_BIND)
 		{
@@ -2772,114 +2762,20 @@ extern volatile uint8_t PxxTxCount ;
 			}
 		}
 		
-		putPcmByte_x( flag1 ) ;     // First byte of flags
-  	putPcmByte_x( 0 ) ;     // Second byte of flags
-
-		uint8_t startChan = g_model.Module[module].startChannel ;
-		if ( lpass & 1 )
-		{
-			startChan += 8 ;			
-		}
-		chan = 0 ;
-  	for ( i = 0 ; i < 8 ; i += 1 )		// First 8 channels only
-  	{																	// Next 8 channels would have 2048 added
-    	if (flag1 & PXX_SEND_FAILSAFE)
-			{
-				if ( g_model.Module[module].failsafeMode == FAILSAFE_HOLD )
-				{
-					chan_1 = 2047 ;
-				}
-				else if ( g_model.Module[module].failsafeMode == FAILSAFE_NO_PULSES )
-				{
-					chan_1 = 0 ;
-				}
-				else
-				{
-					// Send failsafe value
-					int32_t value ;
-					value = ( startChan < 16 ) ? g_model.Module[module].failsafe[startChan] : 0 ;
-					value = ( value *3933 ) >> 9 ;
-					value += 1024 ;					
-					chan_1 = limit( (int16_t)1, (int16_t)value, (int16_t)2046 ) ;
-				}
-			}
-			else
-			{
-				chan_1 = scaleForPXX( startChan ) ;
-			}
-			if ( lpass & 1 )
-			{
-				chan_1 += 2048 ;
-			}
-			startChan += 1 ;
-  	  
-			if ( i & 1 )
-			{
-				putPcmByte_x( chan ) ; // Low byte of channel
-				putPcmByte_x( ( ( chan >> 8 ) & 0x0F ) | ( chan_1 << 4) ) ;  // 4 bits each from 2 channels
-  		  putPcmByte_x( chan_1 >> 4 ) ;  // High byte of channel
-			}
-			else
-			{
-				chan = chan_1 ;
-			}
-  	}
-	  uint8_t extra_flags = 0 ;
-		
-//		/* Ext. flag (holds antenna selection on Horus internal module, 0x00 otherwise) */
-//#if defined(PCBHORUS)
-//  if (port == INTERNAL_MODULE) {
-//    extra_flags |= g_model.moduleData[port].pxx.external_antenna;
-//  }
-//#endif
-//#if defined(BINDING_OPTIONS)
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_telem_off << 1;
-//  extra_flags |= g_model.moduleData[port].pxx.receiver_channel_9_16 << 2;
-//#endif
-//  if (IS_MODULE_R9M(port)) {
-//    extra_flags |= g_model.moduleData[port].pxx.power << 3;
-//    // Disable s.port if internal module is active
-//    if (IS_TELEMETRY_INTERNAL_MODULE || !g_model.moduleData[port].pxx.sport_out)
-//      extra_flags |=  (1<< 5);
-//  }
-
-// Bit 0: 0 internal, 1 external antenna
-// Bit 1: 0 Telemetry ON, 1 Telemetry OFF
-// Bit 2: 0 PPM 1-8, 1 PPM 9-16
-// Bit 4:3: R9M power nonEU 10, 100, 500, 1000
-// Bit 4:3: R9M power EU 25, 500
-// Bit 5: 0 Sport enabled, 1 Sport disabled
-// Bits 7:6 unused
-
-
-		if ( g_model.Module[module].highChannels )
-//		if ( PxxExtra[module] & 1 )
-		{
-			extra_flags = (1 << 2 ) ;
-		}
-		if ( g_model.Module[module].disableTelemetry )
-//		if ( PxxExtra[module] & 2 )
-		{
-			extra_flags |= (1 << 1 ) ;
-		}
-		if ( g_model.Module[module].sub_protocol == 3 )	// R9M
-		{
-			extra_flags |= g_model.Module[module].r9mPower << 3 ;
-			if ( g_model.Module[module].r9MflexMode == 2 )
-			{
-				extra_flags |= 1 << 6 ;
-			}
-		}
+		j = pxxFrameBytes( pxxData, &g_model.Module[module], OutputPxx[OutputBank], flag1, lpass ) ;
 #ifdef ALLOW_EXTERNAL_ANTENNA
 		if ( module == 0 )
 		{
 			if ( g_model.Module[module].externalAntenna )
 			{
-				extra_flags |= 1 ;
+				pxxData[j-1] |= 1 ;		// extra_flags
 			}
 		}
 #endif
-		putPcmByte_x( extra_flags ) ;
+		for ( i = 0 ; i < j ; i += 1 )
+		{
+			putPcmByte_x( pxxData[i] ) ;
+		}
 		chan = PcmCrc_x ;		        // get the crc
 #if defined(PCBX12D) || defined(PCBX10)
 		if ( g_eeGeneral.SixPositionCalibration[5] < 0x0A00 )